@@ -1,14 +1,25 @@
 #ifndef RENDER_DEBUG_LOG_H
 #define RENDER_DEBUG_LOG_H
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <cstdio>
+#endif
 #include <chrono>
 #include <string>
 
+#ifdef _WIN32
 inline void OutputDebugString(const std::string &s)
 {
   OutputDebugStringA(s.c_str());
 }
+#else
+inline void OutputDebugString(const std::string &s)
+{
+  std::fputs(s.c_str(), stderr);
+}
+#endif
 
 template <class Time>
 auto DeltaTimeMilisec(Time end, Time start)
@@ -0,0 +1,106 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include "durable_file.h"
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool WriteFileDurably(const std::string &path, const void *data, std::size_t size)
+{
+  const std::string temp = path + ".tmp";
+  HANDLE h = CreateFileA(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE)
+    return false;
+
+  const auto *bytes = static_cast<const std::uint8_t *>(data);
+  bool ok = true;
+  while (ok && size > 0)
+  {
+    DWORD written = 0;
+    const DWORD chunk = size > (1u << 30) ? (1u << 30) : static_cast<DWORD>(size);
+    ok = WriteFile(h, bytes, chunk, &written, nullptr) && written > 0;
+    bytes += written;
+    size -= written;
+  }
+  ok = ok && FlushFileBuffers(h);
+  CloseHandle(h);
+
+  // write through: returns once the rename itself is on the disk
+  if (!ok || !MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+  {
+    DeleteFileA(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+#else
+
+bool WriteFileDurably(const std::string &path, const void *data, std::size_t size)
+{
+  const std::string temp = path + ".tmp";
+  const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+
+  const auto *bytes = static_cast<const std::uint8_t *>(data);
+  bool ok = true;
+  while (ok && size > 0)
+  {
+    const ssize_t written = ::write(fd, bytes, size);
+    ok = written > 0;
+    if (ok)
+    {
+      bytes += written;
+      size -= static_cast<std::size_t>(written);
+    }
+  }
+  ok = ::fsync(fd) == 0 && ok;
+  ok = ::close(fd) == 0 && ok;
+
+  if (!ok || std::rename(temp.c_str(), path.c_str()) != 0)
+  {
+    std::remove(temp.c_str());
+    return false;
+  }
+
+  // the rename is an entry of the directory, which needs a sync of its own
+  const auto slash = path.rfind('/');
+  const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+  const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd < 0)
+    return false;
+  ok = ::fsync(dir_fd) == 0;
+  ::close(dir_fd);
+  return ok;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#ifndef DURABLE_FILE_H
+#define DURABLE_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/// Replace `path` with `size` bytes so that it survives a crash or a power
+/// cut: the bytes go to `path`.tmp, which is synced to the disk and renamed
+/// over `path` (MoveFileEx with write through on Windows, rename and a sync
+/// of the directory elsewhere). Readers see the old file or the new one,
+/// never a mix; after a power cut before the rename completes a stale
+/// `path`.tmp may be left behind.
+///
+/// @returns false if any step failed; `path` is unchanged unless only the
+///          final sync of the directory failed
+bool WriteFileDurably(const std::string &path, const void *data, std::size_t size);
+
+#endif // !DURABLE_FILE_H
@@ -0,0 +1,81 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef FRAME_EXCHANGE_H
+#define FRAME_EXCHANGE_H
+
+#include <atomic>
+#include <memory>
+
+#include "framebuffer.h"
+
+/// Hands complete frames from the render thread to the UI thread without
+/// locks and without either side waiting for the other.
+///
+/// Three buffers rotate between the producer (back), the consumer (front) and
+/// a shared middle slot. Publishing swaps back with the middle slot and marks
+/// it fresh; acquiring swaps front with a fresh middle slot. Each buffer is
+/// therefore owned by exactly one side at any time and a frame is never torn.
+///
+/// Only one thread may act as the producer and one as the consumer at a time.
+class FrameExchange
+{
+public:
+  FrameExchange(int width, int height)
+  {
+    for (auto &b : buffers)
+      b = std::make_unique<FrameBuffer>(width, height);
+  }
+
+  int Width() const { return buffers[0]->width; }
+  int Height() const { return buffers[0]->height; }
+
+  /// Producer side: buffer to render into
+  FrameBuffer &Back() { return *buffers[back]; }
+
+  /// Producer side: make the back buffer the latest frame
+  void Publish() { back = state.exchange(back | kFresh, std::memory_order_acq_rel) & kIndex; }
+
+  /// Consumer side: switch front to the latest published frame
+  ///
+  /// @returns false if nothing new was published since the last call
+  bool Acquire()
+  {
+    if ((state.load(std::memory_order_relaxed) & kFresh) == 0)
+      return false;
+    front = state.exchange(front, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+
+  /// Consumer side: buffer to display
+  FrameBuffer &Front() { return *buffers[front]; }
+  const FrameBuffer &Front() const { return *buffers[front]; }
+
+private:
+  static constexpr unsigned kIndex = 3;
+  static constexpr unsigned kFresh = 4;
+
+  std::unique_ptr<FrameBuffer> buffers[3];
+  unsigned back{0};
+  unsigned front{1};
+  std::atomic<unsigned> state{2};
+};
+
+#endif // !FRAME_EXCHANGE_H
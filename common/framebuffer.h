@@ -0,0 +1,125 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "image.h"
+#include "large_alloc.h"
+
+/// Rectangular region of a picture, in pixels
+struct TileRect
+{
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+/// Packed 32 bit per pixel picture, ready to be handed to a display.
+///
+/// Pixels are stored row by row, top row first, as 0xAARRGGBB words. On a
+/// little endian machine that is B, G, R, A in memory which is the layout of a
+/// 32 bpp Windows DIB, so the whole buffer can be blitted without conversion.
+class FrameBuffer
+{
+public:
+  const int width;
+  const int height;
+
+  using Colour = std::uint32_t;
+
+  FrameBuffer(int width_, int height_)
+      : width{width_}
+      , height{height_}
+      , pixels(width * static_cast<int64_t>(height), kOpaque)
+  {
+  }
+
+  /// Tag of the constructor which leaves the pixels unwritten
+  struct FirstTouch
+  {
+  };
+
+  /// Frame whose pixels are not initialised, so that its pages end up on the
+  /// NUMA node of the render threads filling them. Every pixel must be
+  /// written before the frame is presented.
+  FrameBuffer(int width_, int height_, FirstTouch)
+      : width{width_}
+      , height{height_}
+      , pixels(width * static_cast<int64_t>(height))
+  {
+  }
+
+  /// Pack floating point colour into a framebuffer word
+  static constexpr Colour Pack(const Image::Colour &colour)
+  {
+    return kOpaque | static_cast<std::uint32_t>(::Colour(colour, false));
+  }
+
+  Colour Pixel(int x, int y) const { return pixels[y * static_cast<int64_t>(width) + x]; }
+  void Pixel(int x, int y, Colour colour) { pixels[y * static_cast<int64_t>(width) + x] = colour; }
+  void Pixel(int x, int y, const Image::Colour &colour) { Pixel(x, y, Pack(colour)); }
+
+  /// Number of pixels between the beginning of two consecutive rows
+  int Stride() const { return width; }
+
+  Colour *Row(int y) { return pixels.data() + y * static_cast<int64_t>(Stride()); }
+  const Colour *Row(int y) const { return pixels.data() + y * static_cast<int64_t>(Stride()); }
+
+  Colour *Data() { return pixels.data(); }
+  const Colour *Data() const { return pixels.data(); }
+
+  std::size_t SizeBytes() const { return pixels.size() * sizeof(Colour); }
+
+  /// Convert a floating point image into this framebuffer.
+  /// Both must have the same dimensions.
+  void Pack(const Image &image)
+  {
+    auto dst = pixels.begin();
+    for (const auto &pxl : image)
+      *dst++ = Pack(pxl);
+  }
+
+  /// Copy another framebuffer of the same dimensions
+  void CopyFrom(const FrameBuffer &other) { std::memcpy(Data(), other.Data(), SizeBytes()); }
+
+  /// Copy a block of packed pixels into a region of this framebuffer
+  ///
+  /// @param rect - destination region
+  /// @param src - first pixel of the block
+  /// @param src_stride - number of pixels between two rows of the block
+  void CopyFrom(const TileRect &rect, const Colour *src, int src_stride)
+  {
+    for (int y = 0; y < rect.height; y++)
+      std::memcpy(Row(rect.y + y) + rect.x, src + y * static_cast<int64_t>(src_stride), rect.width * sizeof(Colour));
+  }
+
+private:
+  static constexpr Colour kOpaque = 0xFF000000;
+
+  std::vector<Colour, LargeAllocator<Colour>> pixels;
+};
+
+#endif // !FRAMEBUFFER_H
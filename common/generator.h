@@ -0,0 +1,117 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+/// Coroutine producing a sequence of values with co_yield, consumed with a
+/// range-based for loop. The coroutine runs on the consumer's thread, one step
+/// per increment of the iterator.
+template <class T>
+class Generator
+{
+public:
+  struct promise_type
+  {
+    std::optional<T> value;
+    std::exception_ptr error;
+
+    Generator get_return_object() { return Generator{Handle::from_promise(*this)}; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(T v)
+    {
+      value = std::move(v);
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type        = T;
+    using difference_type   = std::ptrdiff_t;
+
+    explicit iterator(Handle h = {})
+        : handle{h}
+    {
+    }
+
+    T &operator*() const { return *handle.promise().value; }
+    iterator &operator++()
+    {
+      Advance(handle);
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const { return !handle || handle.done(); }
+
+  private:
+    Handle handle;
+  };
+
+  explicit Generator(Handle h)
+      : handle{h}
+  {
+  }
+  Generator(Generator &&other) noexcept
+      : handle{std::exchange(other.handle, {})}
+  {
+  }
+  Generator(const Generator &)            = delete;
+  Generator &operator=(const Generator &) = delete;
+  ~Generator()
+  {
+    if (handle)
+      handle.destroy();
+  }
+
+  iterator begin()
+  {
+    Advance(handle);
+    return iterator{handle};
+  }
+  std::default_sentinel_t end() const { return {}; }
+
+private:
+  static void Advance(Handle h)
+  {
+    h.promise().value.reset();
+    h.resume();
+    if (h.promise().error)
+      std::rethrow_exception(h.promise().error);
+  }
+
+  Handle handle;
+};
+
+#endif // !GENERATOR_H
@@ -9,7 +9,9 @@
 
 #define _USE_MATH_DEFINES // for C++
 #include <cmath>
+#ifdef _MSC_VER
 #include <corecrt_math_defines.h>
+#endif
 
 // remove windows crap
 #ifdef max
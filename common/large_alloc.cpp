@@ -0,0 +1,65 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include "large_alloc.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+std::atomic<bool> huge_pages{false};
+}
+
+void UseHugePages(bool use) { huge_pages = use; }
+
+#ifdef _WIN32
+
+// Windows large pages need the "lock pages in memory" privilege and are
+// never swapped, so they are not used here; first touch placement works the
+// same as on Linux.
+void *AllocateLarge(std::size_t bytes) { return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE); }
+
+void FreeLarge(void *data, std::size_t) { VirtualFree(data, 0, MEM_RELEASE); }
+
+#else
+
+void *AllocateLarge(std::size_t bytes)
+{
+  void *data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED)
+    return nullptr;
+
+#ifdef MADV_HUGEPAGE
+  if (huge_pages)
+    madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+  return data;
+}
+
+void FreeLarge(void *data, std::size_t bytes) { munmap(data, bytes); }
+
+#endif
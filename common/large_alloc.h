@@ -0,0 +1,107 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#ifndef LARGE_ALLOC_H
+#define LARGE_ALLOC_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/// Allocations at least this big come straight from the OS
+constexpr std::size_t kLargeAllocation = 1 << 20;
+
+/// Reserve `bytes` of fresh pages from the OS. The pages are not touched, so
+/// on a NUMA machine each one is placed on the node of the thread which
+/// writes it first. Contents read as zero.
+///
+/// @returns nullptr if the OS refuses
+void *AllocateLarge(std::size_t bytes);
+void FreeLarge(void *data, std::size_t bytes);
+
+/// Ask for transparent huge pages behind later large allocations (Linux,
+/// madvise mode of THP). Fewer TLB misses when streaming through big frames.
+void UseHugePages(bool use);
+
+/// Allocator of large pixel and count buffers.
+///
+/// Elements are default initialised, so a vector resized with it does not
+/// write its memory, leaving the first touch of every page to the threads
+/// which fill it. Small buffers use the normal heap.
+template <class T>
+class LargeAllocator
+{
+public:
+  using value_type = T;
+
+  LargeAllocator() = default;
+  template <class U>
+  LargeAllocator(const LargeAllocator<U> &)
+  {
+  }
+
+  T *allocate(std::size_t n)
+  {
+    const std::size_t bytes = n * sizeof(T);
+    if (bytes < kLargeAllocation)
+      return static_cast<T *>(::operator new(bytes));
+
+    void *data = AllocateLarge(bytes);
+    if (!data)
+      throw std::bad_alloc{};
+    return static_cast<T *>(data);
+  }
+
+  void deallocate(T *data, std::size_t n)
+  {
+    const std::size_t bytes = n * sizeof(T);
+    if (bytes < kLargeAllocation)
+      ::operator delete(data);
+    else
+      FreeLarge(data, bytes);
+  }
+
+  /// Default initialisation, no value is written
+  template <class U>
+  void construct(U *p)
+  {
+    ::new (static_cast<void *>(p)) U;
+  }
+
+  template <class U, class... Args>
+  void construct(U *p, Args &&...args)
+  {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  bool operator==(const LargeAllocator<U> &) const
+  {
+    return true;
+  }
+  template <class U>
+  bool operator!=(const LargeAllocator<U> &) const
+  {
+    return false;
+  }
+};
+
+#endif // !LARGE_ALLOC_H
@@ -0,0 +1,128 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Bounded multi-producer multi-consumer queue without locks.
+///
+/// Every cell carries a sequence number that tells whether it is free for the
+/// producer of a given position or filled for the consumer of that position
+/// (D. Vyukov's bounded queue). Neither side ever waits: push fails when the
+/// queue is full and pop fails when it is empty.
+///
+/// Elements are filled and consumed in place through a callback, so large
+/// payloads (e.g. tile pixels) are not copied through the stack.
+///
+/// @tparam T - element, must be default constructible
+/// @tparam Capacity - number of cells, power of two
+template <class T, std::size_t Capacity>
+class LockFreeQueue
+{
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  LockFreeQueue()
+  {
+    for (std::size_t i = 0; i < Capacity; i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  LockFreeQueue(const LockFreeQueue &)            = delete;
+  LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+  /// Reserve a cell and fill it with `fill(T&)`
+  ///
+  /// @returns false if the queue is full, `fill` is not called then
+  template <class Fill>
+  bool TryPush(Fill &&fill)
+  {
+    Cell *cell;
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell            = &cells[pos & kMask];
+      const auto seq  = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+      if (diff == 0)
+      {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    fill(cell->data);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Take the oldest element and hand it to `consume(T&)`
+  ///
+  /// @returns false if the queue is empty, `consume` is not called then
+  template <class Consume>
+  bool TryPop(Consume &&consume)
+  {
+    Cell *cell;
+    std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell            = &cells[pos & kMask];
+      const auto seq  = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0)
+      {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+    consume(cell->data);
+    cell->sequence.store(pos + kMask + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static constexpr std::size_t kMask = Capacity - 1;
+
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence;
+    T data;
+  };
+
+  alignas(64) std::atomic<std::size_t> enqueue_pos{0};
+  alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+  alignas(64) std::array<Cell, Capacity> cells;
+};
+
+#endif // !LOCKFREE_QUEUE_H
@@ -0,0 +1,190 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/// Thread safe least-recently-used cache bounded by total cost (e.g. bytes).
+///
+/// Values are immutable and shared, so a value evicted while somebody still
+/// uses it stays alive until the last user lets it go. GetOrCreate()
+/// coalesces concurrent misses of one key into a single create() call; the
+/// other callers wait for its result.
+///
+/// @tparam Key - cache key, needs Hash and operator==
+/// @tparam Value - cached object
+template <class Key, class Value, class Hash = std::hash<Key>>
+class LruCache
+{
+public:
+  using ValuePtr = std::shared_ptr<const Value>;
+  using CostFn   = std::function<std::size_t(const Value &)>;
+
+  struct Stats
+  {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t coalesced; ///< misses which waited for another caller's create()
+    std::size_t cost;
+    std::size_t entries;
+  };
+
+  /// @param capacity_ - maximum total cost of cached values
+  /// @param cost_ - cost of a single value
+  LruCache(std::size_t capacity_, CostFn cost_)
+      : capacity{capacity_}
+      , cost{std::move(cost_)}
+  {
+  }
+
+  /// @returns cached value or nullptr
+  ValuePtr Find(const Key &key)
+  {
+    std::lock_guard<std::mutex> guard{lock};
+    return Touch(key);
+  }
+
+  /// Add or replace a value
+  void Insert(const Key &key, ValuePtr value)
+  {
+    std::lock_guard<std::mutex> guard{lock};
+    Store(key, std::move(value));
+  }
+
+  /// Cached value or the result of `create()` which is then cached.
+  /// Exceptions thrown by `create` are passed to every waiting caller and
+  /// nothing is cached.
+  template <class Create>
+  ValuePtr GetOrCreate(const Key &key, Create &&create)
+  {
+    std::promise<ValuePtr> promise;
+    {
+      std::unique_lock<std::mutex> guard{lock};
+      if (auto hit = Touch(key))
+        return hit;
+
+      auto p = pending.find(key);
+      if (p != pending.end())
+      {
+        ++stats.coalesced;
+        auto result = p->second;
+        guard.unlock();
+        return result.get();
+      }
+
+      ++stats.misses;
+      pending.emplace(key, promise.get_future().share());
+    }
+
+    ValuePtr value;
+    try
+    {
+      value = create();
+    }
+    catch (...)
+    {
+      {
+        std::lock_guard<std::mutex> guard{lock};
+        pending.erase(key);
+      }
+      promise.set_exception(std::current_exception());
+      throw;
+    }
+
+    {
+      std::lock_guard<std::mutex> guard{lock};
+      Store(key, value);
+      pending.erase(key);
+    }
+    promise.set_value(value);
+    return value;
+  }
+
+  Stats GetStats() const
+  {
+    std::lock_guard<std::mutex> guard{lock};
+    Stats s   = stats;
+    s.cost    = used;
+    s.entries = lru.size();
+    return s;
+  }
+
+private:
+  using Entry = std::pair<Key, ValuePtr>;
+
+  ValuePtr Touch(const Key &key)
+  {
+    auto it = index.find(key);
+    if (it == index.end())
+      return nullptr;
+    ++stats.hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+  }
+
+  void Store(const Key &key, ValuePtr value)
+  {
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+      used -= cost(*it->second->second);
+      lru.erase(it->second);
+      index.erase(it);
+    }
+
+    const std::size_t c = cost(*value);
+    if (c > capacity)
+      return; // would evict everything else and still not fit
+
+    lru.emplace_front(key, std::move(value));
+    index.emplace(key, lru.begin());
+    used += c;
+
+    while (used > capacity)
+    {
+      auto &oldest = lru.back();
+      used -= cost(*oldest.second);
+      index.erase(oldest.first);
+      lru.pop_back();
+    }
+  }
+
+  mutable std::mutex lock;
+  std::list<Entry> lru; ///< most recently used first
+  std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+  std::unordered_map<Key, std::shared_future<ValuePtr>, Hash> pending;
+  std::size_t capacity;
+  std::size_t used{0};
+  CostFn cost;
+  Stats stats{};
+};
+
+#endif // !LRU_CACHE_H
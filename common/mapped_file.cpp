@@ -0,0 +1,236 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string &path, std::size_t min_size)
+{
+  Close();
+
+  HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE)
+    return false;
+  file = h;
+
+  LARGE_INTEGER current{};
+  GetFileSizeEx(h, &current);
+  const auto existing = static_cast<std::size_t>(current.QuadPart);
+  if (!Map(existing < min_size ? min_size : existing))
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedFile::OpenReadOnly(const std::string &path)
+{
+  Close();
+
+  HANDLE h = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE)
+    return false;
+  file      = h;
+  read_only = true;
+
+  LARGE_INTEGER current{};
+  if (!GetFileSizeEx(h, &current) || current.QuadPart == 0)
+  {
+    Close();
+    return false;
+  }
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping)
+    data = static_cast<std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!data)
+  {
+    Close();
+    return false;
+  }
+  size = static_cast<std::size_t>(current.QuadPart);
+  return true;
+}
+
+bool MappedFile::Map(std::size_t new_size)
+{
+  LARGE_INTEGER li{};
+  li.QuadPart = static_cast<LONGLONG>(new_size);
+  if (!SetFilePointerEx(file, li, nullptr, FILE_BEGIN) || !SetEndOfFile(file))
+    return false;
+
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, li.HighPart, li.LowPart, nullptr);
+  if (!mapping)
+    return false;
+
+  data = static_cast<std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, new_size));
+  if (!data)
+  {
+    CloseHandle(mapping);
+    mapping = nullptr;
+    return false;
+  }
+  size = new_size;
+  return true;
+}
+
+void MappedFile::Unmap()
+{
+  if (data)
+    UnmapViewOfFile(data);
+  if (mapping)
+    CloseHandle(mapping);
+  data    = nullptr;
+  mapping = nullptr;
+  size    = 0;
+}
+
+void MappedFile::Flush()
+{
+  if (data)
+    FlushViewOfFile(data, 0);
+}
+
+void MappedFile::Close()
+{
+  Unmap();
+  if (file)
+    CloseHandle(file);
+  file      = nullptr;
+  read_only = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path, std::size_t min_size)
+{
+  Close();
+
+  file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (file < 0)
+    return false;
+  // released when the file is closed
+  if (flock(file, LOCK_EX | LOCK_NB) != 0)
+  {
+    Close();
+    return false;
+  }
+
+  struct stat st{};
+  fstat(file, &st);
+  const auto existing = static_cast<std::size_t>(st.st_size);
+  if (!Map(existing < min_size ? min_size : existing))
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedFile::OpenReadOnly(const std::string &path)
+{
+  Close();
+
+  file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0)
+    return false;
+  read_only = true;
+
+  struct stat st{};
+  if (fstat(file, &st) != 0 || st.st_size == 0)
+  {
+    Close();
+    return false;
+  }
+  void *p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, file, 0);
+  if (p == MAP_FAILED)
+  {
+    Close();
+    return false;
+  }
+  data = static_cast<std::uint8_t *>(p);
+  size = static_cast<std::size_t>(st.st_size);
+  return true;
+}
+
+bool MappedFile::Map(std::size_t new_size)
+{
+  if (ftruncate(file, static_cast<off_t>(new_size)) != 0)
+    return false;
+
+  void *p = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  if (p == MAP_FAILED)
+    return false;
+
+  data = static_cast<std::uint8_t *>(p);
+  size = new_size;
+  return true;
+}
+
+void MappedFile::Unmap()
+{
+  if (data)
+    munmap(data, size);
+  data = nullptr;
+  size = 0;
+}
+
+void MappedFile::Flush()
+{
+  if (data)
+    msync(data, size, MS_ASYNC);
+}
+
+void MappedFile::Close()
+{
+  Unmap();
+  if (file >= 0)
+    ::close(file);
+  file      = -1;
+  read_only = false;
+}
+
+#endif
+
+bool MappedFile::Resize(std::size_t new_size)
+{
+  if (read_only)
+    return false;
+  Unmap();
+  return Map(new_size);
+}
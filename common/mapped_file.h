@@ -0,0 +1,84 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// File mapped into memory for reading and writing.
+///
+/// Resizing remaps the file, so pointers obtained from Data() before a
+/// Resize() are invalid afterwards.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &)            = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// Open or create a file and map all of it. The file is open for one
+  /// writer at a time: while it is, another Open of it fails, from this
+  /// process too (share mode on Windows, flock elsewhere).
+  ///
+  /// @param min_size - file is extended (with zeros) to at least this size
+  /// @returns false if the file cannot be opened, is open elsewhere or cannot be mapped
+  bool Open(const std::string &path, std::size_t min_size);
+
+  /// Map all of an existing, non-empty file for reading only; the file is
+  /// neither created nor changed and Resize fails
+  ///
+  /// @returns false if the file cannot be opened or mapped
+  bool OpenReadOnly(const std::string &path);
+
+  /// Extend or shrink the file and map it again
+  bool Resize(std::size_t size);
+
+  /// Ask the OS to write dirty pages back to the file
+  void Flush();
+
+  void Close();
+
+  bool Valid() const { return data != nullptr; }
+  bool ReadOnly() const { return read_only; }
+  std::uint8_t *Data() { return data; }
+  const std::uint8_t *Data() const { return data; }
+  std::size_t Size() const { return size; }
+
+private:
+  bool Map(std::size_t new_size);
+  void Unmap();
+
+  std::uint8_t *data{nullptr};
+  std::size_t size{0};
+  bool read_only{false};
+#ifdef _WIN32
+  void *file{nullptr};
+  void *mapping{nullptr};
+#else
+  int file{-1};
+#endif
+};
+
+#endif // !MAPPED_FILE_H
@@ -0,0 +1,78 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef MEMORY_PRESENTER_H
+#define MEMORY_PRESENTER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "presenter.h"
+
+/// Headless display backend. Keeps a copy of the last presented frame in
+/// memory so it can be inspected without any window system.
+class MemoryPresenter : public Presenter
+{
+public:
+  void Present(const FrameBuffer &frame) override
+  {
+    width  = frame.width;
+    height = frame.height;
+    pixels.resize(frame.width * static_cast<std::size_t>(frame.height));
+    std::memcpy(pixels.data(), frame.Data(), frame.SizeBytes());
+    ++frames;
+  }
+
+  void Present(const FrameBuffer &frame, const TileRect &rect) override
+  {
+    if (width != frame.width || height != frame.height)
+    {
+      width  = frame.width;
+      height = frame.height;
+      pixels.assign(frame.width * static_cast<std::size_t>(frame.height), 0);
+    }
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+      std::memcpy(&pixels[y * static_cast<std::size_t>(width) + rect.x], frame.Row(y) + rect.x,
+                  rect.width * sizeof(FrameBuffer::Colour));
+    ++regions;
+  }
+
+  int Width() const { return width; }
+  int Height() const { return height; }
+
+  /// Number of frames presented so far
+  std::uint64_t Frames() const { return frames; }
+
+  /// Number of partial updates presented so far
+  std::uint64_t Regions() const { return regions; }
+
+  FrameBuffer::Colour Pixel(int x, int y) const { return pixels[y * static_cast<std::size_t>(width) + x]; }
+  const std::vector<FrameBuffer::Colour> &Pixels() const { return pixels; }
+
+private:
+  int width{0};
+  int height{0};
+  std::uint64_t frames{0};
+  std::uint64_t regions{0};
+  std::vector<FrameBuffer::Colour> pixels;
+};
+
+#endif // !MEMORY_PRESENTER_H
@@ -0,0 +1,104 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include "mip_pyramid.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+/// Rounded mean of four pixels, channel by channel. Even and odd bytes are
+/// summed in separate 16 bit lanes, which cannot overflow.
+MipPyramid::Colour Average(MipPyramid::Colour a, MipPyramid::Colour b, MipPyramid::Colour c, MipPyramid::Colour d)
+{
+  constexpr std::uint32_t kLanes = 0x00FF00FF;
+  constexpr std::uint32_t kHalf  = 0x00020002;
+  const std::uint32_t even = (a & kLanes) + (b & kLanes) + (c & kLanes) + (d & kLanes) + kHalf;
+  const std::uint32_t odd =
+      (a >> 8 & kLanes) + (b >> 8 & kLanes) + (c >> 8 & kLanes) + (d >> 8 & kLanes) + kHalf;
+  return (even >> 2 & kLanes) | (odd >> 2 & kLanes) << 8;
+}
+} // namespace
+
+MipPyramid::MipPyramid(int width, int height, int tile_size_, TileSink sink_)
+    : tile_size{tile_size_}
+    , sink{std::move(sink_)}
+{
+  for (;;)
+  {
+    levels.push_back({height, 0, FrameBuffer{width, tile_size, FrameBuffer::FirstTouch{}}});
+    if (width <= tile_size && height <= tile_size)
+      break;
+    width  = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  half.resize(levels.size() > 1 ? LevelWidth(1) : 0);
+}
+
+void MipPyramid::AddRow(const Colour *row) { Add(0, row); }
+
+void MipPyramid::AddRows(const FrameBuffer &rows)
+{
+  for (int y = 0; y < rows.height; y++)
+    Add(0, rows.Row(y));
+}
+
+void MipPyramid::Add(int level, const Colour *row)
+{
+  Level &l = levels[level];
+  const int y    = l.next_row++;
+  const int band = y % tile_size;
+  Colour *dst    = l.band.Row(band);
+  std::copy(row, row + l.band.width, dst);
+
+  // rows 2k and 2k + 1 are in the same band as the tile size is even
+  const bool last = l.next_row == l.height;
+  if (level + 1 < Levels() && (y % 2 == 1 || last))
+  {
+    const Colour *above = y % 2 == 1 ? l.band.Row(band - 1) : dst;
+    const int width     = l.band.width;
+    const int next      = LevelWidth(level + 1);
+    for (int x = 0; x < next; x++)
+    {
+      const int x1 = 2 * x;
+      const int x2 = x1 + 1 < width ? x1 + 1 : x1;
+      half[x]      = Average(above[x1], above[x2], dst[x1], dst[x2]);
+    }
+    // the next level overwrites `half` only after its own copy of the row
+    Add(level + 1, half.data());
+  }
+
+  if (band == tile_size - 1 || last)
+    EmitBand(level, band + 1);
+}
+
+void MipPyramid::EmitBand(int level, int rows)
+{
+  const Level &l = levels[level];
+  const int row  = (l.next_row - 1) / tile_size;
+  for (int x = 0, column = 0; x < l.band.width; x += tile_size, column++)
+  {
+    const int width = std::min(tile_size, l.band.width - x);
+    FrameBuffer tile{width, rows, FrameBuffer::FirstTouch{}};
+    tile.CopyFrom({0, 0, width, rows}, l.band.Row(0) + x, l.band.Stride());
+    sink(level, column, row, tile);
+  }
+}
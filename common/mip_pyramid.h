@@ -0,0 +1,80 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef MIP_PYRAMID_H
+#define MIP_PYRAMID_H
+
+#include <functional>
+#include <vector>
+
+#include "framebuffer.h"
+
+/// Mip-map pyramid of a picture too large to hold in memory, built in one
+/// streaming pass over the full resolution rows.
+///
+/// Level 0 is the picture itself, every next level halves both sizes with a
+/// 2x2 box filter (rounding up, an odd last column or row is averaged with
+/// itself) down to the first level which fits in one tile. Rows are fed top
+/// to bottom; each level keeps only the band of rows of its current row of
+/// tiles, so memory stays around two tile rows of the full width whatever
+/// the height. A band goes to the sink as tiles as soon as it is complete.
+class MipPyramid
+{
+public:
+  using Colour = FrameBuffer::Colour;
+
+  /// Finished tile of `level` at tile `column`, `row`. Tiles on the right and
+  /// bottom edge of a level are smaller than the tile size.
+  using TileSink = std::function<void(int level, int column, int row, const FrameBuffer &tile)>;
+
+  /// @param tile_size - edge of the tiles, even
+  MipPyramid(int width, int height, int tile_size, TileSink sink);
+
+  int Levels() const { return static_cast<int>(levels.size()); }
+  int LevelWidth(int level) const { return levels[level].band.width; }
+  int LevelHeight(int level) const { return levels[level].height; }
+
+  /// Next row of the full resolution picture, `width` pixels
+  void AddRow(const Colour *row);
+
+  /// Next rows of the full resolution picture, `width` pixels wide
+  void AddRows(const FrameBuffer &rows);
+
+  /// All rows of the picture were added
+  bool Done() const { return levels[0].next_row == levels[0].height; }
+
+private:
+  struct Level
+  {
+    int height;
+    int next_row; ///< of the level, the next one to be added
+    FrameBuffer band;
+  };
+
+  void Add(int level, const Colour *row);
+  void EmitBand(int level, int rows);
+
+  int tile_size;
+  TileSink sink;
+  std::vector<Level> levels;
+  std::vector<Colour> half; ///< downsampled row on its way to the next level
+};
+
+#endif // !MIP_PYRAMID_H
@@ -0,0 +1,249 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "framebuffer.h"
+
+namespace png_detail
+{
+inline std::uint32_t Crc32(const std::uint8_t *data, std::size_t size, std::uint32_t crc = 0)
+{
+  static const auto table = [] {
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t n = 0; n < 256; n++)
+    {
+      std::uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+
+  crc = ~crc;
+  for (std::size_t i = 0; i < size; i++)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+inline std::uint32_t Adler32(const std::vector<std::uint8_t> &data)
+{
+  std::uint32_t a = 1, b = 0;
+  for (std::size_t i = 0; i < data.size();)
+  {
+    // largest block which cannot overflow b before the modulo
+    const std::size_t end = std::min(data.size(), i + 5552);
+    for (; i < end; i++)
+    {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+/// Deflate bit stream, least significant bit first
+class BitWriter
+{
+public:
+  void Bits(std::uint32_t value, int count)
+  {
+    acc |= static_cast<std::uint64_t>(value) << used;
+    used += count;
+    while (used >= 8)
+    {
+      out.push_back(static_cast<std::uint8_t>(acc));
+      acc >>= 8;
+      used -= 8;
+    }
+  }
+
+  /// Huffman codes are defined most significant bit first
+  void Code(std::uint32_t code, int count)
+  {
+    std::uint32_t reversed = 0;
+    for (int i = 0; i < count; i++)
+      reversed |= ((code >> i) & 1) << (count - 1 - i);
+    Bits(reversed, count);
+  }
+
+  std::vector<std::uint8_t> Finish()
+  {
+    if (used > 0)
+      out.push_back(static_cast<std::uint8_t>(acc));
+    return std::move(out);
+  }
+
+private:
+  std::vector<std::uint8_t> out;
+  std::uint64_t acc{0};
+  int used{0};
+};
+
+/// Symbol of the fixed literal/length Huffman code
+inline void FixedLiteral(BitWriter &w, int symbol)
+{
+  if (symbol < 144)
+    w.Code(0x30 + symbol, 8);
+  else if (symbol < 256)
+    w.Code(0x190 + symbol - 144, 9);
+  else if (symbol < 280)
+    w.Code(symbol - 256, 7);
+  else
+    w.Code(0xC0 + symbol - 280, 8);
+}
+
+inline void FixedMatch(BitWriter &w, int length, int distance)
+{
+  static constexpr int kLenBase[]  = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static constexpr int kLenExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static constexpr int kDistBase[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                      193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+  static constexpr int kDistExtra[] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                       6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  int l = 28;
+  while (kLenBase[l] > length)
+    l--;
+  FixedLiteral(w, 257 + l);
+  w.Bits(length - kLenBase[l], kLenExtra[l]);
+
+  int d = 29;
+  while (kDistBase[d] > distance)
+    d--;
+  w.Code(d, 5);
+  w.Bits(distance - kDistBase[d], kDistExtra[d]);
+}
+
+/// Single fixed Huffman deflate block. Matches are only searched at the
+/// distance of the previous pixel and of the previous row, which is what
+/// compresses in flat fractal areas, and keeps encoding a linear pass.
+inline std::vector<std::uint8_t> Deflate(const std::vector<std::uint8_t> &data, int pixel_bytes, int row_bytes)
+{
+  BitWriter w;
+  w.Bits(1, 1); // final block
+  w.Bits(1, 2); // fixed Huffman codes
+
+  const int candidates[] = {pixel_bytes, row_bytes};
+  const std::size_t size = data.size();
+  for (std::size_t i = 0; i < size;)
+  {
+    int best_len = 0, best_dist = 0;
+    for (const int d : candidates)
+    {
+      if (d <= 0 || d > 32768 || i < static_cast<std::size_t>(d))
+        continue;
+      int len = 0;
+      while (len < 258 && i + len < size && data[i + len] == data[i + len - d])
+        len++;
+      if (len > best_len)
+      {
+        best_len  = len;
+        best_dist = d;
+      }
+    }
+
+    if (best_len >= 3)
+    {
+      FixedMatch(w, best_len, best_dist);
+      i += best_len;
+    }
+    else
+      FixedLiteral(w, data[i++]);
+  }
+  FixedLiteral(w, 256); // end of block
+  return w.Finish();
+}
+
+inline void Chunk(std::string &png, const char *type, const std::vector<std::uint8_t> &body)
+{
+  const auto size = static_cast<std::uint32_t>(body.size());
+  const std::uint8_t header[8] = {static_cast<std::uint8_t>(size >> 24), static_cast<std::uint8_t>(size >> 16),
+                                  static_cast<std::uint8_t>(size >> 8),  static_cast<std::uint8_t>(size),
+                                  static_cast<std::uint8_t>(type[0]),    static_cast<std::uint8_t>(type[1]),
+                                  static_cast<std::uint8_t>(type[2]),    static_cast<std::uint8_t>(type[3])};
+  std::uint32_t crc = Crc32(header + 4, 4);
+  crc               = Crc32(body.data(), body.size(), crc);
+
+  png.append(reinterpret_cast<const char *>(header), 8);
+  png.append(reinterpret_cast<const char *>(body.data()), body.size());
+  for (int shift = 24; shift >= 0; shift -= 8)
+    png.push_back(static_cast<char>(crc >> shift));
+}
+} // namespace png_detail
+
+/// Encode a framebuffer as an 8 bit RGB PNG file image
+inline std::string EncodePng(const FrameBuffer &frame)
+{
+  using namespace png_detail;
+
+  const int row_bytes = 1 + frame.width * 3; // filter byte + RGB
+  std::vector<std::uint8_t> raw;
+  raw.reserve(row_bytes * static_cast<std::size_t>(frame.height));
+  for (int y = 0; y < frame.height; y++)
+  {
+    raw.push_back(0); // no filter
+    const auto *row = frame.Row(y);
+    for (int x = 0; x < frame.width; x++)
+    {
+      raw.push_back(static_cast<std::uint8_t>(row[x] >> 16));
+      raw.push_back(static_cast<std::uint8_t>(row[x] >> 8));
+      raw.push_back(static_cast<std::uint8_t>(row[x]));
+    }
+  }
+
+  std::vector<std::uint8_t> idat{0x78, 0x01}; // zlib header, 32K window
+  const auto deflated = Deflate(raw, 3, row_bytes);
+  idat.insert(idat.end(), deflated.begin(), deflated.end());
+  const auto adler = Adler32(raw);
+  for (int shift = 24; shift >= 0; shift -= 8)
+    idat.push_back(static_cast<std::uint8_t>(adler >> shift));
+
+  const auto w = static_cast<std::uint32_t>(frame.width);
+  const auto h = static_cast<std::uint32_t>(frame.height);
+  const std::vector<std::uint8_t> ihdr{static_cast<std::uint8_t>(w >> 24), static_cast<std::uint8_t>(w >> 16),
+                                       static_cast<std::uint8_t>(w >> 8),  static_cast<std::uint8_t>(w),
+                                       static_cast<std::uint8_t>(h >> 24), static_cast<std::uint8_t>(h >> 16),
+                                       static_cast<std::uint8_t>(h >> 8),  static_cast<std::uint8_t>(h),
+                                       8, // bit depth
+                                       2, // truecolour
+                                       0, 0, 0};
+
+  std::string png{"\x89PNG\r\n\x1a\n", 8};
+  Chunk(png, "IHDR", ihdr);
+  Chunk(png, "IDAT", idat);
+  Chunk(png, "IEND", {});
+  return png;
+}
+
+#endif // !PNG_WRITER_H
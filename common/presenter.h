@@ -0,0 +1,45 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include "framebuffer.h"
+
+/// Display backend. Takes a complete packed framebuffer and puts it on the
+/// screen (or wherever the backend shows pictures) in one bulk transfer.
+///
+/// Implementations must not keep a pointer to the framebuffer after
+/// Present() returns. The caller guarantees the framebuffer is not written
+/// while it is being presented.
+class Presenter
+{
+public:
+  virtual ~Presenter() = default;
+
+  /// Show whole framebuffer
+  virtual void Present(const FrameBuffer &frame) = 0;
+
+  /// Show only a region of the framebuffer, the rest of the display is left
+  /// untouched
+  virtual void Present(const FrameBuffer &frame, const TileRect &rect) = 0;
+};
+
+#endif // !PRESENTER_H
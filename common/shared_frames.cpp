@@ -0,0 +1,364 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include "shared_frames.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shared_frames
+{
+std::size_t BitmapBytes(std::uint32_t tiles_x, std::uint32_t tiles_y) { return (tiles_x * tiles_y + 7) / 8; }
+
+std::size_t PixelOffset(std::uint32_t tiles_x, std::uint32_t tiles_y)
+{
+  return (sizeof(Slot) + BitmapBytes(tiles_x, tiles_y) + 63) / 64 * 64;
+}
+} // namespace shared_frames
+
+using namespace shared_frames;
+
+namespace
+{
+std::size_t HeaderBytes() { return (sizeof(Header) + kPageSize - 1) / kPageSize * kPageSize; }
+
+Slot &SlotAt(std::uint8_t *base, const Header &h, std::uint64_t number)
+{
+  return *reinterpret_cast<Slot *>(base + HeaderBytes() + (number % h.slots) * h.slot_bytes);
+}
+} // namespace
+
+SharedMemory::~SharedMemory()
+{
+  Close();
+}
+
+#ifdef _WIN32
+
+bool SharedMemory::Create(const std::string &name_, std::size_t size_)
+{
+  Close();
+  const auto wide = static_cast<std::uint64_t>(size_);
+  mapping         = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(wide >> 32),
+                                       static_cast<DWORD>(wide), name_.c_str());
+  if (!mapping)
+    return false;
+
+  data = static_cast<std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size_));
+  if (!data)
+  {
+    Close();
+    return false;
+  }
+  size  = size_;
+  owner = true;
+  name  = name_;
+  return true;
+}
+
+bool SharedMemory::Open(const std::string &name_)
+{
+  Close();
+  mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name_.c_str());
+  if (!mapping)
+    return false;
+
+  data = static_cast<std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  MEMORY_BASIC_INFORMATION info{};
+  if (!data || !VirtualQuery(data, &info, sizeof(info)))
+  {
+    Close();
+    return false;
+  }
+  size = info.RegionSize;
+  name = name_;
+  return true;
+}
+
+void SharedMemory::Close()
+{
+  // the mapping disappears with its last handle
+  if (data)
+    UnmapViewOfFile(data);
+  if (mapping)
+    CloseHandle(mapping);
+  data    = nullptr;
+  mapping = nullptr;
+  size    = 0;
+  owner   = false;
+}
+
+#else
+
+bool SharedMemory::Create(const std::string &name_, std::size_t size_)
+{
+  Close();
+  shm_unlink(name_.c_str()); // left over by a crashed writer
+  const int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    return false;
+
+  void *p = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(size_)) == 0)
+    p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+  {
+    shm_unlink(name_.c_str());
+    return false;
+  }
+
+  data  = static_cast<std::uint8_t *>(p);
+  size  = size_;
+  owner = true;
+  name  = name_;
+  return true;
+}
+
+bool SharedMemory::Open(const std::string &name_)
+{
+  Close();
+  const int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+
+  struct stat st{};
+  void *p = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+    return false;
+
+  data = static_cast<std::uint8_t *>(p);
+  size = static_cast<std::size_t>(st.st_size);
+  name = name_;
+  return true;
+}
+
+void SharedMemory::Close()
+{
+  if (data)
+    munmap(data, size);
+  if (owner)
+    shm_unlink(name.c_str());
+  data  = nullptr;
+  size  = 0;
+  owner = false;
+}
+
+#endif
+
+SharedMemoryPresenter::SharedMemoryPresenter(const std::string &name, int width, int height, int slots)
+{
+  const auto tiles_x = static_cast<std::uint32_t>((width + kTile - 1) / kTile);
+  const auto tiles_y = static_cast<std::uint32_t>((height + kTile - 1) / kTile);
+  const std::size_t pixels = width * static_cast<std::size_t>(height) * sizeof(FrameBuffer::Colour);
+  const std::size_t slot_bytes = (PixelOffset(tiles_x, tiles_y) + pixels + kPageSize - 1) / kPageSize * kPageSize;
+
+  if (slots < 2 || !memory.Create(name, HeaderBytes() + slots * slot_bytes))
+    return;
+
+  // fresh shared memory is zero filled: no frame, slot sequences 0
+  header             = reinterpret_cast<Header *>(memory.Data());
+  header->slots      = static_cast<std::uint32_t>(slots);
+  header->width      = static_cast<std::uint32_t>(width);
+  header->height     = static_cast<std::uint32_t>(height);
+  header->stride     = static_cast<std::uint32_t>(width);
+  header->tiles_x    = tiles_x;
+  header->tiles_y    = tiles_y;
+  header->slot_bytes = slot_bytes;
+  header->latest.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header->magic, kMagic, sizeof(kMagic));
+
+  // no slot holds anything yet
+  stale.assign(slots, std::vector<std::uint8_t>(tiles_x * tiles_y, 1));
+}
+
+void SharedMemoryPresenter::Present(const FrameBuffer &frame)
+{
+  if (header)
+    Publish(frame, std::vector<std::uint8_t>(header->tiles_x * header->tiles_y, 1));
+}
+
+void SharedMemoryPresenter::Present(const FrameBuffer &frame, const TileRect &rect)
+{
+  if (!header || rect.width <= 0 || rect.height <= 0)
+    return;
+
+  std::vector<std::uint8_t> dirty(header->tiles_x * header->tiles_y, 0);
+  const int x1 = std::min<int>((rect.x + rect.width - 1) / kTile, header->tiles_x - 1);
+  const int y1 = std::min<int>((rect.y + rect.height - 1) / kTile, header->tiles_y - 1);
+  for (int ty = std::max(rect.y, 0) / kTile; ty <= y1; ty++)
+    for (int tx = std::max(rect.x, 0) / kTile; tx <= x1; tx++)
+      dirty[ty * header->tiles_x + tx] = 1;
+  Publish(frame, dirty);
+}
+
+void SharedMemoryPresenter::Publish(const FrameBuffer &frame, const std::vector<std::uint8_t> &dirty)
+{
+  if (frame.width != static_cast<int>(header->width) || frame.height != static_cast<int>(header->height))
+    return;
+
+  for (auto &s : stale)
+    for (std::size_t t = 0; t < dirty.size(); t++)
+      s[t] |= dirty[t];
+
+  const std::uint64_t n = ++frames;
+  auto &pending = stale[n % header->slots];
+  Slot &slot    = SlotAt(memory.Data(), *header, n);
+  auto *base    = reinterpret_cast<std::uint8_t *>(&slot);
+
+  slot.sequence.store(2 * n - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  // bring the slot up to date, tile by tile
+  auto *pixels = reinterpret_cast<FrameBuffer::Colour *>(base + PixelOffset(header->tiles_x, header->tiles_y));
+  for (std::uint32_t ty = 0; ty < header->tiles_y; ty++)
+    for (std::uint32_t tx = 0; tx < header->tiles_x; tx++)
+    {
+      if (!pending[ty * header->tiles_x + tx])
+        continue;
+      const int x = tx * kTile, y = ty * kTile;
+      const int w = std::min<int>(kTile, frame.width - x), h = std::min<int>(kTile, frame.height - y);
+      for (int r = y; r < y + h; r++)
+        std::memcpy(pixels + r * static_cast<std::size_t>(header->stride) + x, frame.Row(r) + x,
+                    w * sizeof(FrameBuffer::Colour));
+    }
+  std::fill(pending.begin(), pending.end(), std::uint8_t{0});
+
+  auto *bitmap = base + sizeof(Slot);
+  std::memset(bitmap, 0, BitmapBytes(header->tiles_x, header->tiles_y));
+  std::uint32_t count = 0;
+  for (std::size_t t = 0; t < dirty.size(); t++)
+    if (dirty[t])
+    {
+      bitmap[t / 8] |= static_cast<std::uint8_t>(1 << (t % 8));
+      count++;
+    }
+  slot.frame       = n;
+  slot.dirty_tiles = count;
+
+  slot.sequence.store(2 * n, std::memory_order_release);
+  header->latest.store(n, std::memory_order_release);
+}
+
+bool SharedFrameReader::Open(const std::string &name)
+{
+  if (!memory.Open(name) || memory.Size() < HeaderBytes() ||
+      std::memcmp(Head().magic, kMagic, sizeof(kMagic)) != 0 ||
+      memory.Size() < HeaderBytes() + Head().slots * Head().slot_bytes)
+  {
+    memory.Close();
+    return false;
+  }
+  return true;
+}
+
+const Header &SharedFrameReader::Head() const
+{
+  return *reinterpret_cast<const Header *>(memory.Data());
+}
+
+const Slot &SharedFrameReader::SlotOf(std::uint64_t number) const
+{
+  return SlotAt(const_cast<std::uint8_t *>(memory.Data()), Head(), number);
+}
+
+int SharedFrameReader::TilesX() const
+{
+  return static_cast<int>(Head().tiles_x);
+}
+
+int SharedFrameReader::TilesY() const
+{
+  return static_cast<int>(Head().tiles_y);
+}
+
+bool SharedFrameReader::Latest(Frame &frame) const
+{
+  const Header &h = Head();
+  // the writer may lap a slow reader, try the newer frame then
+  for (int attempt = 0; attempt < 16; attempt++)
+  {
+    const std::uint64_t n = h.latest.load(std::memory_order_acquire);
+    if (n == 0)
+      return false;
+
+    const Slot &slot = SlotOf(n);
+    if (slot.sequence.load(std::memory_order_acquire) != 2 * n)
+      continue;
+
+    const auto *base = reinterpret_cast<const std::uint8_t *>(&slot);
+    frame.number     = n;
+    frame.width      = static_cast<int>(h.width);
+    frame.height     = static_cast<int>(h.height);
+    frame.stride     = static_cast<int>(h.stride);
+    frame.dirty      = base + sizeof(Slot);
+    frame.pixels     = reinterpret_cast<const FrameBuffer::Colour *>(base + PixelOffset(h.tiles_x, h.tiles_y));
+    return true;
+  }
+  return false;
+}
+
+bool SharedFrameReader::StillValid(const Frame &frame) const
+{
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return SlotOf(frame.number).sequence.load(std::memory_order_relaxed) == 2 * frame.number;
+}
+
+std::vector<std::uint8_t> SharedFrameReader::DirtySince(std::uint64_t seen, const Frame &frame) const
+{
+  const Header &h = Head();
+  std::vector<std::uint8_t> dirty(h.tiles_x * h.tiles_y, 0);
+  if (seen == 0 || seen >= frame.number || frame.number - seen >= h.slots)
+  {
+    std::fill(dirty.begin(), dirty.end(), static_cast<std::uint8_t>(seen == frame.number ? 0 : 1));
+    return dirty;
+  }
+
+  for (std::uint64_t n = seen + 1; n <= frame.number; n++)
+  {
+    const Slot &slot    = SlotOf(n);
+    const auto *bitmap  = reinterpret_cast<const std::uint8_t *>(&slot) + sizeof(Slot);
+    for (std::size_t t = 0; t < dirty.size(); t++)
+      dirty[t] |= (bitmap[t / 8] >> (t % 8)) & 1;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != 2 * n)
+    {
+      // overwritten while reading
+      std::fill(dirty.begin(), dirty.end(), std::uint8_t{1});
+      break;
+    }
+  }
+  return dirty;
+}
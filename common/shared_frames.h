@@ -0,0 +1,180 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#ifndef SHARED_FRAMES_H
+#define SHARED_FRAMES_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "presenter.h"
+
+/// Ring of packed framebuffers in named shared memory, for handing frames to
+/// other processes (viewers, compositors) without copies through files.
+///
+/// Layout: a Header padded to a page, then `slots` slots of one Slot
+/// header, the dirty tile bitmap and the pixels each. Frame n (counting from
+/// 1) is written into slot n % slots. Each slot is a sequence lock: its
+/// sequence is odd while the writer fills it and 2 * n once frame n is
+/// complete, so a reader can check that what it read was not overwritten.
+namespace shared_frames
+{
+constexpr char kMagic[8]        = {'M', 'B', 'F', 'R', 'A', 'M', 'E', '1'};
+constexpr std::uint32_t kTile   = 64; ///< edge of a dirty tile, in pixels
+constexpr std::size_t kPageSize = 4096;
+
+struct Header
+{
+  char magic[8];
+  std::uint32_t slots;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t stride; ///< pixels between two rows
+  std::uint32_t tiles_x;
+  std::uint32_t tiles_y;
+  std::uint64_t slot_bytes;
+  std::atomic<std::uint64_t> latest; ///< number of the newest complete frame, 0 - none yet
+};
+
+struct Slot
+{
+  std::atomic<std::uint64_t> sequence;
+  std::uint64_t frame;
+  std::uint32_t dirty_tiles; ///< number of bits set in the bitmap
+  std::uint32_t reserved;
+  // followed by the bitmap of tiles changed since the previous frame,
+  // tile (x, y) is bit y * tiles_x + x, then the pixels from the next
+  // 64 byte boundary
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared between processes");
+
+std::size_t BitmapBytes(std::uint32_t tiles_x, std::uint32_t tiles_y);
+std::size_t PixelOffset(std::uint32_t tiles_x, std::uint32_t tiles_y);
+} // namespace shared_frames
+
+/// Shared memory mapping, named and sized by the writer
+class SharedMemory
+{
+public:
+  SharedMemory() = default;
+  ~SharedMemory();
+
+  SharedMemory(const SharedMemory &)            = delete;
+  SharedMemory &operator=(const SharedMemory &) = delete;
+
+  /// Create (or replace) the named memory, writable
+  bool Create(const std::string &name, std::size_t size);
+
+  /// Map memory created by another process, read only
+  bool Open(const std::string &name);
+
+  void Close();
+
+  bool Valid() const { return data != nullptr; }
+  std::uint8_t *Data() { return data; }
+  const std::uint8_t *Data() const { return data; }
+  std::size_t Size() const { return size; }
+
+private:
+  std::uint8_t *data{nullptr};
+  std::size_t size{0};
+  bool owner{false};
+  std::string name;
+#ifdef _WIN32
+  void *mapping{nullptr};
+#endif
+};
+
+/// Display backend publishing frames into a shared memory ring.
+///
+/// Frames of another size than the ring was created with are dropped. Only
+/// the tiles changed since a slot was last written are copied into it.
+class SharedMemoryPresenter : public Presenter
+{
+public:
+  /// @param name - shared memory name, "/name" on POSIX
+  /// @param slots - frames kept in the ring; a reader has slots - 1 frame
+  ///                times to read a frame before it is overwritten
+  SharedMemoryPresenter(const std::string &name, int width, int height, int slots = 3);
+
+  bool Valid() const { return memory.Valid(); }
+
+  void Present(const FrameBuffer &frame) override;
+  void Present(const FrameBuffer &frame, const TileRect &rect) override;
+
+  /// Number of the last published frame
+  std::uint64_t Frames() const { return frames; }
+
+private:
+  void Publish(const FrameBuffer &frame, const std::vector<std::uint8_t> &dirty);
+
+  SharedMemory memory;
+  shared_frames::Header *header{nullptr};
+  std::uint64_t frames{0};
+  std::vector<std::vector<std::uint8_t>> stale; ///< per slot: tiles changed since it was written
+};
+
+/// Reading side of a SharedMemoryPresenter ring
+class SharedFrameReader
+{
+public:
+  struct Frame
+  {
+    std::uint64_t number{0};
+    int width{0};
+    int height{0};
+    int stride{0};
+    const FrameBuffer::Colour *pixels{nullptr};
+    const std::uint8_t *dirty{nullptr}; ///< tiles changed since frame number - 1
+  };
+
+  bool Open(const std::string &name);
+  bool Valid() const { return memory.Valid(); }
+
+  /// Newest complete frame, pointing into the shared memory. Check
+  /// StillValid() after reading the pixels.
+  ///
+  /// @returns false if no frame was published yet
+  bool Latest(Frame &frame) const;
+
+  /// True if the writer did not start overwriting the frame since Latest()
+  bool StillValid(const Frame &frame) const;
+
+  /// Tiles changed between frame `seen` and `frame`, one byte per tile
+  /// (tile y * TilesX() + x). Everything when frames in between are no
+  /// longer in the ring.
+  std::vector<std::uint8_t> DirtySince(std::uint64_t seen, const Frame &frame) const;
+
+  int TilesX() const;
+  int TilesY() const;
+
+private:
+  const shared_frames::Header &Head() const;
+  const shared_frames::Slot &SlotOf(std::uint64_t number) const;
+
+  SharedMemory memory;
+};
+
+#endif // !SHARED_FRAMES_H
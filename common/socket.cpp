@@ -0,0 +1,238 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include "socket.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+void CloseSocket(SocketHandle h)
+{
+  closesocket(h);
+}
+constexpr int kShutdownBoth = SD_BOTH;
+using SockLen               = int;
+#else
+void CloseSocket(SocketHandle h)
+{
+  ::close(h);
+}
+constexpr int kShutdownBoth = SHUT_RDWR;
+using SockLen               = socklen_t;
+#endif
+
+void NoDelay(SocketHandle h)
+{
+  // tiles are written in one go, do not hold back the tail of a response
+  int one = 1;
+  setsockopt(h, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
+}
+} // namespace
+
+SocketLibrary::SocketLibrary()
+{
+#ifdef _WIN32
+  WSADATA data;
+  WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+}
+
+SocketLibrary::~SocketLibrary()
+{
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+Socket::Socket(SocketHandle h)
+    : handle{h}
+#ifdef _WIN32
+    , open{h != INVALID_SOCKET}
+#else
+    , open{h >= 0}
+#endif
+{
+}
+
+Socket::~Socket()
+{
+  Close();
+}
+
+Socket::Socket(Socket &&other) noexcept
+    : handle{other.handle}
+    , open{std::exchange(other.open, false)}
+{
+}
+
+Socket &Socket::operator=(Socket &&other) noexcept
+{
+  if (this != &other)
+  {
+    Close();
+    handle = other.handle;
+    open   = std::exchange(other.open, false);
+  }
+  return *this;
+}
+
+bool Socket::Valid() const
+{
+  return open;
+}
+
+void Socket::Close()
+{
+  if (open)
+    CloseSocket(handle);
+  open = false;
+}
+
+Socket Socket::Listen(std::uint16_t port, bool loopback_only, int backlog)
+{
+  Socket s{::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)};
+  if (!s)
+    return s;
+
+  int one = 1;
+  setsockopt(s.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&one), sizeof(one));
+
+  sockaddr_in addr{};
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(loopback_only ? INADDR_LOOPBACK : INADDR_ANY);
+  if (bind(s.handle, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(s.handle, backlog) != 0)
+    s.Close();
+
+  return s;
+}
+
+Socket Socket::Connect(const std::string &host, std::uint16_t port)
+{
+  addrinfo hints{};
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo *found = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0)
+    return {};
+
+  Socket s;
+  for (auto *a = found; a && !s; a = a->ai_next)
+  {
+    s = Socket{::socket(a->ai_family, a->ai_socktype, a->ai_protocol)};
+    if (s && connect(s.handle, a->ai_addr, static_cast<SockLen>(a->ai_addrlen)) != 0)
+      s.Close();
+  }
+  freeaddrinfo(found);
+
+  if (s)
+    NoDelay(s.handle);
+  return s;
+}
+
+Socket Socket::Accept() const
+{
+  Socket s{::accept(handle, nullptr, nullptr)};
+  if (s)
+    NoDelay(s.handle);
+  return s;
+}
+
+std::uint16_t Socket::LocalPort() const
+{
+  sockaddr_in addr{};
+  SockLen len = sizeof(addr);
+  if (getsockname(handle, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+    return 0;
+  return ntohs(addr.sin_port);
+}
+
+long Socket::Receive(void *data, std::size_t size) const
+{
+  return static_cast<long>(recv(handle, static_cast<char *>(data), static_cast<int>(size), 0));
+}
+
+bool Socket::ReceiveAll(void *data, std::size_t size) const
+{
+  auto *p = static_cast<char *>(data);
+  while (size > 0)
+  {
+    const long n = Receive(p, size);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool Socket::SendAll(const void *data, std::size_t size) const
+{
+#ifdef MSG_NOSIGNAL
+  constexpr int flags = MSG_NOSIGNAL; // closed peer is an error, not a signal
+#else
+  constexpr int flags = 0;
+#endif
+  constexpr int kMaxChunk = 1 << 20;
+
+  auto *p = static_cast<const char *>(data);
+  while (size > 0)
+  {
+    const int chunk = size > kMaxChunk ? kMaxChunk : static_cast<int>(size);
+    const auto n    = send(handle, p, chunk, flags);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+void Socket::Shutdown() const
+{
+  if (open)
+    shutdown(handle, kShutdownBoth);
+}
+
+void Socket::SetReceiveTimeout(int ms) const
+{
+#ifdef _WIN32
+  const DWORD timeout = ms;
+#else
+  timeval timeout{ms / 1000, (ms % 1000) * 1000};
+#endif
+  setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+}
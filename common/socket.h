@@ -0,0 +1,102 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+using SocketHandle = SOCKET;
+#else
+using SocketHandle = int;
+#endif
+
+/// Initialises the socket library of the OS for the lifetime of the object.
+/// Create one in main() before using any Socket (no-op outside Windows).
+class SocketLibrary
+{
+public:
+  SocketLibrary();
+  ~SocketLibrary();
+
+  SocketLibrary(const SocketLibrary &)            = delete;
+  SocketLibrary &operator=(const SocketLibrary &) = delete;
+};
+
+/// Blocking TCP socket, closed when destroyed.
+///
+/// Failures are reported by return values: an invalid socket from the
+/// factories, false or a negative count from the transfer functions.
+class Socket
+{
+public:
+  Socket() = default;
+  explicit Socket(SocketHandle h);
+  ~Socket();
+
+  Socket(Socket &&other) noexcept;
+  Socket &operator=(Socket &&other) noexcept;
+
+  /// Listen for connections on all interfaces (or loopback only)
+  ///
+  /// @param port - TCP port, 0 picks a free one (see LocalPort())
+  static Socket Listen(std::uint16_t port, bool loopback_only = false, int backlog = 64);
+
+  /// Connect to a host name or address
+  static Socket Connect(const std::string &host, std::uint16_t port);
+
+  bool Valid() const;
+  explicit operator bool() const { return Valid(); }
+
+  /// Wait for an incoming connection on a listening socket
+  Socket Accept() const;
+
+  /// Port the socket is bound to
+  std::uint16_t LocalPort() const;
+
+  /// Receive up to `size` bytes
+  ///
+  /// @returns number of bytes received, 0 if the peer closed, < 0 on error
+  long Receive(void *data, std::size_t size) const;
+
+  /// Receive exactly `size` bytes
+  bool ReceiveAll(void *data, std::size_t size) const;
+
+  /// Send all bytes
+  bool SendAll(const void *data, std::size_t size) const;
+
+  /// Make Receive fail instead of blocking longer than `ms` (0 - forever)
+  void SetReceiveTimeout(int ms) const;
+
+  /// Stop both directions, unblocks a thread waiting in Accept/Receive
+  void Shutdown() const;
+
+  void Close();
+
+private:
+  SocketHandle handle;
+  bool open{false};
+};
+
+#endif // !SOCKET_H
@@ -18,39 +18,40 @@
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 /// THE SOFTWARE.
 
-#include <windows.h>
-#include <gdiplus.h>
-#include <objidl.h>
-#pragma comment(lib, "Gdiplus.lib")
+#include "win_drawing.h"
 
-#include "image.h"
-#include <memory>
-
-void DrawImage(Gdiplus::Bitmap &hnd, const Image &image)
+namespace
+{
+BITMAPINFO DibHeader(const FrameBuffer &frame, int rows)
 {
-  int width{0};
-  int height{0};
-  for (const auto &pixel : image)
-  {
-    if (width >= image.width)
-    {
-      width = 0;
-      height++;
-    }
-    hnd.SetPixel(width++, height, Gdiplus::Color(0xFF000000 | Colour(pixel, false)));
-  }
+  BITMAPINFO bmi{};
+  bmi.bmiHeader.biSize        = sizeof(bmi.bmiHeader);
+  bmi.bmiHeader.biWidth       = frame.Stride();
+  bmi.bmiHeader.biHeight      = -rows; // negative for top-down rows
+  bmi.bmiHeader.biPlanes      = 1;
+  bmi.bmiHeader.biBitCount    = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+  return bmi;
 }
+} // namespace
 
-std::unique_ptr<Gdiplus::Bitmap> g_bitmap;
+DibPresenter::DibPresenter(HDC hdc_)
+    : hdc{hdc_}
+{
+}
 
-void OnPaint(HDC &hnd, Image &image)
+void DibPresenter::Present(const FrameBuffer &frame)
 {
-  Gdiplus::Graphics g(hnd);
-  if (!g_bitmap)
-  {
-    g_bitmap = std::make_unique<Gdiplus::Bitmap>(image.width, image.height, &g);
-  }
-  DrawImage(*g_bitmap, image);
-  g.DrawImage(g_bitmap.get(), 0, 0);
+  const BITMAPINFO bmi = DibHeader(frame, frame.height);
+  SetDIBitsToDevice(hdc, 0, 0, frame.width, frame.height, 0, 0, 0, frame.height, frame.Data(), &bmi,
+                    DIB_RGB_COLORS);
 }
 
+void DibPresenter::Present(const FrameBuffer &frame, const TileRect &rect)
+{
+  // Describe only the rows of the region so the source origin is not subject
+  // to the bottom-up/top-down scan line numbering of SetDIBitsToDevice.
+  const BITMAPINFO bmi = DibHeader(frame, rect.height);
+  SetDIBitsToDevice(hdc, rect.x, rect.y, rect.width, rect.height, rect.x, 0, 0, rect.height, frame.Row(rect.y),
+                    &bmi, DIB_RGB_COLORS);
+}
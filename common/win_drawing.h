@@ -0,0 +1,44 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#ifndef WIN_DRAWING_H
+#define WIN_DRAWING_H
+
+#include <Windows.h>
+
+#include "presenter.h"
+
+/// Windows display backend. Blits packed framebuffer straight to a device
+/// context as a top-down 32 bpp DIB. There is no intermediate bitmap and no
+/// per pixel call; GDI reads the framebuffer memory directly.
+class DibPresenter : public Presenter
+{
+public:
+  /// @param hdc - device context to draw on, usually from BeginPaint()
+  explicit DibPresenter(HDC hdc);
+
+  void Present(const FrameBuffer &frame) override;
+  void Present(const FrameBuffer &frame, const TileRect &rect) override;
+
+private:
+  HDC hdc;
+};
+
+#endif // !WIN_DRAWING_H
@@ -0,0 +1,243 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <new>
+#include "mandelbrot_api.h"
+#include "area_estimate.h"
+#include "mandel_algo.h"
+#include "render_pool.h"
+#include "tile_store.h"
+
+struct mb_context {
+	std::mutex lock;             // one render at a time
+	std::unique_ptr<TileStore> store;
+	MandelbrotCounts counts;     // of pixel renders, kept for the allocation
+	mutable std::mutex stats_lock; // of `stats` only, so they are read while rendering
+	mb_stats stats{};
+};
+
+namespace {
+
+bool ToParams(const mb_view* view, MandelbrotParams& p)
+{
+	if (!view || !(view->x_range > 0) || !(view->y_range > 0) || view->depth <= 0 ||
+		view->fractal < MB_FRACTAL_MANDELBROT || view->fractal > MB_FRACTAL_TRICORN ||
+		view->power < 2 || view->power > kMaxMultibrotPower)
+		return false;
+	p.x_start = view->x_start;
+	p.y_start = view->y_start;
+	p.x_range = view->x_range;
+	p.y_range = view->y_range;
+	p.depth = view->depth;
+	p.fractal = static_cast<Fractal>(view->fractal);
+	p.power = view->power;
+	p.c_re = view->c_re;
+	p.c_im = view->c_im;
+	return true;
+}
+
+MandelbrotPalette ToPalette(const mb_palette* palette)
+{
+	MandelbrotPalette p;
+	if (!palette)
+		return p;
+	p.mode = palette->mode == MB_PALETTE_CYCLIC ? MandelbrotPalette::Mode::cyclic : MandelbrotPalette::Mode::histogram;
+	p.hue_offset = palette->hue_offset;
+	p.hue_scale = palette->hue_scale;
+	p.cycle = palette->cycle > 0 ? palette->cycle : MandelbrotPalette{}.cycle;
+	p.inside = { palette->inside_r, palette->inside_g, palette->inside_b };
+	return p;
+}
+
+// 4 byte elements, rows at least `width` elements apart and within int range
+bool ValidBuffer(const void* data, int32_t width, int32_t height, ptrdiff_t stride)
+{
+	return data && width > 0 && height > 0 && stride % 4 == 0 && stride / 4 >= width && stride / 4 <= INT32_MAX;
+}
+
+// Run `render` under the context lock, timing it into the stats and keeping
+// exceptions on this side of the interface
+template <typename Render>
+int Guarded(mb_context* context, int32_t width, int32_t height, Render&& render)
+{
+	try
+	{
+		std::lock_guard<std::mutex> guard{ context->lock };
+		const auto start = std::chrono::steady_clock::now();
+		const int max = render();
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> stats_guard{ context->stats_lock };
+		mb_stats& s = context->stats;
+		s.frames++;
+		s.pixels += static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+		s.last_ms = ms;
+		s.total_ms += ms;
+		s.last_max = max;
+		return MB_OK;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return MB_ERROR_OUT_OF_MEMORY;
+	}
+	catch (...)
+	{
+		return MB_ERROR_INTERNAL;
+	}
+}
+
+} // namespace
+
+int mb_api_version(void)
+{
+	return MB_API_VERSION;
+}
+
+void mb_default_view(mb_view* view)
+{
+	if (!view)
+		return;
+	const MandelbrotParams p;
+	*view = { p.x_start, p.y_start, p.x_range, p.y_range, p.depth, static_cast<int32_t>(p.fractal), p.power,
+		p.c_re, p.c_im };
+}
+
+void mb_default_palette(mb_palette* palette)
+{
+	if (!palette)
+		return;
+	const MandelbrotPalette p;
+	*palette = { MB_PALETTE_HISTOGRAM, p.hue_offset, p.hue_scale, p.cycle, p.inside.x, p.inside.y, p.inside.z };
+}
+
+mb_context* mb_create(const char* tile_store_path)
+{
+	try
+	{
+		auto context = std::make_unique<mb_context>();
+		if (tile_store_path)
+		{
+			context->store = std::make_unique<TileStore>();
+			if (!context->store->Open(tile_store_path))
+				context->store.reset();
+		}
+		return context.release();
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void mb_destroy(mb_context* context)
+{
+	delete context;
+}
+
+int mb_render_counts(mb_context* context, const mb_view* view, int32_t width, int32_t height,
+	int32_t* counts, ptrdiff_t stride)
+{
+	MandelbrotParams p;
+	if (!context || !ToParams(view, p) || !ValidBuffer(counts, width, height, stride))
+		return MB_ERROR_ARGUMENT;
+
+	static_assert(sizeof(int) == sizeof(int32_t), "counts are written as int");
+	return Guarded(context, width, height, [&] {
+		return Mandelbrot_ComputeInto(p, width, height, reinterpret_cast<int*>(counts), static_cast<int>(stride / 4),
+			context->store.get());
+		});
+}
+
+int mb_render_pixels(mb_context* context, const mb_view* view, int32_t width, int32_t height,
+	const mb_palette* palette, int32_t format, uint8_t* pixels, ptrdiff_t stride)
+{
+	MandelbrotParams p;
+	if (!context || !ToParams(view, p) || !ValidBuffer(pixels, width, height, stride) ||
+		(format != MB_PIXELS_BGRA && format != MB_PIXELS_RGBA))
+		return MB_ERROR_ARGUMENT;
+
+	return Guarded(context, width, height, [&] {
+		// the histogram palette needs all counts before the first colour
+		context->counts = Mandelbrot_Compute(p, width, height, false, {}, context->store.get());
+		auto* out = reinterpret_cast<FrameBuffer::Colour*>(pixels);
+		const int row = static_cast<int>(stride / 4);
+		Mandelbrot_Shade(context->counts, ToPalette(palette), out, row);
+
+		// 0xAARRGGBB words are B, G, R, A in memory
+		if (format == MB_PIXELS_RGBA)
+			SharedRenderPool().ParallelFor(height, [&](int y) {
+				FrameBuffer::Colour* c = out + y * static_cast<size_t>(row);
+				for (int x = 0; x < width; x++)
+					c[x] = (c[x] & 0xFF00FF00) | (c[x] >> 16 & 0xFF) | (c[x] & 0xFF) << 16;
+				});
+		return context->counts.max;
+		});
+}
+
+int mb_estimate_area(const mb_view* view, uint64_t max_samples, double target_error, uint32_t seed,
+	mb_area_progress progress, void* user, mb_area* result)
+{
+	MandelbrotParams p;
+	if (!ToParams(view, p) || p.fractal != Fractal::mandelbrot || max_samples == 0 || !result)
+		return MB_ERROR_ARGUMENT;
+
+	auto to_c = [](const MandelbrotAreaEstimate& e) {
+		return mb_area{ e.samples, e.inside, e.fraction, e.fraction_error, e.area, e.area_error, e.seconds };
+	};
+	try
+	{
+		MandelbrotAreaOptions options;
+		options.max_samples = max_samples;
+		options.target_error = target_error;
+		options.seed = seed;
+		MandelbrotAreaProgress report;
+		if (progress)
+			report = [&](const MandelbrotAreaEstimate& e) {
+				const mb_area area = to_c(e);
+				return progress(&area, user) != 0;
+			};
+		*result = to_c(Mandelbrot_EstimateArea(p, options, std::move(report)));
+		return MB_OK;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return MB_ERROR_OUT_OF_MEMORY;
+	}
+	catch (...)
+	{
+		return MB_ERROR_INTERNAL;
+	}
+}
+
+int mb_get_stats(const mb_context* context, mb_stats* stats)
+{
+	if (!context || !stats)
+		return MB_ERROR_ARGUMENT;
+
+	std::lock_guard<std::mutex> guard{ context->stats_lock };
+	*stats = context->stats;
+	stats->threads = SharedRenderPool().ActiveThreads() + 1;
+	stats->tile_size = Mandelbrot_Tuning().tile_size;
+	return MB_OK;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+/* C interface of the renderer, for use from other languages (ctypes, cffi,
+ * Rust FFI) without going through the executables.
+ *
+ * A context renders views into memory owned by the caller: counts as 32 bit
+ * integers or colours as 4 bytes per pixel, rows `stride` bytes apart, so a
+ * NumPy array (or any strided 2D buffer) is filled in place. Functions
+ * return MB_OK or a negative MB_ERROR_* code; nothing is thrown across the
+ * interface. One render at a time per context (mb_get_stats may be called
+ * meanwhile), separate contexts may render concurrently. The interface only grows: structs are passed by pointer and
+ * MB_API_VERSION is raised when something is added.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* MANDELBROT_API_STATIC - the sources are built into the program itself */
+#if defined(MANDELBROT_API_STATIC)
+#define MB_API
+#elif defined(_WIN32)
+#ifdef MANDELBROT_API_EXPORTS
+#define MB_API __declspec(dllexport)
+#else
+#define MB_API __declspec(dllimport)
+#endif
+#else
+#define MB_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MB_API_VERSION 2
+
+enum {
+	MB_OK = 0,
+	MB_ERROR_ARGUMENT = -1,      /* null pointer, bad size, stride or view */
+	MB_ERROR_OUT_OF_MEMORY = -2,
+	MB_ERROR_INTERNAL = -3,
+};
+
+enum {
+	MB_FRACTAL_MANDELBROT = 0,
+	MB_FRACTAL_JULIA = 1,        /* c fixed to (c_re, c_im) */
+	MB_FRACTAL_MULTIBROT = 2,    /* z^power + c */
+	MB_FRACTAL_BURNING_SHIP = 3,
+	MB_FRACTAL_TRICORN = 4,
+};
+
+enum {
+	MB_PIXELS_BGRA = 0,          /* bytes B, G, R, A: a 32 bpp Windows DIB */
+	MB_PIXELS_RGBA = 1,          /* bytes R, G, B, A: PIL, NumPy image code */
+};
+
+enum {
+	MB_PALETTE_HISTOGRAM = 0,    /* hue follows the cumulative histogram of the picture */
+	MB_PALETTE_CYCLIC = 1,       /* hue repeats every `cycle` iterations */
+};
+
+/* Region of the plane and iteration depth, fill with mb_default_view() */
+typedef struct mb_view {
+	double x_start;
+	double y_start;
+	double x_range;
+	double y_range;
+	int32_t depth;
+	int32_t fractal;
+	int32_t power;               /* multibrot, 2 .. 8 */
+	double c_re;                 /* julia */
+	double c_im;
+} mb_view;
+
+typedef struct mb_palette {
+	int32_t mode;
+	double hue_offset;           /* histogram: added to the hue */
+	double hue_scale;            /* histogram: multiplies the hue */
+	double cycle;                /* cyclic: iterations per turn of the colour wheel */
+	float inside_r, inside_g, inside_b; /* 0 .. 1 */
+} mb_palette;
+
+typedef struct mb_stats {
+	uint64_t frames;             /* renders completed by the context */
+	uint64_t pixels;             /* their pixels */
+	double last_ms;              /* time of the last render */
+	double total_ms;
+	int32_t last_max;            /* highest count of the last render */
+	int32_t threads;             /* render threads, including the caller */
+	int32_t tile_size;
+} mb_stats;
+
+/* Quasi-Monte Carlo estimate of the set inside a view, since version 2 */
+typedef struct mb_area {
+	uint64_t samples;
+	uint64_t inside;             /* samples which did not escape within the depth */
+	double fraction;             /* of the view inside the set */
+	double fraction_error;       /* half width of the 95% confidence interval */
+	double area;                 /* fraction times the area of the view */
+	double area_error;
+	double seconds;
+} mb_area;
+
+/* Called after every round of samples, return 0 to stop */
+typedef int (*mb_area_progress)(const mb_area* estimate, void* user);
+
+typedef struct mb_context mb_context;
+
+MB_API int mb_api_version(void);
+
+MB_API void mb_default_view(mb_view* view);
+MB_API void mb_default_palette(mb_palette* palette);
+
+/* Renderer context. With a `tile_store_path` (may be null) tiles computed
+ * before are taken from that file and new ones added to it. Null when out
+ * of memory. */
+MB_API mb_context* mb_create(const char* tile_store_path);
+MB_API void mb_destroy(mb_context* context);
+
+/* Iteration counts of `view` at width x height into `counts`, points inside
+ * the set get depth + 1. `stride` >= 4 * width, multiple of 4. */
+MB_API int mb_render_counts(mb_context* context, const mb_view* view, int32_t width, int32_t height,
+	int32_t* counts, ptrdiff_t stride);
+
+/* Coloured picture of `view` into `pixels` in `format` (MB_PIXELS_*), alpha
+ * opaque. `palette` may be null for the default one. `stride` >= 4 * width,
+ * multiple of 4. */
+MB_API int mb_render_pixels(mb_context* context, const mb_view* view, int32_t width, int32_t height,
+	const mb_palette* palette, int32_t format, uint8_t* pixels, ptrdiff_t stride);
+
+/* Area of the Mandelbrot set inside `view` (fractal MB_FRACTAL_MANDELBROT)
+ * from up to `max_samples` Sobol points, stopping early once `area_error`
+ * is at most `target_error` (0 - never) or `progress` (may be null) says
+ * so. Needs no context and no buffer; the final estimate goes to `result`. */
+MB_API int mb_estimate_area(const mb_view* view, uint64_t max_samples, double target_error, uint32_t seed,
+	mb_area_progress progress, void* user, mb_area* result);
+
+/* Counters of the context, does not wait for a render in progress */
+MB_API int mb_get_stats(const mb_context* context, mb_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,254 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "area_estimate.h"
+#include "fractal_formulas.h"
+#include "render_pool.h"
+
+namespace {
+
+constexpr int kFirstRoundBits = 10;          // 2^10 points per replicate in the first round
+constexpr int kMaxRoundBits = 32;            // Sobol indices are 32 bit
+constexpr std::uint32_t kChunk = 1u << 16;   // points of one ParallelFor item
+constexpr double kCycleEpsilon2 = 1e-20;     // |z - saved z|^2 taken as a closed orbit
+
+// Direction numbers: van der Corput for x, the primitive polynomial x + 1 for y
+constexpr std::array<std::uint32_t, 32> kDirectionX = [] {
+	std::array<std::uint32_t, 32> v{};
+	for (int k = 0; k < 32; k++)
+		v[k] = 1u << (31 - k);
+	return v;
+}();
+constexpr std::array<std::uint32_t, 32> kDirectionY = [] {
+	std::array<std::uint32_t, 32> v{};
+	v[0] = 1u << 31;
+	for (int k = 1; k < 32; k++)
+		v[k] = v[k - 1] ^ (v[k - 1] >> 1);
+	return v;
+}();
+
+// Digitally shifted 2D Sobol points in Gray code order, from `index` on
+class Sobol2 {
+public:
+	Sobol2(std::uint32_t index, std::uint32_t shift_x, std::uint32_t shift_y) : next{ index }, x{ shift_x }, y{ shift_y }
+	{
+		const std::uint32_t gray = index ^ (index >> 1);
+		for (int k = 0; k < 32; k++)
+			if (gray >> k & 1)
+			{
+				x ^= kDirectionX[k];
+				y ^= kDirectionY[k];
+			}
+	}
+
+	void Next(std::uint32_t& px, std::uint32_t& py)
+	{
+		px = x;
+		py = y;
+		const int bit = std::countr_zero(++next);
+		x ^= kDirectionX[bit & 31];
+		y ^= kDirectionY[bit & 31];
+	}
+
+private:
+	std::uint32_t next;
+	std::uint32_t x, y;
+};
+
+// Main cardioid or period 2 bulb
+bool InsideShortcut(double x, double y)
+{
+	const double xq = x - 0.25;
+	const double q = xq * xq + y * y;
+	if (q * (q + xq) <= 0.25 * y * y)
+		return true;
+	return (x + 1) * (x + 1) + y * y <= 1. / 16;
+}
+
+// How many of the next `n` points of `sobol` stay bounded for the depth,
+// tested in lanes refilled as points finish
+std::uint64_t CountInside(const MandelbrotParams& region, Sobol2 sobol, std::uint32_t n)
+{
+	constexpr double kScale = 1. / 4294967296.;
+	const double sx = region.x_range * kScale, sy = region.y_range * kScale;
+	const double x0 = region.x_start + 0.5 * sx, y0 = region.y_start + 0.5 * sy;
+	const int depth = region.depth;
+	const MandelbrotFormula f;
+
+	constexpr int L = kFormulaLanes;
+	double zx[L], zy[L], cx[L], cy[L], keep_x[L], keep_y[L];
+	int count[L], keep_at[L];
+	bool live[L];
+	std::uint32_t left = n;
+	std::uint64_t inside = 0;
+	int busy = 0;
+
+	// lane l takes the next point which needs iterating
+	auto refill = [&](int l) {
+		while (left > 0)
+		{
+			left--;
+			std::uint32_t ux, uy;
+			sobol.Next(ux, uy);
+			const double x = x0 + ux * sx, y = y0 + uy * sy;
+			if (InsideShortcut(x, y))
+			{
+				inside++;
+				continue;
+			}
+			f.Start(x, y, zx[l], zy[l], cx[l], cy[l]);
+			keep_x[l] = keep_y[l] = 0;
+			count[l] = 0;
+			keep_at[l] = kStreamBlock;
+			live[l] = true;
+			busy++;
+			return;
+		}
+		zx[l] = zy[l] = cx[l] = cy[l] = 0;
+		count[l] = depth; // never active
+		live[l] = false;
+	};
+	for (int l = 0; l < L; l++)
+		refill(l);
+
+	while (busy > 0)
+	{
+		for (int it = 0; it < kStreamBlock; it++)
+			for (int l = 0; l < L; l++)
+			{
+				const bool active = zx[l] * zx[l] + zy[l] * zy[l] <= 4. && count[l] < depth;
+				double nx, ny;
+				f.Step(zx[l], zy[l], cx[l], cy[l], nx, ny);
+				zx[l] = active ? nx : zx[l];
+				zy[l] = active ? ny : zy[l];
+				count[l] += active;
+			}
+
+		for (int l = 0; l < L; l++)
+		{
+			if (!live[l])
+				continue;
+			const bool escaped = zx[l] * zx[l] + zy[l] * zy[l] > 4.;
+			bool bounded = count[l] >= depth;
+			if (!escaped && !bounded)
+			{
+				// Brent style: compare with z saved at the last power of two
+				const double dx = zx[l] - keep_x[l], dy = zy[l] - keep_y[l];
+				if (dx * dx + dy * dy < kCycleEpsilon2)
+					bounded = true;
+				else if (count[l] >= keep_at[l])
+				{
+					keep_x[l] = zx[l];
+					keep_y[l] = zy[l];
+					keep_at[l] *= 2;
+				}
+				if (!bounded)
+					continue;
+			}
+			inside += !escaped;
+			busy--;
+			refill(l);
+		}
+	}
+	return inside;
+}
+
+// Two sided 95% quantile of Student's t with `df` degrees of freedom
+// (Cornish-Fisher expansion, within 0.01 from df = 3 on)
+double Student95(int df)
+{
+	const double z = 1.959964, z3 = z * z * z, z5 = z3 * z * z;
+	return z + (z3 + z) / (4. * df) + (5 * z5 + 16 * z3 + 3 * z) / (96. * df * df);
+}
+
+} // namespace
+
+MandelbrotAreaEstimate Mandelbrot_EstimateArea(const MandelbrotParams& region, const MandelbrotAreaOptions& options,
+	MandelbrotAreaProgress&& progress)
+{
+	MandelbrotAreaEstimate estimate;
+	const int replicates = std::max(options.replicates, 2);
+	if (region.fractal != Fractal::mandelbrot || !(region.x_range > 0) || !(region.y_range > 0))
+		return estimate;
+
+	std::mt19937 rng{ options.seed };
+	std::vector<std::uint32_t> shift(2 * replicates);
+	for (auto& s : shift)
+		s = static_cast<std::uint32_t>(rng());
+
+	std::vector<std::uint64_t> inside(replicates);
+	const double region_area = region.x_range * region.y_range;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int bits = kFirstRoundBits; bits <= kMaxRoundBits; bits++)
+	{
+		// indices [begin, end) of every replicate, all of 0 .. 2^bits after the round
+		const std::uint64_t begin = bits == kFirstRoundBits ? 0 : 1ull << (bits - 1);
+		const std::uint64_t end = 1ull << bits;
+		const int chunks = static_cast<int>((end - begin + kChunk - 1) / kChunk);
+
+		std::vector<std::uint64_t> found(static_cast<size_t>(replicates) * chunks);
+		SharedRenderPool().ParallelFor(static_cast<int>(found.size()), [&](int i) {
+			const int r = i / chunks;
+			const std::uint64_t first = begin + static_cast<std::uint64_t>(i % chunks) * kChunk;
+			const auto n = static_cast<std::uint32_t>(std::min<std::uint64_t>(kChunk, end - first));
+			found[i] = CountInside(region, Sobol2{ static_cast<std::uint32_t>(first), shift[2 * r], shift[2 * r + 1] }, n);
+			});
+		for (size_t i = 0; i < found.size(); i++)
+			inside[i / chunks] += found[i];
+
+		// replicate estimates, their mean and the interval of the mean
+		const double n = static_cast<double>(end);
+		double mean = 0;
+		for (const auto k : inside)
+			mean += k / n;
+		mean /= replicates;
+		double var = 0;
+		for (const auto k : inside)
+			var += (k / n - mean) * (k / n - mean);
+		var /= replicates - 1;
+
+		estimate.samples = end * replicates;
+		estimate.inside = 0;
+		for (const auto k : inside)
+			estimate.inside += k;
+		estimate.fraction = mean;
+		estimate.fraction_error = Student95(replicates - 1) * std::sqrt(var / replicates);
+		estimate.area = mean * region_area;
+		estimate.area_error = estimate.fraction_error * region_area;
+		estimate.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (progress && !progress(estimate))
+			break;
+		if (options.target_error > 0 && estimate.area_error <= options.target_error)
+			break;
+		if (2 * estimate.samples > options.max_samples)
+			break;
+	}
+	return estimate;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "mandel_algo.h"
+
+// Quasi-Monte Carlo estimate of the part of a region inside the Mandelbrot
+// set, with no picture at all.
+//
+// Points come from a 2D Sobol sequence, `replicates` times with independent
+// random digital shifts; each replicate is an unbiased estimate and their
+// spread gives the confidence interval. Samples run in rounds, each doubling
+// the points of every replicate (Sobol nets are balanced at powers of two),
+// and the estimate is reported after each. Membership is tested in SIMD
+// lanes refilled as points finish; points in the main cardioid or the period
+// 2 bulb are decided without iterating, and orbits which close on themselves
+// (periodicity check) stop early. Threads only add up counts of points
+// inside.
+//
+// A point counts as inside when it does not escape within the region's
+// depth, so the result is an upper bound of the true area which tightens as
+// the depth grows.
+
+struct MandelbrotAreaOptions {
+	std::uint64_t max_samples = 1ull << 28;  // over all replicates
+	double target_error = 0;   // stop once the area interval is this narrow (half width), 0 - never
+	int replicates = 16;
+	std::uint32_t seed = 1;
+};
+
+struct MandelbrotAreaEstimate {
+	std::uint64_t samples = 0;
+	std::uint64_t inside = 0;
+	double fraction = 0;        // of the region inside the set
+	double fraction_error = 0;  // half width of the 95% confidence interval
+	double area = 0;            // fraction times the area of the region
+	double area_error = 0;
+	double seconds = 0;
+};
+
+// Called after every round, return false to stop
+using MandelbrotAreaProgress = std::function<bool(const MandelbrotAreaEstimate&)>;
+
+// Estimate over the rectangle of `region` at its depth. Only the Mandelbrot
+// formula, other fractals return an empty estimate.
+MandelbrotAreaEstimate Mandelbrot_EstimateArea(const MandelbrotParams& region, const MandelbrotAreaOptions& options = {},
+	MandelbrotAreaProgress&& progress = {});
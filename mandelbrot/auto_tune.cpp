@@ -0,0 +1,196 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include "auto_tune.h"
+#include "numa_topology.h"
+#include "render_pool.h"
+
+namespace {
+
+constexpr int kCalibrationWidth = 512;
+constexpr int kCalibrationHeight = 384;
+constexpr int kCalibrationDepth = 500;
+constexpr int kRuns = 3;
+
+// a candidate has to beat the current choice by this much, so that noise
+// does not move away from the defaults
+constexpr double kMargin = 0.97;
+
+const char kFileTag[] = "mandelbrot-tuning";
+constexpr int kFileVersion = 1;
+
+// Shortest of a few calibration renders, in seconds
+double Measure(const MandelbrotTuning& tuning)
+{
+	MandelbrotParams p;
+	p.depth = kCalibrationDepth;
+
+	double best = std::numeric_limits<double>::max();
+	for (int run = 0; run < kRuns; run++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		Mandelbrot_ComputeTuned(p, kCalibrationWidth, kCalibrationHeight, tuning);
+		const std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+		best = std::min(best, took.count());
+	}
+	return best;
+}
+
+// Hardware the settings were tuned on
+struct Machine {
+	int hardware_threads;
+	int nodes;
+
+	static Machine This()
+	{
+		return { static_cast<int>(std::thread::hardware_concurrency()), static_cast<int>(NumaNodes().size()) };
+	}
+};
+
+constexpr MandelbrotKernel kKernels[] = { MandelbrotKernel::lanes, MandelbrotKernel::scalar, MandelbrotKernel::stream };
+
+const char* KernelName(MandelbrotKernel kernel)
+{
+	switch (kernel)
+	{
+	case MandelbrotKernel::scalar:
+		return "scalar";
+	case MandelbrotKernel::stream:
+		return "stream";
+	default:
+		return "lanes";
+	}
+}
+
+} // namespace
+
+MandelbrotTuning Mandelbrot_AutoTune()
+{
+	const int max_threads = SharedRenderPool().Threads() + 1;
+
+	MandelbrotTuning best;
+	best.threads = max_threads;
+	Measure(best); // warm up: page faults, caches, clock frequency
+	double best_time = Measure(best);
+
+	auto consider = [&](const MandelbrotTuning& candidate) {
+		const double t = Measure(candidate);
+		if (t < best_time * kMargin)
+		{
+			best = candidate;
+			best_time = t;
+		}
+	};
+
+	MandelbrotTuning candidate;
+	for (const MandelbrotKernel kernel : kKernels)
+	{
+		if (kernel == best.kernel)
+			continue;
+		candidate = best;
+		candidate.kernel = kernel;
+		consider(candidate);
+	}
+
+	for (const int size : { 32, 128 })
+	{
+		candidate = best;
+		candidate.tile_size = size;
+		consider(candidate);
+	}
+
+	// fewer threads than hardware threads can win where SMT siblings share
+	// the floating point units
+	for (int threads = max_threads / 2; threads >= 1; threads /= 2)
+	{
+		candidate = best;
+		candidate.threads = threads;
+		consider(candidate);
+	}
+
+	return best;
+}
+
+bool Mandelbrot_LoadTuning(const std::string& path, MandelbrotTuning& tuning)
+{
+	std::ifstream file{ path };
+	std::string tag, key, kernel;
+	int version = 0;
+	Machine machine{}, tuned{};
+	MandelbrotTuning t;
+	file >> tag >> version
+		>> key >> tuned.hardware_threads >> tuned.nodes
+		>> key >> t.tile_size
+		>> key >> t.threads
+		>> key >> kernel;
+	if (!file || tag != kFileTag || version != kFileVersion)
+		return false;
+
+	machine = Machine::This();
+	if (tuned.hardware_threads != machine.hardware_threads || tuned.nodes != machine.nodes)
+		return false;
+
+	const auto named = std::find_if(std::begin(kKernels), std::end(kKernels),
+		[&](MandelbrotKernel k) { return kernel == KernelName(k); });
+	if (t.tile_size < 16 || t.tile_size > kMandelbrotMaxTileSize || t.threads < 0 || named == std::end(kKernels))
+		return false;
+	t.kernel = *named;
+
+	tuning = t;
+	return true;
+}
+
+bool Mandelbrot_SaveTuning(const std::string& path, const MandelbrotTuning& tuning)
+{
+	// written aside and renamed, a crash leaves the old file or none
+	const std::string temp = path + ".tmp";
+	{
+		std::ofstream file{ temp, std::ios::trunc };
+		const Machine machine = Machine::This();
+		file << kFileTag << ' ' << kFileVersion << '\n'
+			<< "machine " << machine.hardware_threads << ' ' << machine.nodes << '\n'
+			<< "tile_size " << tuning.tile_size << '\n'
+			<< "threads " << tuning.threads << '\n'
+			<< "kernel " << KernelName(tuning.kernel) << '\n';
+		if (!file.flush())
+			return false;
+	}
+	std::remove(path.c_str());
+	return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+MandelbrotTuning Mandelbrot_LoadOrTune(const std::string& path, bool retune)
+{
+	MandelbrotTuning tuning;
+	if (!retune && Mandelbrot_LoadTuning(path, tuning))
+		return tuning;
+
+	tuning = Mandelbrot_AutoTune();
+	Mandelbrot_SaveTuning(path, tuning);
+	return tuning;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include "mandel_algo.h"
+
+// Per machine choice of tile size, render thread count and kernel.
+//
+// The candidates are timed on a short calibration render (the whole set at a
+// moderate depth, which mixes fast escaping, boundary and inside points) and
+// the fastest is kept. Settings are searched one after the other: the kernel
+// with the default tiles on all threads, then the tile size, then the number
+// of threads.
+
+// Time the candidates, takes a second or two. The calibration renders run on
+// the shared pool with each candidate (Mandelbrot_ComputeTuned), the settings
+// in effect are not changed; other renders meanwhile skew the times.
+MandelbrotTuning Mandelbrot_AutoTune();
+
+// Settings written by Mandelbrot_SaveTuning on this machine. False if the file
+// does not exist, is damaged or was made on other hardware.
+bool Mandelbrot_LoadTuning(const std::string& path, MandelbrotTuning& tuning);
+bool Mandelbrot_SaveTuning(const std::string& path, const MandelbrotTuning& tuning);
+
+// Settings from the cache file, tuned and saved if there are none for this
+// machine (or `retune` is set)
+MandelbrotTuning Mandelbrot_LoadOrTune(const std::string& path, bool retune = false);
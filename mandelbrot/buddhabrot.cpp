@@ -0,0 +1,273 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include "buddhabrot.h"
+#include "fractal_formulas.h"
+#include "render_pool.h"
+
+namespace {
+
+// c is sampled from the square holding the whole set
+constexpr double kSampleMin = -2.;
+constexpr double kSampleSize = 4.;
+
+// Density buffers of one batch. Pixels are grouped in tiles of
+// kMandelbrotTileSize squared, tile rows one after the other.
+class TiledDensity {
+public:
+	TiledDensity(int width_, int height_)
+		: tiles_x{ (width_ + kMandelbrotTileSize - 1) / kMandelbrotTileSize }
+		, tiles_y{ (height_ + kMandelbrotTileSize - 1) / kMandelbrotTileSize }
+	{
+		for (auto& c : channel)
+			c.assign(Pixels(width_, height_), 0);
+	}
+
+	// pixels of a channel, the picture rounded up to whole tiles
+	static size_t Pixels(int width, int height)
+	{
+		const size_t tiles_x = (width + kMandelbrotTileSize - 1) / kMandelbrotTileSize;
+		const size_t tiles_y = (height + kMandelbrotTileSize - 1) / kMandelbrotTileSize;
+		return tiles_x * tiles_y * kMandelbrotTileSize * kMandelbrotTileSize;
+	}
+
+	static size_t Bytes(int width, int height) { return Pixels(width, height) * sizeof(std::uint32_t) * 3; }
+
+	size_t Index(int x, int y) const
+	{
+		const size_t tile = static_cast<size_t>(y / kMandelbrotTileSize) * tiles_x + x / kMandelbrotTileSize;
+		return tile * kMandelbrotTileSize * kMandelbrotTileSize +
+			(y % kMandelbrotTileSize) * kMandelbrotTileSize + x % kMandelbrotTileSize;
+	}
+
+	std::vector<std::uint32_t, LargeAllocator<std::uint32_t>> channel[3];
+
+private:
+	int tiles_x;
+	int tiles_y;
+};
+
+// splitmix64, plenty for picking sample points
+class Random {
+public:
+	explicit Random(std::uint64_t seed) : state{ seed } {}
+
+	std::uint64_t Next()
+	{
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// uniform in [0, 1)
+	double Unit() { return (Next() >> 11) * (1. / 9007199254740992.); }
+
+private:
+	std::uint64_t state;
+};
+
+// Main cardioid and period 2 bulb, points there never escape
+bool InsideKnownComponent(double x, double y)
+{
+	const double xq = x - 0.25;
+	const double q = xq * xq + y * y;
+	if (q * (q + xq) <= 0.25 * y * y)
+		return true;
+	return (x + 1) * (x + 1) + y * y <= 0.0625;
+}
+
+struct Batch {
+	const BuddhabrotParams& p;
+	int width, height;
+	int limit[3];
+	int max_depth;
+
+	// count the first `length` orbit points of c in the channels selected
+	void Splat(TiledDensity& d, double cx, double cy, int length, const bool (&use)[3]) const
+	{
+		const double scale_x = width / p.view.x_range;
+		const double scale_y = height / p.view.y_range;
+		double x = 0, y = 0;
+		for (int k = 0; k < length; k++)
+		{
+			const double t = x * x - y * y + cx;
+			y = 2 * x * y + cy;
+			x = t;
+
+			const double fx = (x - p.view.x_start) * scale_x;
+			const double fy = (y - p.view.y_start) * scale_y;
+			if (fx < 0 || fy < 0 || fx >= width || fy >= height)
+				continue;
+
+			const size_t i = d.Index(static_cast<int>(fx), static_cast<int>(fy));
+			for (int ch = 0; ch < 3; ch++)
+				d.channel[ch][i] += use[ch] && k < limit[ch];
+		}
+	}
+
+	void Run(TiledDensity& d, std::uint64_t samples, std::uint64_t seed, const std::atomic<bool>* cancel) const
+	{
+		Random random{ seed };
+		const MandelbrotFormula formula;
+
+		double zx[kFormulaLanes], zy[kFormulaLanes], cx[kFormulaLanes], cy[kFormulaLanes];
+		int count[kFormulaLanes];
+		int lanes = 0;
+
+		auto flush = [&] {
+			Formula_Lanes(formula, zx, zy, cx, cy, count, max_depth);
+			for (int l = 0; l < lanes; l++)
+			{
+				// count == limit and still inside means it did not escape in time
+				const bool escaped = zx[l] * zx[l] + zy[l] * zy[l] > 4.;
+				bool use[3];
+				int length = 0;
+				for (int ch = 0; ch < 3; ch++)
+				{
+					use[ch] = p.anti ? !escaped || count[l] > limit[ch] : escaped && count[l] <= limit[ch];
+					if (use[ch])
+						length = std::max(length, p.anti ? limit[ch] : count[l]);
+				}
+				if (length > 0)
+					Splat(d, cx[l], cy[l], length, use);
+			}
+			lanes = 0;
+		};
+
+		for (std::uint64_t s = 0; s < samples; s++)
+		{
+			if (s % kBuddhabrotCancelSamples == 0 && cancel && *cancel)
+				return;
+
+			const double x = kSampleMin + kSampleSize * random.Unit();
+			const double y = kSampleMin + kSampleSize * random.Unit();
+
+			// known to stay inside: nothing for Buddhabrot, whole orbits for
+			// anti-Buddhabrot without running the escape test
+			if (InsideKnownComponent(x, y))
+			{
+				if (p.anti)
+				{
+					const bool all[3] = { true, true, true };
+					Splat(d, x, y, max_depth, all);
+				}
+				continue;
+			}
+
+			zx[lanes] = 0;
+			zy[lanes] = 0;
+			cx[lanes] = x;
+			cy[lanes] = y;
+			count[lanes] = 0;
+			if (++lanes == kFormulaLanes)
+				flush();
+		}
+
+		if (lanes > 0)
+		{
+			// idle lanes escape at once
+			for (int l = lanes; l < kFormulaLanes; l++)
+			{
+				zx[l] = zy[l] = cx[l] = cy[l] = 4.;
+				count[l] = 0;
+			}
+			flush();
+		}
+	}
+};
+
+} // namespace
+
+BuddhabrotDensity Buddhabrot_Compute(const BuddhabrotParams& p, int width, int height,
+	const std::atomic<bool>* cancel)
+{
+	const Batch batch{ p, width, height, { p.depth_red, p.depth_green, p.depth_blue },
+		std::max({ p.depth_red, p.depth_green, p.depth_blue }) };
+
+	// one batch per thread, each with its own density, so the hot loop needs
+	// neither atomics nor locks; as many as the memory budget holds
+	RenderPool& pool = SharedRenderPool();
+	const size_t fit = kBuddhabrotBatchBytes / std::max<size_t>(TiledDensity::Bytes(width, height), 1);
+	const int batches = static_cast<int>(std::clamp<size_t>(fit, 1, pool.Threads() + 1));
+	std::vector<std::unique_ptr<TiledDensity>> densities(batches);
+	pool.ParallelFor(batches, [&](int b) {
+		densities[b] = std::make_unique<TiledDensity>(width, height);
+		const std::uint64_t first = p.samples * b / batches;
+		const std::uint64_t last = p.samples * (b + 1) / batches;
+		batch.Run(*densities[b], last - first, p.seed * 0x100000001B3ull + b, cancel);
+		});
+
+	BuddhabrotDensity result;
+	result.width = width;
+	result.height = height;
+	for (auto& c : result.channel)
+		c.resize(width * static_cast<size_t>(height));
+
+	// add the batches up, row by row
+	std::vector<std::uint32_t> row_max(height * 3);
+	pool.ParallelFor(height, [&](int y) {
+		for (int ch = 0; ch < 3; ch++)
+		{
+			std::uint32_t* row = &result.channel[ch][y * static_cast<size_t>(width)];
+			std::uint32_t max = 0;
+			for (int x = 0; x < width; x++)
+			{
+				const size_t i = densities[0]->Index(x, y);
+				std::uint32_t sum = 0;
+				for (const auto& d : densities)
+					sum += d->channel[ch][i];
+				row[x] = sum;
+				max = std::max(sum, max);
+			}
+			row_max[y * 3 + ch] = max;
+		}
+		});
+
+	for (int y = 0; y < height; y++)
+		for (int ch = 0; ch < 3; ch++)
+			result.max[ch] = std::max(row_max[y * 3 + ch], result.max[ch]);
+	return result;
+}
+
+void Buddhabrot_Shade(const BuddhabrotDensity& density, FrameBuffer& out)
+{
+	double scale[3];
+	for (int ch = 0; ch < 3; ch++)
+		scale[ch] = density.max[ch] ? 255. / std::sqrt(static_cast<double>(density.max[ch])) : 0.;
+
+	SharedRenderPool().ParallelFor(density.height, [&](int y) {
+		FrameBuffer::Colour* row = out.Row(y);
+		const size_t first = y * static_cast<size_t>(density.width);
+		for (int x = 0; x < density.width; x++)
+		{
+			FrameBuffer::Colour c = 0xFF000000;
+			for (int ch = 0; ch < 3; ch++)
+			{
+				const auto v = static_cast<std::uint32_t>(std::sqrt(static_cast<double>(density.channel[ch][first + x])) * scale[ch]);
+				c |= std::min(v, 255u) << (16 - 8 * ch);
+			}
+			row[x] = c;
+		}
+		});
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "framebuffer.h"
+#include "large_alloc.h"
+#include "mandel_algo.h"
+
+// Orbit density rendering: random points c are iterated and every point of
+// their orbits is counted in the pixel it falls into.
+//
+// Each channel has its own iteration limit. Buddhabrot counts orbits of
+// points escaping within the limit, anti-Buddhabrot the first `limit` points
+// of orbits which do not escape.
+struct BuddhabrotParams {
+	MandelbrotParams view;     // picture area, depth is not used
+	bool anti = false;
+	int depth_red = 5000;
+	int depth_green = 500;
+	int depth_blue = 50;
+	std::uint64_t samples = 20'000'000;
+	std::uint64_t seed = 1;
+};
+
+// Orbit hits per pixel and channel, row by row
+struct BuddhabrotDensity {
+	int width = 0;
+	int height = 0;
+	std::vector<std::uint32_t, LargeAllocator<std::uint32_t>> channel[3]; // red, green, blue
+	std::uint32_t max[3] = {};
+};
+
+// Memory for the density buffers of the batches, 12 bytes per pixel each
+constexpr size_t kBuddhabrotBatchBytes = size_t{ 512 } << 20;
+
+// Samples a batch runs between checks of the cancel flag
+constexpr std::uint64_t kBuddhabrotCancelSamples = 1 << 14;
+
+// Samples are split into one batch per render thread; every batch counts
+// into its own density buffers (stored tile by tile so orbits which stay in
+// one area stay in cache) which are added up at the end. The buffers of all
+// batches together stay within kBuddhabrotBatchBytes where one fits: a 4K
+// picture runs 5 batches at once, whatever the number of threads. Once
+// `cancel` is set the batches stop within kBuddhabrotCancelSamples samples
+// and the density is incomplete.
+BuddhabrotDensity Buddhabrot_Compute(const BuddhabrotParams& p, int width, int height,
+	const std::atomic<bool>* cancel = nullptr);
+
+// Square root of the density relative to the channel maximum
+void Buddhabrot_Shade(const BuddhabrotDensity& density, FrameBuffer& out);
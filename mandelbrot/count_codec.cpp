@@ -0,0 +1,334 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include "count_codec.h"
+
+namespace {
+
+constexpr int kKBits = 5;   // Rice parameter in a row header
+constexpr int kMaxK = 24;
+constexpr int kEscape = 24; // unary prefix of a raw 32 bit value
+constexpr int kMaxGammaZeros = 27;
+
+std::uint32_t Zigzag(std::uint32_t delta)
+{
+	return (delta << 1) ^ static_cast<std::uint32_t>(static_cast<std::int32_t>(delta) >> 31);
+}
+
+std::uint32_t Unzigzag(std::uint32_t z)
+{
+	return (z >> 1) ^ (0u - (z & 1));
+}
+
+int RiceBits(std::uint32_t v, int k)
+{
+	const std::uint32_t q = v >> k;
+	return q < kEscape ? static_cast<int>(q) + 1 + k : kEscape + 1 + 32;
+}
+
+int GammaBits(std::uint32_t n)
+{
+	return 2 * std::bit_width(n) - 1;
+}
+
+// little endian machines only, like the rest of the wire formats
+std::uint64_t LoadBigEndian64(const std::uint8_t* p)
+{
+	std::uint64_t v;
+	std::memcpy(&v, p, sizeof(v));
+#ifdef _MSC_VER
+	return _byteswap_uint64(v);
+#else
+	return __builtin_bswap64(v);
+#endif
+}
+
+// Bit stream, most significant bit first
+class BitWriter {
+public:
+	explicit BitWriter(std::vector<std::uint8_t>& out) : out{ out } {}
+
+	// Append the `n` low bits of `bits`, n <= 32 and bits < 2^n
+	void Put(std::uint32_t bits, int n)
+	{
+		acc = (acc << n) | bits;
+		used += n;
+		while (used >= 8)
+		{
+			used -= 8;
+			out.push_back(static_cast<std::uint8_t>(acc >> used));
+		}
+	}
+
+	// q zeros and a one, then the k low bits. Large values escape to 32 raw bits.
+	void Rice(std::uint32_t v, int k)
+	{
+		const std::uint32_t q = v >> k;
+		if (q < kEscape)
+		{
+			Put(1, q + 1);
+			Put(v & ((1u << k) - 1), k);
+		}
+		else
+		{
+			Put(1, kEscape + 1);
+			Put(v, 32);
+		}
+	}
+
+	// n >= 1: bit_width(n) - 1 zeros, then n
+	void Gamma(std::uint32_t n) { Put(n, GammaBits(n)); }
+
+	void Finish()
+	{
+		if (used > 0)
+			out.push_back(static_cast<std::uint8_t>(acc << (8 - used)));
+	}
+
+private:
+	std::vector<std::uint8_t>& out;
+	std::uint64_t acc = 0;
+	int used = 0;
+};
+
+class BitReader {
+public:
+	BitReader(const std::uint8_t* data, size_t size) : begin{ data }, p{ data }, end{ data + size } {}
+
+	// Make at least 56 bits available. Past the end of the data zeros are
+	// read, Finished() tells whether that happened.
+	void Refill()
+	{
+		if (end - p >= 8)
+		{
+			window |= LoadBigEndian64(p) >> bits;
+			p += (63 - bits) >> 3;
+			bits |= 56;
+			return;
+		}
+		while (bits <= 56)
+		{
+			const std::uint64_t b = p != end ? *p++ : (past++, 0);
+			window |= b << (56 - bits);
+			bits += 8;
+		}
+	}
+
+	bool Rice(int k, std::uint32_t& v)
+	{
+		const int q = std::countl_zero(window);
+		if (q < kEscape)
+		{
+			Skip(q + 1);
+			v = (static_cast<std::uint32_t>(q) << k) | (k ? Take(k) : 0);
+			return true;
+		}
+		if (q == kEscape)
+		{
+			Skip(q + 1);
+			Refill();
+			v = Take(32);
+			return true;
+		}
+		return false;
+	}
+
+	bool Gamma(std::uint32_t& n)
+	{
+		const int zeros = std::countl_zero(window);
+		if (zeros > kMaxGammaZeros)
+			return false;
+		Skip(zeros);
+		n = Take(zeros + 1);
+		return true;
+	}
+
+	// 1 <= n <= 32
+	std::uint32_t Take(int n)
+	{
+		const auto v = static_cast<std::uint32_t>(window >> (64 - n));
+		Skip(n);
+		return v;
+	}
+
+	// all data consumed, up to the padding of the last byte
+	bool Finished() const
+	{
+		const size_t loaded = static_cast<size_t>(p - begin) + past;
+		const size_t consumed_bits = loaded * 8 - bits;
+		return (consumed_bits + 7) / 8 == static_cast<size_t>(end - begin);
+	}
+
+private:
+	void Skip(int n)
+	{
+		window <<= n;
+		bits -= n;
+	}
+
+	const std::uint8_t* begin;
+	const std::uint8_t* p;
+	const std::uint8_t* end;
+	size_t past = 0;
+	std::uint64_t window = 0; // next bits, left aligned
+	int bits = 0;             // valid bits in the window
+};
+
+} // namespace
+
+std::vector<std::uint8_t> EncodeCounts(const int* counts, int width, int height, int stride)
+{
+	std::vector<std::uint8_t> out;
+	BitWriter w{ out };
+	std::vector<std::uint32_t> residual(width > 0 ? width : 0);
+	std::uint32_t first = 0; // first count of the row above
+	for (int y = 0; y < height && width > 0; y++)
+	{
+		const int* row = counts + y * static_cast<size_t>(stride);
+		std::uint32_t pred = first;
+		int gamma_bits = 0;
+		for (int x = 0, run = 0; x < width; x++)
+		{
+			const auto v = static_cast<std::uint32_t>(row[x]);
+			residual[x] = Zigzag(v - pred);
+			pred = v;
+			if (residual[x] == 0)
+				run++;
+			if (residual[x] != 0 || x == width - 1)
+			{
+				gamma_bits += GammaBits(run + 1);
+				run = 0;
+			}
+		}
+		first = static_cast<std::uint32_t>(row[0]);
+
+		// cost of both modes is convex enough in k to stop at the first rise
+		auto Cost = [&](int k, bool runs) {
+			long long bits = runs ? gamma_bits : 0;
+			for (int x = 0; x < width; x++)
+			{
+				if (!runs)
+					bits += RiceBits(residual[x], k);
+				else if (residual[x] != 0)
+					bits += RiceBits(residual[x] - 1, k);
+			}
+			return bits;
+		};
+		int best_k[2] = {};
+		long long best[2] = {};
+		for (int mode = 0; mode < 2; mode++)
+		{
+			best[mode] = Cost(0, mode);
+			for (int k = 1; k <= kMaxK; k++)
+			{
+				const long long c = Cost(k, mode);
+				if (c >= best[mode])
+					break;
+				best[mode] = c;
+				best_k[mode] = k;
+			}
+		}
+		const bool runs = best[1] < best[0];
+		const int k = best_k[runs];
+
+		w.Put(runs, 1);
+		w.Put(k, kKBits);
+		if (!runs)
+		{
+			for (int x = 0; x < width; x++)
+				w.Rice(residual[x], k);
+			continue;
+		}
+		for (int x = 0; x < width;)
+		{
+			int run = 0;
+			while (x + run < width && residual[x + run] == 0)
+				run++;
+			w.Gamma(run + 1);
+			x += run;
+			if (x < width)
+				w.Rice(residual[x++] - 1, k);
+		}
+	}
+	w.Finish();
+	return out;
+}
+
+bool DecodeCounts(const std::uint8_t* data, size_t size, int* counts, int width, int height, int stride, int max_count)
+{
+	// counts index histograms when shaded, none may lie outside 0 .. max_count
+	// (negative ones wrap to above it)
+	const auto limit = static_cast<std::uint32_t>(std::max(max_count, 0));
+	BitReader in{ data, size };
+	std::uint32_t first = 0;
+	for (int y = 0; y < height && width > 0; y++)
+	{
+		int* row = counts + y * static_cast<size_t>(stride);
+		in.Refill();
+		const bool runs = in.Take(1) != 0;
+		const int k = static_cast<int>(in.Take(kKBits));
+		if (k > kMaxK)
+			return false;
+
+		std::uint32_t pred = first;
+		std::uint32_t r;
+		if (!runs)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				in.Refill();
+				if (!in.Rice(k, r))
+					return false;
+				pred += Unzigzag(r);
+				if (pred > limit)
+					return false;
+				row[x] = static_cast<int>(pred);
+			}
+		}
+		else
+		{
+			for (int x = 0; x < width;)
+			{
+				in.Refill();
+				std::uint32_t n;
+				if (!in.Gamma(n) || n - 1 > static_cast<std::uint32_t>(width - x))
+					return false;
+				for (const int stop = x + static_cast<int>(n - 1); x < stop; x++)
+					row[x] = static_cast<int>(pred);
+				if (x == width)
+					break;
+				in.Refill();
+				if (!in.Rice(k, r))
+					return false;
+				pred += Unzigzag(r + 1);
+				if (pred > limit)
+					return false;
+				row[x++] = static_cast<int>(pred);
+			}
+		}
+		first = static_cast<std::uint32_t>(row[0]);
+	}
+	return in.Finished();
+}
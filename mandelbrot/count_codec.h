@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact encoding of a tile of iteration counts, for sending between
+// processes and for count archives (count_file.h).
+//
+// Each row is delta coded: the first count against the first count of the
+// row above, the others against their left neighbour. Deltas are zigzag
+// mapped and Rice coded with a parameter picked per row. Rows whose deltas
+// are mostly zero (inside of the set, flat bands far outside) code runs of
+// zeros with an Elias gamma length instead, so they cost a few bits per row.
+// A tile depends on nothing outside of its own bytes.
+
+std::vector<std::uint8_t> EncodeCounts(const int* counts, int width, int height, int stride);
+
+// @param max_count - highest valid count, depth + 1 of the view the tile belongs to
+// @returns false if the data is corrupted, does not hold width x height counts
+//          or holds a count outside of 0 .. max_count
+bool DecodeCounts(const std::uint8_t* data, size_t size, int* counts, int width, int height, int stride, int max_count);
@@ -0,0 +1,196 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include "count_file.h"
+#include "count_codec.h"
+#include "durable_file.h"
+#include "render_pool.h"
+
+namespace {
+constexpr char kMagic[8] = { 'M', 'B', 'C', 'O', 'U', 'N', 'T', '1' };
+constexpr std::uint32_t kVersion = 1;
+
+int TilesAlong(int size)
+{
+	return (size + kCountFileTile - 1) / kCountFileTile;
+}
+}
+
+struct CountFile::Header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t tile_size;
+	std::int32_t width, height, depth, max;
+	double x_start, y_start, x_range, y_range;
+	double c_re, c_im;
+	std::int32_t fractal, power;
+	std::uint8_t reserved[8];
+};
+
+static_assert(sizeof(CountFile::Header) == 96, "file format");
+
+bool Mandelbrot_SaveCounts(const std::string& path, const MandelbrotParams& p, const MandelbrotCounts& counts)
+{
+	CountFile::Header h{};
+	std::memcpy(h.magic, kMagic, sizeof(kMagic));
+	h.version = kVersion;
+	h.tile_size = kCountFileTile;
+	h.width = counts.width;
+	h.height = counts.height;
+	h.depth = p.depth;
+	h.max = counts.max;
+	h.x_start = p.x_start;
+	h.y_start = p.y_start;
+	h.x_range = p.x_range;
+	h.y_range = p.y_range;
+	h.c_re = p.c_re;
+	h.c_im = p.c_im;
+	h.fractal = static_cast<std::int32_t>(p.fractal);
+	h.power = p.power;
+
+	const int tiles_x = TilesAlong(counts.width);
+	const int tiles = tiles_x * TilesAlong(counts.height);
+	std::vector<std::vector<std::uint8_t>> encoded(tiles);
+	SharedRenderPool().ParallelFor(tiles, [&](int i) {
+		const int x = i % tiles_x * kCountFileTile;
+		const int y = i / tiles_x * kCountFileTile;
+		encoded[i] = EncodeCounts(counts.counts.data() + y * static_cast<size_t>(counts.width) + x,
+			std::min(kCountFileTile, counts.width - x), std::min(kCountFileTile, counts.height - y), counts.width);
+	});
+
+	std::vector<std::uint64_t> offsets(tiles + 1);
+	offsets[0] = sizeof(h) + offsets.size() * sizeof(std::uint64_t);
+	for (int i = 0; i < tiles; i++)
+		offsets[i + 1] = offsets[i] + encoded[i].size();
+
+	std::vector<std::uint8_t> file(offsets[tiles]);
+	std::memcpy(file.data(), &h, sizeof(h));
+	std::memcpy(file.data() + sizeof(h), offsets.data(), offsets.size() * sizeof(std::uint64_t));
+	for (int i = 0; i < tiles; i++)
+	{
+		std::copy(encoded[i].begin(), encoded[i].end(), file.begin() + offsets[i]);
+		std::vector<std::uint8_t>{}.swap(encoded[i]);
+	}
+	return WriteFileDurably(path, file.data(), file.size());
+}
+
+bool Mandelbrot_LoadCounts(const std::string& path, MandelbrotParams& p, MandelbrotCounts& counts)
+{
+	CountFile file;
+	if (!file.Open(path))
+		return false;
+
+	MandelbrotCounts result;
+	result.width = file.Width();
+	result.height = file.Height();
+	result.depth = file.Params().depth;
+	result.counts.resize(result.width * static_cast<size_t>(result.height));
+
+	// the highest count sizes the histogram of the shader, it is taken from
+	// the (range checked) counts rather than from the header
+	std::atomic<bool> ok{ true };
+	std::vector<int> tile_max(file.Tiles());
+	SharedRenderPool().ParallelFor(file.Tiles(), [&](int i) {
+		const TileRect t = file.Tile(i);
+		int* counts = result.counts.data() + t.y * static_cast<size_t>(result.width) + t.x;
+		if (!file.Decode(i, counts, result.width))
+		{
+			ok = false;
+			return;
+		}
+		for (int y = 0; y < t.height; y++)
+			for (int x = 0; x < t.width; x++)
+				tile_max[i] = std::max(tile_max[i], counts[y * static_cast<size_t>(result.width) + x]);
+	});
+	if (!ok)
+		return false;
+	result.max = *std::max_element(tile_max.begin(), tile_max.end());
+
+	p = file.Params();
+	counts = std::move(result);
+	return true;
+}
+
+bool CountFile::Open(const std::string& path)
+{
+	offsets.clear();
+	if (!file.OpenReadOnly(path))
+		return false;
+	Header h;
+	if (file.Size() < sizeof(h))
+		return false;
+	std::memcpy(&h, file.Data(), sizeof(h));
+	if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion ||
+		h.tile_size != kCountFileTile || h.width <= 0 || h.height <= 0 || h.depth <= 0 || h.depth == INT32_MAX ||
+		h.max < 0 || h.max > h.depth + 1 ||
+		h.fractal < 0 || h.fractal > static_cast<std::int32_t>(Fractal::tricorn) || h.power < 2 ||
+		h.power > kMaxMultibrotPower)
+		return false;
+
+	const size_t entries = TilesAlong(h.width) * static_cast<size_t>(TilesAlong(h.height)) + 1;
+	const size_t table = entries * sizeof(std::uint64_t);
+	if (file.Size() < sizeof(h) + table)
+		return false;
+	// copied out of the mapping, which only guarantees byte alignment
+	std::vector<std::uint64_t> table_offsets(entries);
+	std::memcpy(table_offsets.data(), file.Data() + sizeof(h), table);
+	if (table_offsets[0] != sizeof(h) + table || table_offsets[entries - 1] != file.Size())
+		return false;
+	for (size_t i = 0; i + 1 < entries; i++)
+		if (table_offsets[i] > table_offsets[i + 1])
+			return false;
+
+	offsets = std::move(table_offsets);
+	tiles_x = TilesAlong(h.width);
+	tiles_y = TilesAlong(h.height);
+
+	params.x_start = h.x_start;
+	params.y_start = h.y_start;
+	params.x_range = h.x_range;
+	params.y_range = h.y_range;
+	params.depth = h.depth;
+	params.fractal = static_cast<Fractal>(h.fractal);
+	params.power = h.power;
+	params.c_re = h.c_re;
+	params.c_im = h.c_im;
+	width = h.width;
+	height = h.height;
+	max = h.max;
+	return true;
+}
+
+TileRect CountFile::Tile(int i) const
+{
+	const int x = i % tiles_x * kCountFileTile;
+	const int y = i / tiles_x * kCountFileTile;
+	return { x, y, std::min(kCountFileTile, width - x), std::min(kCountFileTile, height - y) };
+}
+
+bool CountFile::Decode(int i, int* counts, int stride) const
+{
+	const TileRect t = Tile(i);
+	return DecodeCounts(file.Data() + offsets[i], offsets[i + 1] - offsets[i], counts, t.width, t.height, stride,
+		params.depth + 1);
+}
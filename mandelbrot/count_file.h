@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mandel_algo.h"
+#include "mapped_file.h"
+
+// Archive of the raw counts of a rendered picture, to be recoloured later or
+// shipped to another machine: the view and picture size, then the counts in
+// square tiles coded with EncodeCounts(). Every tile decodes on its own, so a
+// region can be read without touching the rest of the file.
+//
+// File layout: header, offsets of the tiles in row-major tile order plus one
+// for the end of the data, tile data. Smooth (fractional) counts are not kept.
+
+constexpr int kCountFileTile = 256;
+
+// Stored with WriteFileDurably, a crash leaves the old file or the new one
+bool Mandelbrot_SaveCounts(const std::string& path, const MandelbrotParams& p, const MandelbrotCounts& counts);
+
+// Whole picture, tiles decoded in parallel. False if the file does not exist
+// or is damaged.
+bool Mandelbrot_LoadCounts(const std::string& path, MandelbrotParams& p, MandelbrotCounts& counts);
+
+// Random access to the tiles of an archive, mapped into memory so that only
+// the tiles decoded are read
+class CountFile {
+public:
+	bool Open(const std::string& path);
+
+	const MandelbrotParams& Params() const { return params; }
+	int Width() const { return width; }
+	int Height() const { return height; }
+	int Max() const { return max; }
+
+	int Tiles() const { return tiles_x * tiles_y; }
+	TileRect Tile(int i) const;
+
+	// Decode tile `i` into `counts`, rows `stride` counts apart
+	bool Decode(int i, int* counts, int stride) const;
+
+	// on-disk header, see count_file.cpp
+	struct Header;
+
+private:
+	MandelbrotParams params;
+	int width = 0;
+	int height = 0;
+	int max = 0;
+	int tiles_x = 0;
+	int tiles_y = 0;
+	MappedFile file;
+	std::vector<std::uint64_t> offsets;
+};
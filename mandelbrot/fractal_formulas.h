@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Escape time formulas as compile-time policies of one kernel.
+//
+// A formula provides Start(), setting the first z and the c of a pixel, and
+// Step(), one iteration z -> f(z, c). Degree is the power of z in f, used for
+// the smooth count. The kernel is instantiated per formula, so the formula is
+// inlined into the iteration loop and nothing is decided per iteration.
+
+struct MandelbrotFormula {
+	static constexpr double kDegree = 2;
+
+	void Start(double px, double py, double& zx, double& zy, double& cx, double& cy) const
+	{
+		zx = 0; zy = 0; cx = px; cy = py;
+	}
+	void Step(double x, double y, double cx, double cy, double& nx, double& ny) const
+	{
+		nx = x * x - y * y + cx;
+		ny = 2 * x * y + cy;
+	}
+};
+
+// Same iteration, z starts at the pixel and c is fixed
+struct JuliaFormula {
+	static constexpr double kDegree = 2;
+	double c_re, c_im;
+
+	void Start(double px, double py, double& zx, double& zy, double& cx, double& cy) const
+	{
+		zx = px; zy = py; cx = c_re; cy = c_im;
+	}
+	void Step(double x, double y, double cx, double cy, double& nx, double& ny) const
+	{
+		nx = x * x - y * y + cx;
+		ny = 2 * x * y + cy;
+	}
+};
+
+// z^N + c
+template <int N>
+struct MultibrotFormula {
+	static constexpr double kDegree = N;
+
+	void Start(double px, double py, double& zx, double& zy, double& cx, double& cy) const
+	{
+		zx = 0; zy = 0; cx = px; cy = py;
+	}
+	void Step(double x, double y, double cx, double cy, double& nx, double& ny) const
+	{
+		double rx = x, ry = y;
+		for (int k = 1; k < N; k++)
+		{
+			const double t = rx * x - ry * y;
+			ry = rx * y + ry * x;
+			rx = t;
+		}
+		nx = rx + cx;
+		ny = ry + cy;
+	}
+};
+
+// (|re z| + i |im z|)^2 + c
+struct BurningShipFormula {
+	static constexpr double kDegree = 2;
+
+	void Start(double px, double py, double& zx, double& zy, double& cx, double& cy) const
+	{
+		zx = 0; zy = 0; cx = px; cy = py;
+	}
+	void Step(double x, double y, double cx, double cy, double& nx, double& ny) const
+	{
+		const double ax = std::abs(x), ay = std::abs(y);
+		nx = ax * ax - ay * ay + cx;
+		ny = 2 * ax * ay + cy;
+	}
+};
+
+// conj(z)^2 + c
+struct TricornFormula {
+	static constexpr double kDegree = 2;
+
+	void Start(double px, double py, double& zx, double& zy, double& cx, double& cy) const
+	{
+		zx = 0; zy = 0; cx = px; cy = py;
+	}
+	void Step(double x, double y, double cx, double cy, double& nx, double& ny) const
+	{
+		nx = x * x - y * y + cx;
+		ny = -2 * x * y + cy;
+	}
+};
+
+// Pixels iterated side by side. The lane loops have no dependencies between
+// lanes, so the compiler turns them into SIMD code (SSE2/AVX, NEON).
+constexpr int kFormulaLanes = 8;
+
+// Iterate all lanes until each has escaped (|z| > 2) or `depth` iterations
+// are done, counting the iterations of every lane. Escaped lanes keep their
+// last z.
+template <class Formula>
+void Formula_Lanes(const Formula& f, double (&zx)[kFormulaLanes], double (&zy)[kFormulaLanes],
+	const double (&cx)[kFormulaLanes], const double (&cy)[kFormulaLanes], int (&count)[kFormulaLanes], int depth)
+{
+	for (int it = 0; it < depth; it++)
+	{
+		bool any = false;
+		for (int l = 0; l < kFormulaLanes; l++)
+		{
+			const bool active = zx[l] * zx[l] + zy[l] * zy[l] <= 4.;
+			double nx, ny;
+			f.Step(zx[l], zy[l], cx[l], cy[l], nx, ny);
+			zx[l] = active ? nx : zx[l];
+			zy[l] = active ? ny : zy[l];
+			count[l] += active;
+			any |= active;
+		}
+		if (!any)
+			break;
+	}
+}
+
+// Continuous escape count, n + 1 - log_d(log|z|), of a pixel with count `c`
+// and final |z|^2 `r2`
+template <class Formula>
+float Formula_Smooth(int c, double r2, int depth)
+{
+	return c > depth ? static_cast<float>(c)
+		: static_cast<float>(c + 1 - std::log2(0.5 * std::log(r2)) / std::log2(Formula::kDegree));
+}
+
+// Iteration counts of `n` pixels of one row, x coordinates x_start + x * stepx
+// for x = first, first + 1, ... Counts as the classic loop: the number of
+// iterations before |z| > 2, depth + 1 for points which do not escape.
+//
+// @returns the highest count
+template <class Formula>
+int Formula_Row(const Formula& f, double x_start, double stepx, int first, double y, int n, int depth,
+	int* counts, float* smooth)
+{
+	int max = 0;
+	for (int i = 0; i < n; i += kFormulaLanes)
+	{
+		double zx[kFormulaLanes], zy[kFormulaLanes], cx[kFormulaLanes], cy[kFormulaLanes];
+		int count[kFormulaLanes];
+		for (int l = 0; l < kFormulaLanes; l++)
+		{
+			// lanes past the end of the row repeat its last pixel
+			const int x = first + std::min(i + l, n - 1);
+			f.Start(x_start + x * stepx, y, zx[l], zy[l], cx[l], cy[l]);
+			count[l] = 0;
+		}
+
+		Formula_Lanes(f, zx, zy, cx, cy, count, depth);
+
+		const int lanes = std::min(kFormulaLanes, n - i);
+		for (int l = 0; l < lanes; l++)
+		{
+			const double r2 = zx[l] * zx[l] + zy[l] * zy[l];
+			const int c = r2 <= 4. ? depth + 1 : count[l];
+			counts[i + l] = c;
+			max = std::max(c, max);
+
+			if (smooth)
+				smooth[i + l] = Formula_Smooth<Formula>(c, r2, depth);
+		}
+	}
+	return max;
+}
+
+// Same counts as Formula_Row, one pixel at a time. Every pixel stops at its
+// own escape instead of waiting for the slowest lane, which wins where the
+// lane loops are not vectorised or neighbours escape far apart.
+template <class Formula>
+int Formula_RowScalar(const Formula& f, double x_start, double stepx, int first, double y, int n, int depth,
+	int* counts, float* smooth)
+{
+	int max = 0;
+	for (int i = 0; i < n; i++)
+	{
+		double zx, zy, cx, cy;
+		f.Start(x_start + (first + i) * stepx, y, zx, zy, cx, cy);
+
+		int c = 0;
+		while (c < depth && zx * zx + zy * zy <= 4.)
+		{
+			double nx, ny;
+			f.Step(zx, zy, cx, cy, nx, ny);
+			zx = nx;
+			zy = ny;
+			c++;
+		}
+
+		const double r2 = zx * zx + zy * zy;
+		if (r2 <= 4.)
+			c = depth + 1;
+		counts[i] = c;
+		max = std::max(c, max);
+
+		if (smooth)
+			smooth[i] = Formula_Smooth<Formula>(c, r2, depth);
+	}
+	return max;
+}
+
+// Iterations run on all lanes between two checks for finished lanes in
+// Formula_Stream
+constexpr int kStreamBlock = 8;
+
+// Lane refilling kernel: the pixels of a `width` x `height` block are a queue,
+// each lane takes the next pixel as soon as its own has escaped or reached
+// `depth`, so no lane idles until the slowest of a group is done. Pixel (x, y)
+// of the block is the point (x_start + (first_x + x) * stepx,
+// y_start + (first_y + y) * stepy); results are written back by index,
+// `counts` and `smooth` rows are `stride` apart. Counts as Formula_Row.
+//
+// @returns the highest count
+template <class Formula>
+int Formula_Stream(const Formula& f, double x_start, double stepx, int first_x, double y_start, double stepy, int first_y,
+	int width, int height, int depth, int* counts, float* smooth, int stride)
+{
+	double zx[kFormulaLanes], zy[kFormulaLanes], cx[kFormulaLanes], cy[kFormulaLanes];
+	int count[kFormulaLanes], pixel[kFormulaLanes];
+
+	const int total = width * height;
+	int next = 0, busy = 0, max = 0;
+
+	// lane l takes the next pixel of the queue, or idles when there is none
+	auto refill = [&](int l) {
+		if (next == total)
+		{
+			pixel[l] = -1;
+			zx[l] = zy[l] = cx[l] = cy[l] = 0;
+			count[l] = depth; // never active
+			return;
+		}
+		const int k = next++;
+		pixel[l] = k;
+		f.Start(x_start + (first_x + k % width) * stepx, y_start + (first_y + k / width) * stepy,
+			zx[l], zy[l], cx[l], cy[l]);
+		count[l] = 0;
+		busy++;
+	};
+	for (int l = 0; l < kFormulaLanes; l++)
+		refill(l);
+
+	while (busy > 0)
+	{
+		for (int it = 0; it < kStreamBlock; it++)
+			for (int l = 0; l < kFormulaLanes; l++)
+			{
+				const bool active = zx[l] * zx[l] + zy[l] * zy[l] <= 4. && count[l] < depth;
+				double nx, ny;
+				f.Step(zx[l], zy[l], cx[l], cy[l], nx, ny);
+				zx[l] = active ? nx : zx[l];
+				zy[l] = active ? ny : zy[l];
+				count[l] += active;
+			}
+
+		for (int l = 0; l < kFormulaLanes; l++)
+		{
+			const double r2 = zx[l] * zx[l] + zy[l] * zy[l];
+			if (pixel[l] < 0 || (r2 <= 4. && count[l] < depth))
+				continue;
+
+			const int c = r2 <= 4. ? depth + 1 : count[l];
+			const size_t at = pixel[l] / width * static_cast<size_t>(stride) + pixel[l] % width;
+			counts[at] = c;
+			max = std::max(c, max);
+			if (smooth)
+				smooth[at] = Formula_Smooth<Formula>(c, r2, depth);
+
+			busy--;
+			refill(l);
+		}
+	}
+	return max;
+}
+
+// Formula_Stream over `n` pixels of one row, with the arguments of Formula_Row
+template <class Formula>
+int Formula_RowStream(const Formula& f, double x_start, double stepx, int first, double y, int n, int depth,
+	int* counts, float* smooth)
+{
+	return Formula_Stream(f, x_start, stepx, first, y, 0., 0, n, 1, depth, counts, smooth, n);
+}
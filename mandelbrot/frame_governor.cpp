@@ -0,0 +1,108 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include "frame_governor.h"
+
+FrameGovernor::FrameGovernor(double budget_ms) : budget_ms{ budget_ms } {}
+
+void FrameGovernor::SetBudget(double ms)
+{
+	std::lock_guard<std::mutex> guard{ lock };
+	budget_ms = ms;
+}
+
+double FrameGovernor::Budget() const
+{
+	std::lock_guard<std::mutex> guard{ lock };
+	return budget_ms;
+}
+
+double FrameGovernor::PredictMs(int width, int height, int depth) const
+{
+	std::lock_guard<std::mutex> guard{ lock };
+	return last_depth > 0 ? ms_per_pixel * width * static_cast<double>(height) * depth / last_depth : 0;
+}
+
+void FrameGovernor::Record(double pixels, int depth, double ms)
+{
+	if (pixels <= 0 || depth <= 0)
+		return;
+	std::lock_guard<std::mutex> guard{ lock };
+	ms_per_pixel = ms / pixels;
+	last_depth = depth;
+}
+
+MandelbrotPreview FrameGovernor::Plan(int width, int height, int depth) const
+{
+	const double budget = Budget();
+	auto Fits = [&](int scale, int d) {
+		return PredictMs((width + scale - 1) / scale, (height + scale - 1) / scale, d) <= budget;
+	};
+
+	for (int scale = 1; scale <= kMaxPreviewScale; scale *= 2)
+		if (Fits(scale, depth))
+			return { scale, depth };
+
+	// only pixels which do not escape cost the whole depth, so the preview
+	// may take longer than predicted, still far below the full frame
+	int d = depth;
+	while (d / 2 >= kMinPreviewDepth && !Fits(kMaxPreviewScale, d))
+		d /= 2;
+	return { kMaxPreviewScale, d };
+}
+
+bool MeteredTileCache::Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts,
+	int stride)
+{
+	if (!cache.Load(p, width, height, tile, counts, stride))
+		return false;
+	served += tile.width * static_cast<std::int64_t>(tile.height);
+	return true;
+}
+
+void MeteredTileCache::Save(const MandelbrotParams& p, int width, int height, const TileRect& tile,
+	const int* counts, int stride)
+{
+	cache.Save(p, width, height, tile, counts, stride);
+}
+
+void Mandelbrot_RenderPreview(const MandelbrotParams& p, const MandelbrotPreview& preview,
+	const MandelbrotPalette& palette, FrameBuffer& out)
+{
+	const int s = preview.scale;
+	const int width = (out.width + s - 1) / s;
+	const int height = (out.height + s - 1) / s;
+
+	// the blocks overhang the frame, the view is extended to match
+	MandelbrotParams view = Mandelbrot_SubView(p, out.width, out.height, { 0, 0, width * s, height * s });
+	view.depth = preview.depth;
+	FrameBuffer coarse{ width, height, FrameBuffer::FirstTouch{} };
+	Mandelbrot_Shade(Mandelbrot_Compute(view, width, height), palette, coarse);
+
+	for (int y = 0; y < out.height; y++)
+	{
+		const FrameBuffer::Colour* src = coarse.Row(y / s);
+		FrameBuffer::Colour* dst = out.Row(y);
+		for (int x = 0; x < out.width; x++)
+			dst[x] = src[x / s];
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "framebuffer.h"
+#include "mandel_algo.h"
+
+// First picture of an interactive frame: computed at 1 / scale of the
+// resolution (scale x scale pixel blocks) and at `depth` iterations
+struct MandelbrotPreview {
+	int scale = 1;   // 1 - the frame itself fits the budget, no preview
+	int depth = 0;
+};
+
+// Keeps the latency of interactive frames within a budget whatever the view,
+// depth and machine. The cost per pixel of the last full frame predicts the
+// next one (scaled by depth if that changed); when that is over budget a
+// coarse preview is shown first and the full quality frame refines it in the
+// background. Resolution goes first (halved up to kMaxPreviewScale), depth
+// only if even the coarsest picture is too slow.
+class FrameGovernor {
+public:
+	static constexpr int kMaxPreviewScale = 8;
+	static constexpr int kMinPreviewDepth = 100;
+
+	explicit FrameGovernor(double budget_ms = 50);
+
+	void SetBudget(double ms);
+	double Budget() const;
+
+	// How to start a `width` x `height` frame at `depth`
+	MandelbrotPreview Plan(int width, int height, int depth) const;
+
+	// Measured time of a full quality frame at `depth` which computed
+	// `pixels` pixels. Tiles taken from a cache must not be counted (see
+	// MeteredTileCache), a frame computing nothing is not recorded.
+	void Record(double pixels, int depth, double ms);
+
+	// Predicted time of a frame, 0 before anything was recorded
+	double PredictMs(int width, int height, int depth) const;
+
+private:
+	mutable std::mutex lock;
+	double budget_ms;
+	double ms_per_pixel = 0;  // of the last full frame
+	int last_depth = 0;       // its depth, cost is taken as linear in depth
+};
+
+// Tile cache in front of another one, counting the pixels it served, so
+// that the governor learns the cost of computed pixels only
+class MeteredTileCache : public MandelbrotTileCache {
+public:
+	explicit MeteredTileCache(MandelbrotTileCache& cache) : cache{ cache } {}
+
+	bool Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride) override;
+	void Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride) override;
+
+	std::int64_t ServedPixels() const { return served; }
+
+private:
+	MandelbrotTileCache& cache;
+	std::atomic<std::int64_t> served{ 0 };
+};
+
+// Render the preview of view `p` into `out`, every computed pixel copied to
+// its scale x scale block. Nothing goes to the tile cache.
+void Mandelbrot_RenderPreview(const MandelbrotParams& p, const MandelbrotPreview& preview,
+	const MandelbrotPalette& palette, FrameBuffer& out);
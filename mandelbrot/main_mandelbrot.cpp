@@ -21,28 +21,45 @@
 // mandelbrot.cpp : Defines the entry point for the application.
 //
 #include <windows.h>
-#include <gdiplus.h>
-#include <objidl.h>
+#include <windowsx.h>
 
 // remove windows crap
 #ifdef min
 #undef min
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <list>
+#include <string>
+#include <iterator>
 #include "framework.h"
 #include "resource.h"
 #include "display_state.h"
-#include "image.h"
+#include "framebuffer.h"
+#include "frame_exchange.h"
+#include "lockfree_queue.h"
+#include "win_drawing.h"
 #include "mandel_algo.h"
+#include "buddhabrot.h"
+#include "tile_store.h"
+#include "auto_tune.h"
+#include "prefetch.h"
+#include "nucleus.h"
+#include "frame_governor.h"
+#include "shared_frames.h"
 #include "debug_output.h"
 
-#pragma comment(lib, "Gdiplus.lib")
-
 
 #define MAX_LOADSTRING 100
 #define WM_REDRAW (WM_USER + 1)
+#define WM_TILE (WM_USER + 2)
 
 
 // Global Variables:
@@ -50,28 +67,314 @@ HINSTANCE hInst;                                // current instance
 WCHAR szTitle[MAX_LOADSTRING];                  // The title bar text
 WCHAR szWindowClass[MAX_LOADSTRING];            // the main window class name
 
-Image g_image{ 800, 600 };             // rendered image
-bool g_fImageReady{ false };
+FrameExchange g_image{ 800, 600 };     // rendered image, front buffer is owned by the UI thread
+bool g_fImageReady{ false };           // UI thread only
 MandelbrotParams fractalParams;
+std::vector<MandelbrotParams> g_history; // views before each zoom, for going back
+TileStore g_store;                       // iteration counts of views seen before
+MandelbrotCounts g_counts;               // counts of the last frame, guarded by g_renderLock
+MandelbrotParams g_countsView;           // view of g_counts, guarded by g_renderLock
+std::unique_ptr<SharedMemoryPresenter> g_shared; // frames for other processes, UI thread only
+MandelbrotPrefetch g_prefetch{ &g_store };       // speculative zoom renders while idle
+FrameGovernor g_governor{ 50 };                  // latency budget of a click, in ms
+
+// palettes switched with the 'C' key, only the shade stage runs on a switch
+const MandelbrotPalette kPalettes[] = {
+	{},
+	{ MandelbrotPalette::Mode::histogram, 0., 360. },
+	{ MandelbrotPalette::Mode::cyclic, 0., 1., 64. },
+	{ MandelbrotPalette::Mode::cyclic, 0., 1., 16. },
+};
+int g_palette{ 0 };
+
+// starting views of the fractals switched with the 'F' key
+MandelbrotParams FractalView(Fractal fractal, double x_start, double y_start)
+{
+	MandelbrotParams p;
+	p.fractal = fractal;
+	p.x_start = x_start;
+	p.y_start = y_start;
+	p.x_range = 3.2;
+	p.y_range = 2.4;
+	return p;
+}
+const MandelbrotParams kFractals[] = {
+	{},
+	FractalView(Fractal::julia, -1.6, -1.2),
+	FractalView(Fractal::multibrot, -1.6, -1.2),
+	FractalView(Fractal::burning_ship, -2.2, -1.9),
+	FractalView(Fractal::tricorn, -2.1, -1.2),
+};
+int g_fractal{ 0 };
+
+// Tile of a picture which is still being rendered, shown before the whole
+// frame is finished.
+struct TileUpdate {
+	unsigned frame;
+	TileRect rect;
+	FrameBuffer::Colour pixels[kMandelbrotMaxTileSize * kMandelbrotMaxTileSize];
+};
+
+LockFreeQueue<TileUpdate, 64> g_tiles;  // render threads -> UI thread
+std::atomic<unsigned> g_frameId{ 0 };   // frame currently being rendered
+std::mutex g_renderLock;                // one render (frame producer) at a time
+
+// Lets speculative renders start again when a real render, begun with
+// g_prefetch.Take or Preempt, is over
+struct PrefetchResume {
+	~PrefetchResume() { g_prefetch.Resume(); }
+};
+
+// Render threads started by the UI thread. They use the globals above, so
+// they are all joined before wWinMain returns; finished ones are joined
+// whenever another one starts.
+class RenderThreads {
+public:
+	template <class F, class... Args>
+	void Start(F&& f, Args&&... args) {
+		running.remove_if([](Render& r) {
+			if (!r.done)
+				return false;
+			r.thread.join();
+			return true;
+			});
+
+		Render& r = running.emplace_back();
+		r.thread = std::thread{ [&done = r.done, f = std::forward<F>(f)](auto... args) {
+			f(args...);
+			done = true;
+			}, std::forward<Args>(args)... };
+	}
 
-extern std::unique_ptr<Gdiplus::Bitmap> g_bitmap; // see win_drawing.cpp
+	void JoinAll() {
+		for (Render& r : running)
+			r.thread.join();
+		running.clear();
+	}
+
+private:
+	struct Render {
+		std::atomic<bool> done{ false };
+		std::thread thread;
+	};
+	std::list<Render> running; // UI thread only
+};
+
+RenderThreads g_renders;
+std::atomic<bool> g_quit{ false };   // set when the window is gone, renders stop early
+std::atomic<bool> g_cancel{ false }; // the frame being computed is not wanted any more
+
+// Id of a frame the UI asks for. The render in progress is stopped, frames
+// and tiles of renders started before are dropped from now on.
+unsigned NewFrame() {
+	const unsigned frame = ++g_frameId;
+	g_cancel = true;
+	return frame;
+}
+
+// Whether `frame` is still wanted, by a render holding g_renderLock: clears
+// the cancel flag first, so that a newer frame asked for after this check
+// sets it again
+bool CurrentFrame(unsigned frame) {
+	g_cancel = false;
+	return !g_quit && frame == g_frameId.load();
+}
 
 
 // Forward declarations of functions included in this code module:
 ATOM                MyRegisterClass(HINSTANCE hInstance);
 HWND                InitInstance(HINSTANCE, int);
 LRESULT CALLBACK    WndProc(HWND, UINT, WPARAM, LPARAM);
+POINT               MouseClick(HWND hWnd);
+
+// Picture of view `params`, `frame` is the id the UI gave it; when it is not
+// current any more, before or while it is computed, a newer view was asked
+// for and this one is given up.
+void RenderPicture(HWND hWnd, MandelbrotParams params, unsigned frame, MandelbrotPalette palette) {
+	// a speculative render of this view is taken over, any other one stopped
+	MandelbrotCounts frameCounts;
+	const bool ready = g_prefetch.Take(params, g_image.Width(), g_image.Height(), frameCounts);
+	PrefetchResume resume;
+
+	std::lock_guard<std::mutex> lock{ g_renderLock };
+	if (!CurrentFrame(frame))
+		return;
 
-void OnPaint(HDC& hnd, Image& image);
+	FrameBuffer& back = g_image.Back();
 
-void RenderPicture(HWND hWnd) {
-	Mandelbrot_Image(fractalParams, g_image.width, g_image.height,
-		[](int x, int y, const Image::Colour& c) {
-			g_image.Pixel(x, y, c);
-		});
+	g_store.SetLastView(params, back.width, back.height);
 
-	g_fImageReady = true;
-	PostMessage(hWnd, WM_REDRAW, 0, 0);
+	if (!ready)
+	{
+		// a coarse picture within the budget first, the tiles of the full
+		// frame refine it as they finish
+		const MandelbrotPreview preview = g_governor.Plan(back.width, back.height, params.depth);
+		if (preview.scale > 1)
+		{
+			Mandelbrot_RenderPreview(params, preview, palette, back);
+			g_image.Publish();
+			PostMessage(hWnd, WM_REDRAW, frame, 0);
+		}
+
+		MeteredTileCache store{ g_store };
+		const auto start = std::chrono::steady_clock::now();
+		frameCounts = Mandelbrot_Compute(params, back.width, back.height, false,
+			[hWnd, frame, depth = params.depth, &palette](const TileRect& t, const int* counts, int stride) {
+				// if the UI is behind and the queue is full the tile is dropped,
+				// it will be shown with the complete frame anyway
+				const bool queued = g_tiles.TryPush([&](TileUpdate& u) {
+					u.frame = frame;
+					u.rect = t;
+					for (int y = 0; y < t.height; y++)
+						for (int x = 0; x < t.width; x++)
+							u.pixels[y * t.width + x] = FrameBuffer::Pack(Mandelbrot_PartialColour(counts[y * stride + x], depth, palette));
+					});
+				if (queued)
+					PostMessage(hWnd, WM_TILE, 0, 0);
+			},
+			&store, &g_cancel);
+		if (g_cancel)
+			return; // the frame may be incomplete, nobody is waiting for it
+		// pixels from the store cost next to nothing, they would make the
+		// next uncached frame look cheap
+		g_governor.Record(back.width * static_cast<double>(back.height) - store.ServedPixels(), params.depth,
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	g_counts = std::move(frameCounts);
+	g_countsView = params;
+
+	Mandelbrot_Shade(g_counts, palette, g_image.Back());
+
+	g_image.Publish();
+	PostMessage(hWnd, WM_REDRAW, frame, 0);
+}
+
+// Picture of view `to` made from the last picture where they share pixels:
+// moved by whole pixels (drag) only the uncovered strips are computed, on the
+// power of two lattice (wheel zoom) the shared pixels are kept. `frame` is
+// the id of the preview shown for it; when it is not current any more a newer
+// view was asked for and this one is skipped.
+void RenderReusing(HWND hWnd, MandelbrotParams to, unsigned frame, MandelbrotPalette palette) {
+	g_prefetch.Preempt();
+	PrefetchResume resume;
+	std::lock_guard<std::mutex> lock{ g_renderLock };
+	if (!CurrentFrame(frame))
+		return;
+
+	FrameBuffer& back = g_image.Back();
+	g_store.SetLastView(to, back.width, back.height);
+
+	int dx, dy;
+	if (!g_counts.Empty() && Mandelbrot_PixelShift(g_countsView, to, back.width, back.height, dx, dy))
+		Mandelbrot_Pan(g_countsView, dx, dy, g_counts);
+	else if (!g_counts.Empty() && Mandelbrot_OnLattice(g_countsView, back.width, back.height) &&
+		Mandelbrot_OnLattice(to, back.width, back.height))
+		g_counts = Mandelbrot_ComputeReusing(g_countsView, g_counts, to);
+	else
+		g_counts = Mandelbrot_Compute(to, back.width, back.height, false, {}, &g_store);
+	g_countsView = to;
+
+	Mandelbrot_Shade(g_counts, palette, back);
+
+	g_image.Publish();
+	PostMessage(hWnd, WM_REDRAW, frame, 0);
+}
+
+// Orbit density picture of the current view
+void RenderBuddhabrot(HWND hWnd, MandelbrotParams view, unsigned frame, bool anti) {
+	g_prefetch.Preempt();
+	PrefetchResume resume;
+	std::lock_guard<std::mutex> lock{ g_renderLock };
+	if (!CurrentFrame(frame))
+		return;
+
+	BuddhabrotParams p;
+	p.view = view;
+	p.anti = anti;
+	if (anti)
+		p.samples /= 10; // every sample inside runs its orbit to the limit
+	FrameBuffer& back = g_image.Back();
+	const BuddhabrotDensity density = Buddhabrot_Compute(p, back.width, back.height, &g_cancel);
+	if (g_cancel)
+		return;
+	Buddhabrot_Shade(density, back);
+
+	// the picture shown has no counts, recolouring and moving start afresh
+	g_counts = {};
+	g_countsView = {};
+
+	g_image.Publish();
+	PostMessage(hWnd, WM_REDRAW, frame, 0);
+}
+
+// Colour the last frame again with another palette, without computing it
+void RecolorPicture(HWND hWnd, MandelbrotPalette palette) {
+	std::lock_guard<std::mutex> lock{ g_renderLock };
+	if (g_quit || g_counts.Empty())
+		return;
+
+	Mandelbrot_Shade(g_counts, palette, g_image.Back());
+
+	g_image.Publish();
+	PostMessage(hWnd, WM_REDRAW, g_frameId.load(), 0);
+}
+
+// Tile store and tuning live in the user's local application data
+std::string LocalDataPath(const std::string& file) {
+	char dir[MAX_PATH];
+	const DWORD len = GetEnvironmentVariableA("LOCALAPPDATA", dir, MAX_PATH);
+	return len > 0 && len < MAX_PATH ? std::string{ dir } + "\\" + file : file;
+}
+
+// Apply the settings tuned for this machine, tuning them first if there are
+// none yet, then render
+void TuneAndRender(HWND hWnd, bool retune, MandelbrotParams params, unsigned frame, MandelbrotPalette palette) {
+	{
+		// the calibration renders are timed, nothing else may render meanwhile
+		g_prefetch.Preempt();
+		PrefetchResume resume;
+		std::lock_guard<std::mutex> lock{ g_renderLock };
+		if (g_quit)
+			return;
+		Mandelbrot_SetTuning(Mandelbrot_LoadOrTune(LocalDataPath("mandelbrot_tuning.txt"), retune));
+	}
+	RenderPicture(hWnd, params, frame, palette);
+}
+
+// Copy tiles delivered by render threads to the front buffer and invalidate
+// only their rectangles.
+void ShowTiles(HWND hWnd) {
+	FrameBuffer& front = g_image.Front();
+	while (g_tiles.TryPop([hWnd, &front](const TileUpdate& u) {
+		if (u.frame != g_frameId.load())
+			return; // tile of an abandoned frame
+
+		front.CopyFrom(u.rect, u.pixels, u.rect.width);
+		if (g_shared)
+			g_shared->Present(front, u.rect);
+		RECT rc{ u.rect.x, u.rect.y, u.rect.x + u.rect.width, u.rect.y + u.rect.height };
+		InvalidateRect(hWnd, &rc, false);
+		g_fImageReady = true;
+		}))
+	{
+	}
+}
+
+// Show the current picture scaled to the view about to be rendered, its tiles
+// replace the preview as they arrive. Returns the id of the new frame
+// (NewFrame).
+unsigned ShowPreview(HWND hWnd, const MandelbrotParams& from, const MandelbrotParams& to) {
+	const unsigned frame = NewFrame();
+	if (!g_fImageReady)
+		return frame;
+
+	FrameBuffer& front = g_image.Front();
+	FrameBuffer preview{ front.width, front.height, FrameBuffer::FirstTouch{} };
+	Mandelbrot_Reproject(front, from, to, preview);
+	front.CopyFrom(preview);
+	if (g_shared)
+		g_shared->Present(front);
+	InvalidateRect(hWnd, nullptr, false);
 }
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
@@ -96,12 +399,26 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 		return FALSE;
 	}
 
-	// Initialize GDI+.
-	Gdiplus::GdiplusStartupInput gdiplusStartupInput;
-	ULONG_PTR gdiplusToken;
-	Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
+	// start where the last session ended, its tiles are in the store
+	MandelbrotParams last;
+	int last_width, last_height;
+	if (g_store.Open(LocalDataPath("mandelbrot_tiles.dat")) && g_store.LastView(last, last_width, last_height) &&
+		last_width == g_image.Width() && last_height == g_image.Height())
+	{
+		fractalParams = last;
+	}
 
-	std::thread t{ RenderPicture, hWnd };
+	// MANDELBROT_SHARED_FRAMES=<name> publishes every frame in shared memory
+	char shared_name[MAX_PATH];
+	const DWORD shared_len = GetEnvironmentVariableA("MANDELBROT_SHARED_FRAMES", shared_name, MAX_PATH);
+	if (shared_len > 0 && shared_len < MAX_PATH)
+	{
+		g_shared = std::make_unique<SharedMemoryPresenter>(shared_name, g_image.Width(), g_image.Height());
+		if (!g_shared->Valid())
+			g_shared.reset();
+	}
+
+	g_renders.Start(TuneAndRender, hWnd, false, fractalParams, NewFrame(), kPalettes[g_palette]);
 
 	HACCEL hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_MANDELBROT));
 
@@ -117,11 +434,13 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 		}
 	}
 
-	t.join();
-
-	g_bitmap = nullptr;
+	// renders in flight stop at their next tile, none may outlive the store
+	g_quit = true;
+	g_cancel = true;
+	g_prefetch.Preempt();
+	g_renders.JoinAll();
 
-	Gdiplus::GdiplusShutdown(gdiplusToken);
+	g_store.Flush();
 	return (int)msg.wParam;
 }
 
@@ -167,8 +486,8 @@ HWND InitInstance(HINSTANCE hInstance, int nCmdShow)
 {
 	hInst = hInstance; // Store instance handle in our global variable
 
-	HWND hWnd = CreateWindowW(szWindowClass, szTitle, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, 0, g_image.width,
-		g_image.height, nullptr, nullptr, hInstance, nullptr);
+	HWND hWnd = CreateWindowW(szWindowClass, szTitle, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, 0, g_image.Width(),
+		g_image.Height(), nullptr, nullptr, hInstance, nullptr);
 
 	if (!hWnd)
 	{
@@ -183,27 +502,60 @@ HWND InitInstance(HINSTANCE hInstance, int nCmdShow)
 
 int zoom = 0;
 
-void ZoomFractal(int x, int y, int zoom)
+// Left button drag, UI thread only. A press released without moving further
+// than kDragThreshold pixels is a click and zooms.
+constexpr int kDragThreshold = 3;
+struct Drag {
+	bool active = false;    // left button is down
+	bool moved = false;     // went past the threshold, this is a pan
+	POINT start{};
+	MandelbrotParams view;  // view when the button went down
+};
+Drag g_drag;
+
+// Once the cursor rests this long over the picture, the view a click there
+// would zoom to is rendered speculatively
+constexpr UINT_PTR kPrefetchTimer = 1;
+constexpr UINT kPrefetchDelayMs = 200;
+
+// View a click at (x, y) zooms to
+MandelbrotParams ZoomedView(MandelbrotParams view, int x, int y)
 {
 	// shift image vector in relation to middle of the screen
-	auto vx = x - g_image.width / 2;
-	auto vy = y - g_image.height / 2;
+	auto vx = x - g_image.Width() / 2;
+	auto vy = y - g_image.Height() / 2;
 
 	// zoom in ratio of 80%
-	auto tmp1 = fractalParams.x_range;
-	auto tmp2 = fractalParams.y_range;
-	fractalParams.x_range *= 0.8;
-	fractalParams.y_range *= 0.8;
+	auto tmp1 = view.x_range;
+	auto tmp2 = view.y_range;
+	view.x_range *= 0.8;
+	view.y_range *= 0.8;
 
 	// convert the shift vector from image resolution to the fractal 'resolution'
-	auto dx = fractalParams.x_range / g_image.width * vx;
-	auto dy = fractalParams.y_range / g_image.height * vy;
+	auto dx = view.x_range / g_image.Width() * vx;
+	auto dy = view.y_range / g_image.Height() * vy;
 
 	// 
-	tmp1 = (tmp1 - fractalParams.x_range) / 2;
-	tmp2 = (tmp2 - fractalParams.y_range) / 2;
-	fractalParams.x_start += tmp1 + dx;
-	fractalParams.y_start += tmp2 + dy;
+	tmp1 = (tmp1 - view.x_range) / 2;
+	tmp2 = (tmp2 - view.y_range) / 2;
+	view.x_start += tmp1 + dx;
+	view.y_start += tmp2 + dy;
+	return view;
+}
+
+void ZoomFractal(int x, int y, int zoom)
+{
+	fractalParams = ZoomedView(fractalParams, x, y);
+}
+
+// Render the view a click at the cursor would zoom to; while a render is
+// running the prefetcher holds it back until the render is over
+void PrefetchUnderCursor(HWND hWnd) {
+	const POINT pos = MouseClick(hWnd);
+	if (pos.x < 0 || pos.y < 0 || pos.x >= g_image.Width() || pos.y >= g_image.Height())
+		return;
+
+	g_prefetch.Speculate(ZoomedView(fractalParams, pos.x, pos.y), g_image.Width(), g_image.Height());
 }
 
 // Return current mouse cursor position in window coordinates
@@ -241,22 +593,139 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 	switch (message)
 	{
 	case WM_REDRAW:
-		InvalidateRect(hWnd, nullptr, true);
+		// a frame finished after the view changed would undo the preview
+		if (wParam == g_frameId.load() && g_image.Acquire())
+		{
+			if (g_shared)
+				g_shared->Present(g_image.Front());
+			g_fImageReady = true;
+			InvalidateRect(hWnd, nullptr, false);
+		}
+		break;
+	case WM_TILE:
+		ShowTiles(hWnd);
+		break;
+	case WM_LBUTTONDOWN:
+		g_drag = Drag{ true, false, { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) }, fractalParams };
+		SetCapture(hWnd);
+		break;
+	case WM_MOUSEMOVE:
+	{
+		if (!g_drag.active || !(wParam & MK_LBUTTON))
+		{
+			// (re)start the wait for the cursor to rest
+			SetTimer(hWnd, kPrefetchTimer, kPrefetchDelayMs, nullptr);
+			break;
+		}
+
+		// the picture follows the mouse, so the view moves the other way
+		const int dx = g_drag.start.x - GET_X_LPARAM(lParam);
+		const int dy = g_drag.start.y - GET_Y_LPARAM(lParam);
+		if (!g_drag.moved && std::abs(dx) <= kDragThreshold && std::abs(dy) <= kDragThreshold)
+			break;
+		if (!g_drag.moved)
+			g_history.push_back(g_drag.view);
+		g_drag.moved = true;
+
+		// always from the view at the press, so moves do not add up rounding
+		const MandelbrotParams to = Mandelbrot_PanView(g_drag.view, g_image.Width(), g_image.Height(), dx, dy);
+		if (to.x_start == fractalParams.x_start && to.y_start == fractalParams.y_start)
+			break;
+		const unsigned frame = ShowPreview(hWnd, fractalParams, to);
+		fractalParams = to;
+		g_renders.Start(RenderReusing, hWnd, fractalParams, frame, kPalettes[g_palette]);
+	}
+	break;
+	case WM_TIMER:
+		if (wParam == kPrefetchTimer)
+		{
+			KillTimer(hWnd, kPrefetchTimer);
+			PrefetchUnderCursor(hWnd);
+		}
 		break;
 	case WM_LBUTTONUP:
 	{
+		const bool panned = g_drag.active && g_drag.moved;
+		g_drag.active = false;
+		ReleaseCapture();
+		if (panned)
+			break;
+
 		POINT pos = MouseClick(hWnd);
 
+		g_history.push_back(fractalParams);
 		ZoomFractal(pos.x, pos.y, 0);
-		std::thread t{ RenderPicture, hWnd };
-		t.detach();
+		const unsigned frame = ShowPreview(hWnd, g_history.back(), fractalParams);
+		g_renders.Start(RenderPicture, hWnd, fractalParams, frame, kPalettes[g_palette]);
 		OutputDebugString(std::to_string(zoom) + "," + std::to_string(pos.x) + "," + std::to_string(pos.y) + "\n");
 
 	}
 	break;
+	case WM_RBUTTONUP:
+		// back to the previous view, normally straight from the tile store
+		if (!g_history.empty())
+		{
+			const unsigned frame = ShowPreview(hWnd, fractalParams, g_history.back());
+			fractalParams = g_history.back();
+			g_history.pop_back();
+			g_renders.Start(RenderPicture, hWnd, fractalParams, frame, kPalettes[g_palette]);
+		}
+		break;
+	case WM_KEYDOWN:
+		if (wParam == 'C')
+		{
+			g_palette = (g_palette + 1) % static_cast<int>(std::size(kPalettes));
+			g_renders.Start(RecolorPicture, hWnd, kPalettes[g_palette]);
+		}
+		else if (wParam == 'B' || wParam == 'A')
+		{
+			g_renders.Start(RenderBuddhabrot, hWnd, fractalParams, NewFrame(), wParam == 'A');
+		}
+		else if (wParam == 'T')
+		{
+			g_renders.Start(TuneAndRender, hWnd, true, fractalParams, NewFrame(), kPalettes[g_palette]);
+		}
+		else if (wParam == 'N')
+		{
+			// jump straight to the mini-brot nearest the cursor
+			const POINT pos = MouseClick(hWnd);
+			const int width = g_image.Width(), height = g_image.Height();
+			MandelbrotNucleus nucleus;
+			if (Mandelbrot_LocateMinibrot(fractalParams, width, height,
+				std::clamp<int>(pos.x, 0, width - 1), std::clamp<int>(pos.y, 0, height - 1), nucleus))
+			{
+				g_history.push_back(fractalParams);
+				fractalParams = Mandelbrot_FrameNucleus(fractalParams, nucleus);
+				const unsigned frame = ShowPreview(hWnd, g_history.back(), fractalParams);
+				g_renders.Start(RenderPicture, hWnd, fractalParams, frame, kPalettes[g_palette]);
+			}
+		}
+		else if (wParam == 'F')
+		{
+			g_fractal = (g_fractal + 1) % static_cast<int>(std::size(kFractals));
+			fractalParams = kFractals[g_fractal];
+			g_history.clear();
+			g_renders.Start(RenderPicture, hWnd, fractalParams, NewFrame(), kPalettes[g_palette]);
+		}
+		else
+			return DefWindowProc(hWnd, message, wParam, lParam);
+		break;
 	case WM_MOUSEWHEEL:
 	{
-		int(wParam) < 0 ? zoom-- : zoom++;
+		// 2x steps on the power of two lattice, each new picture keeps the
+		// pixels it shares with the last one
+		POINT pos{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+		ScreenToClient(hWnd, &pos);
+		const int width = g_image.Width(), height = g_image.Height();
+		const MandelbrotParams lattice = Mandelbrot_OnLattice(fractalParams, width, height)
+			? fractalParams : Mandelbrot_LatticeView(fractalParams, width, height);
+		const MandelbrotParams to = Mandelbrot_LatticeZoom(lattice, width, height,
+			std::clamp<int>(pos.x, 0, width - 1), std::clamp<int>(pos.y, 0, height - 1), GET_WHEEL_DELTA_WPARAM(wParam) > 0);
+
+		g_history.push_back(fractalParams);
+		const unsigned frame = ShowPreview(hWnd, fractalParams, to);
+		fractalParams = to;
+		g_renders.Start(RenderReusing, hWnd, fractalParams, frame, kPalettes[g_palette]);
 	}
 	break;
 	case WM_PAINT:
@@ -266,7 +735,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
 		if (g_fImageReady)
 		{
-			OnPaint(hdc, g_image);
+			const auto& front = g_image.Front();
+			TileRect rc{ ps.rcPaint.left, ps.rcPaint.top, ps.rcPaint.right - ps.rcPaint.left, ps.rcPaint.bottom - ps.rcPaint.top };
+			rc.width = std::min(rc.width, front.width - rc.x);
+			rc.height = std::min(rc.height, front.height - rc.y);
+			if (rc.width > 0 && rc.height > 0)
+				DibPresenter{ hdc }.Present(front, rc);
 		}
 		else
 		{
@@ -274,7 +748,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 			auto len = GetTabbedTextExtentA(hdc, s.c_str(), s.size(), 0, 0);
 			auto w = len & 0xFFFF;
 			auto h = len >> 16;
-			TextOutA(hdc, (g_image.width - w) / 2, (g_image.height - h) / 2, s.c_str(), s.size());
+			TextOutA(hdc, (g_image.Width() - w) / 2, (g_image.Height() - h) / 2, s.c_str(), s.size());
 		}
 		EndPaint(hWnd, &ps);
 		OutputDebugStringA("Paint\n");
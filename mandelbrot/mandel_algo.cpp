@@ -20,120 +20,723 @@
 
 #include <functional>
 #include <complex>
-#include <thread>
-#include <future>
+#include <vector>
 #include <string>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
 #include "image.h"
 #include "mandel_algo.h"
 #include "debug_output.h"
 #include "hsv.h"
+#include "render_pool.h"
+#include "fractal_formulas.h"
 
 template <class T>
 T my_max(T l, T r) {
 	return l < r ? r : l;
 }
 
-using X = std::vector<int>;
-std::vector<X> counts;
+// Row kernel of `kernel`, all have the signature of Formula_Row
+template <class Formula>
+auto RowKernel(MandelbrotKernel kernel)
+{
+	switch (kernel)
+	{
+	case MandelbrotKernel::scalar:
+		return &Formula_RowScalar<Formula>;
+	case MandelbrotKernel::stream:
+		return &Formula_RowStream<Formula>;
+	default:
+		return &Formula_Row<Formula>;
+	}
+}
 
-int Mandelbrot_Pixel(std::complex<double> c)
+// Counts of the pixels of `tile`, in pixel coordinates of view `p` (the tile
+// may reach outside of the picture). `counts` and `smooth` point at the first
+// pixel of the tile, rows are `stride` apart.
+template <class Formula>
+int FormulaLoop(const Formula& f, const MandelbrotParams& p, double stepx, double stepy, const TileRect& tile,
+	int* counts, float* smooth, int stride, MandelbrotKernel kernel)
 {
-	std::complex<double> z{};
-	int count = 0;
-	int depth = 2000;
-	while (std::abs(z) <= 2. && count++ < depth)
+	// the whole tile is one queue of pixels for the lanes
+	if (kernel == MandelbrotKernel::stream)
+		return Formula_Stream(f, p.x_start, stepx, tile.x, p.y_start, stepy, tile.y, tile.width, tile.height, p.depth,
+			counts, smooth, stride);
+
+	auto row = RowKernel<Formula>(kernel);
+
+	int max = 0;
+	for (int y = 0; y < tile.height; y++)
 	{
-		z = z * z + c;
+		const size_t first = y * static_cast<size_t>(stride);
+		max = my_max(row(f, p.x_start, stepx, tile.x, p.y_start + (tile.y + y) * stepy, tile.width, p.depth,
+			counts + first, smooth ? smooth + first : nullptr), max);
 	}
 
-	return count;
+	return max;
+}
+
+template <int N, class Fn>
+auto WithMultibrot(int power, Fn&& fn)
+{
+	if constexpr (N < kMaxMultibrotPower)
+		if (power > N)
+			return WithMultibrot<N + 1>(power, fn);
+	return fn(MultibrotFormula<N>{});
 }
 
-int Loop(double x_start, double y_start, double stepx, double stepy,
-	int x_pos_begin, int x_pos_end, int height)
+// Call fn(formula) with the formula of the fractal of `p`. fn is instantiated
+// for every formula, so whatever loop it runs is a kernel of its own.
+template <class Fn>
+auto WithFormula(const MandelbrotParams& p, Fn&& fn)
+{
+	switch (p.fractal)
+	{
+	case Fractal::julia:
+		return fn(JuliaFormula{ p.c_re, p.c_im });
+	case Fractal::multibrot:
+		return WithMultibrot<2>(p.power, fn);
+	case Fractal::burning_ship:
+		return fn(BurningShipFormula{});
+	case Fractal::tricorn:
+		return fn(TricornFormula{});
+	default:
+		return fn(MandelbrotFormula{});
+	}
+}
+
+// The formula is picked once per tile
+int Loop(const MandelbrotParams& p, double stepx, double stepy, const TileRect& tile, int* counts, float* smooth, int stride,
+	MandelbrotKernel kernel)
+{
+	return WithFormula(p, [&](const auto& f) {
+		return FormulaLoop(f, p, stepx, stepy, tile, counts, smooth, stride, kernel);
+		});
+}
+
+int TileMax(const TileRect& tile, const int* counts, int width)
 {
 	int max = 0;
-	double x0 = x_start;
-	for (int x = x_pos_begin; x < x_pos_end; x++)
+	for (int y = tile.y; y < tile.y + tile.height; y++)
+		for (int x = tile.x; x < tile.x + tile.width; x++)
+			max = my_max(counts[y * static_cast<size_t>(width) + x], max);
+	return max;
+}
+
+// Colours of one picture through one palette
+class Shader {
+public:
+	Shader(const MandelbrotCounts& c, const MandelbrotPalette& p)
+		: counts{ c }
+		, palette{ p }
 	{
-		double y0 = y_start;
-		for (int y = 0; y < height; y++)
+		if (palette.mode != MandelbrotPalette::Mode::histogram)
+			return;
+
+		std::vector<int> count_per_pix(counts.max + 1);
+		int64_t total = 0;
+		for (const int c : counts.counts)
 		{
-			auto c = Mandelbrot_Pixel({ x0, y0 });
-			counts[x][y] = c;
-			max = my_max(c, max);
-			y0 += stepy;
+			++count_per_pix[c];
+			total += c;
+		}
+
+		// hue of count n is the sum of the histogram below n
+		const float totalf = static_cast<float>(total);
+		cumulative.resize(counts.max + 1);
+		float hue = 0;
+		for (int i = 0; i <= counts.max; i++)
+		{
+			cumulative[i] = hue;
+			hue += count_per_pix[i] / totalf;
+		}
+	}
+
+	Image::Colour operator()(size_t i) const
+	{
+		const int count = counts.counts[i];
+		if (palette.mode == MandelbrotPalette::Mode::histogram)
+		{
+			if (count >= counts.max)
+				return palette.inside;
+			rgb c = hsv2rgb({ palette.hue_offset + palette.hue_scale * cumulative[count], 255, 255. });
+			return { (float)c.r, (float)c.g, (float)c.b };
 		}
-		x0 += stepx;
+
+		if (count > counts.depth)
+			return palette.inside;
+		const double n = counts.smooth.empty() ? count : counts.smooth[i];
+		const double turn = n / palette.cycle;
+		rgb c = hsv2rgb({ 360. * (turn - std::floor(turn)), 1., 1. });
+		return { (float)c.r, (float)c.g, (float)c.b };
+	}
+
+private:
+	const MandelbrotCounts& counts;
+	const MandelbrotPalette& palette;
+	std::vector<float> cumulative;
+};
+
+Image::Colour Mandelbrot_PreviewColour(int count, int depth)
+{
+	rgb c = hsv2rgb({ count / static_cast<double>(depth), 255, count <= depth ? 255. : 0 });
+	return { (float)c.r, (float)c.g, (float)c.b };
+}
+
+Image::Colour Mandelbrot_PartialColour(int count, int depth, const MandelbrotPalette& palette)
+{
+	if (count > depth)
+		return palette.inside;
+	if (palette.mode == MandelbrotPalette::Mode::histogram)
+	{
+		rgb c = hsv2rgb({ palette.hue_offset + palette.hue_scale * count / depth, 255, 255. });
+		return { (float)c.r, (float)c.g, (float)c.b };
 	}
 
+	// same as the shade stage without smooth counts
+	const double turn = count / palette.cycle;
+	rgb c = hsv2rgb({ 360. * (turn - std::floor(turn)), 1., 1. });
+	return { (float)c.r, (float)c.g, (float)c.b };
+}
+
+
+void Mandelbrot_Reproject(const FrameBuffer& src, const MandelbrotParams& from, const MandelbrotParams& to, FrameBuffer& dst)
+{
+	// source pixel of destination pixel u is u * scale + offset
+	const double scale_x = to.x_range / from.x_range;
+	const double scale_y = to.y_range / from.y_range;
+	const double offset_x = (to.x_start - from.x_start) / from.x_range * src.width;
+	const double offset_y = (to.y_start - from.y_start) / from.y_range * src.height;
+
+	std::vector<int> columns(dst.width);
+	for (int u = 0; u < dst.width; u++)
+		columns[u] = static_cast<int>(std::floor((u + 0.5) * scale_x + offset_x));
+
+	for (int v = 0; v < dst.height; v++)
+	{
+		FrameBuffer::Colour* row = dst.Row(v);
+		const int y = static_cast<int>(std::floor((v + 0.5) * scale_y + offset_y));
+		if (y < 0 || y >= src.height)
+		{
+			std::fill_n(row, dst.width, FrameBuffer::Pack({ 0.f, 0.f, 0.f }));
+			continue;
+		}
+
+		const FrameBuffer::Colour* src_row = src.Row(y);
+		for (int u = 0; u < dst.width; u++)
+		{
+			const int x = columns[u];
+			row[u] = x >= 0 && x < src.width ? src_row[x] : FrameBuffer::Pack({ 0.f, 0.f, 0.f });
+		}
+	}
+}
+
+MandelbrotParams Mandelbrot_SubView(const MandelbrotParams& p, int width, int height, const TileRect& tile)
+{
+	const double stepx = p.x_range / width;
+	const double stepy = p.y_range / height;
+
+	MandelbrotParams sub = p;
+	sub.x_start = p.x_start + tile.x * stepx;
+	sub.y_start = p.y_start + tile.y * stepy;
+	sub.x_range = tile.width * stepx;
+	sub.y_range = tile.height * stepy;
+	return sub;
+}
+
+std::mutex g_tuningLock;
+MandelbrotTuning g_tuning;
+
+void Mandelbrot_SetTuning(const MandelbrotTuning& tuning)
+{
+	RenderPool& pool = SharedRenderPool();
+	{
+		std::lock_guard<std::mutex> guard{ g_tuningLock };
+		g_tuning = tuning;
+		g_tuning.tile_size = std::clamp(tuning.tile_size, 16, kMandelbrotMaxTileSize);
+	}
+	// the thread calling ParallelFor is one of them
+	pool.SetActiveThreads(tuning.threads > 0 ? tuning.threads - 1 : pool.Threads());
+}
+
+MandelbrotTuning Mandelbrot_Tuning()
+{
+	std::lock_guard<std::mutex> guard{ g_tuningLock };
+	return g_tuning;
+}
+
+// i-th tile of a picture, tiles row by row
+TileRect TileOf(int i, int width, int height, int size)
+{
+	const int tiles_x = (width + size - 1) / size;
+	TileRect t{ (i % tiles_x) * size, (i / tiles_x) * size, 0, 0 };
+	t.width = std::min(size, width - t.x);
+	t.height = std::min(size, height - t.y);
+	return t;
+}
+
+int TileCount(int width, int height, int size)
+{
+	return ((width + size - 1) / size) * ((height + size - 1) / size);
+}
+
+int Mandelbrot_TileCount(int width, int height)
+{
+	return TileCount(width, height, Mandelbrot_Tuning().tile_size);
+}
+
+// Counts of one tile from the cache or computed, returns the tile maximum.
+// `counts` rows are `stride` apart, `smooth` needs stride == width.
+int ComputeTile(const MandelbrotParams& p, int width, int height, const TileRect& t, int* counts, int stride,
+	float* smooth, MandelbrotTileCache* cache, MandelbrotKernel kernel)
+{
+	int* tile_counts = &counts[t.y * static_cast<size_t>(stride) + t.x];
+	if (cache && !smooth && cache->Load(p, width, height, t, tile_counts, stride))
+		return TileMax(t, counts, stride);
+
+	float* tile_smooth = smooth ? &smooth[t.y * static_cast<size_t>(width) + t.x] : nullptr;
+	const int max = Loop(p, p.x_range / width, p.y_range / height, t, tile_counts, tile_smooth, stride, kernel);
+	if (cache)
+		cache->Save(p, width, height, t, tile_counts, stride);
 	return max;
 }
 
+// Mandelbrot_Compute with the given settings, `helpers` pool threads helping
+// (< 0 - the active ones)
+MandelbrotCounts ComputeWith(const MandelbrotParams& p, int width, int height, bool smooth,
+	MandelbrotTileDone&& tile, MandelbrotTileCache* cache, const std::atomic<bool>* cancel,
+	const MandelbrotTuning& tuning, int helpers)
+{
+	MandelbrotCounts result;
+	result.width = width;
+	result.height = height;
+	result.depth = p.depth;
+	result.counts.resize(width * static_cast<size_t>(height));
+	if (smooth)
+		result.smooth.resize(result.counts.size());
+
+	int* counts = result.counts.data();
+	float* smooth_counts = smooth ? result.smooth.data() : nullptr;
+
+	const int tile_count = TileCount(width, height, tuning.tile_size);
 
-void Mandelbrot_Image(MandelbrotParams p, int width, int height, std::function<void(int, int, const Image::Colour&)>&& pixel) 
+	// pool threads take the next unrendered tile until there are none left,
+	// so expensive tiles (near the set boundary) do not stall a whole strip
+	std::vector<int> tile_max(tile_count);
+	SharedRenderPool().ParallelFor(tile_count, [&](int i) {
+		const TileRect t = TileOf(i, width, height, tuning.tile_size);
+		int* tile_counts = &counts[t.y * static_cast<size_t>(width) + t.x];
+		if (cancel && *cancel)
+		{
+			for (int y = 0; y < t.height; y++)
+				std::fill_n(tile_counts + y * static_cast<size_t>(width), t.width, 0);
+			if (smooth_counts)
+				for (int y = 0; y < t.height; y++)
+					std::fill_n(&smooth_counts[(t.y + y) * static_cast<size_t>(width) + t.x], t.width, 0.f);
+			return;
+		}
+
+		tile_max[i] = ComputeTile(p, width, height, t, counts, width, smooth_counts, cache, tuning.kernel);
+		if (tile)
+			tile(t, tile_counts, width);
+		}, helpers);
+
+	for (const int m : tile_max)
+		result.max = my_max(m, result.max);
+
+	return result;
+}
+
+MandelbrotCounts Mandelbrot_Compute(const MandelbrotParams& p, int width, int height, bool smooth,
+	MandelbrotTileDone&& tile, MandelbrotTileCache* cache, const std::atomic<bool>* cancel)
 {
+	return ComputeWith(p, width, height, smooth, std::move(tile), cache, cancel, Mandelbrot_Tuning(), -1);
+}
 
-	counts.resize(width);
-	std::for_each(counts.begin(), counts.end(), [height](auto& v) {v.resize(height); });
+MandelbrotCounts Mandelbrot_ComputeTuned(const MandelbrotParams& p, int width, int height,
+	const MandelbrotTuning& tuning)
+{
+	MandelbrotTuning t = tuning;
+	t.tile_size = std::clamp(tuning.tile_size, 16, kMandelbrotMaxTileSize);
+	// the thread calling ParallelFor is one of them
+	return ComputeWith(p, width, height, false, {}, nullptr, nullptr, t,
+		tuning.threads > 0 ? tuning.threads - 1 : SharedRenderPool().Threads());
+}
 
-	double stepx = p.x_range / width;
-	double stepy = p.y_range / height;
+int Mandelbrot_ComputeInto(const MandelbrotParams& p, int width, int height, int* counts, int stride,
+	MandelbrotTileCache* cache)
+{
+	const MandelbrotTuning tuning = Mandelbrot_Tuning();
+	const int tile_count = TileCount(width, height, tuning.tile_size);
+	std::vector<int> tile_max(tile_count);
+	SharedRenderPool().ParallelFor(tile_count, [&](int i) {
+		tile_max[i] = ComputeTile(p, width, height, TileOf(i, width, height, tuning.tile_size), counts, stride, nullptr,
+			cache, tuning.kernel);
+		});
 
-	auto t0 = std::async(std::launch::async, [xs = p.x_start, ys = p.y_start, stepx, stepy, xstart = 0, xend = width / 4, height]{
-		return Loop(xs, ys, stepx, stepy, xstart, xend, height);
+	int max = 0;
+	for (const int m : tile_max)
+		max = my_max(m, max);
+	return max;
+}
+
+// Row y of the counts into `row`
+void ShadeRow(const Shader& shade, const MandelbrotCounts& counts, int y, FrameBuffer::Colour* row)
+{
+	const size_t first = y * static_cast<size_t>(counts.width);
+	for (int x = 0; x < counts.width; x++)
+		row[x] = FrameBuffer::Pack(shade(first + x));
+}
+
+void Mandelbrot_Shade(const MandelbrotCounts& counts, const MandelbrotPalette& palette, FrameBuffer& out)
+{
+	const Shader shade{ counts, palette };
+	SharedRenderPool().ParallelFor(counts.height, [&](int y) {
+		ShadeRow(shade, counts, y, out.Row(y));
+		});
+}
+
+void Mandelbrot_Shade(const MandelbrotCounts& counts, const MandelbrotPalette& palette, FrameBuffer::Colour* out,
+	int stride)
+{
+	const Shader shade{ counts, palette };
+	SharedRenderPool().ParallelFor(counts.height, [&](int y) {
+		ShadeRow(shade, counts, y, out + y * static_cast<size_t>(stride));
 		});
+}
+
+std::vector<MandelbrotCounts> Mandelbrot_ComputeBatch(const std::vector<MandelbrotView>& views, MandelbrotTileCache* cache)
+{
+	std::vector<MandelbrotCounts> results(views.size());
+	const MandelbrotTuning tuning = Mandelbrot_Tuning();
+
+	// tiles of all views numbered one after the other
+	std::vector<int> first_tile(views.size() + 1);
+	for (size_t v = 0; v < views.size(); v++)
+	{
+		MandelbrotCounts& r = results[v];
+		r.width = views[v].width;
+		r.height = views[v].height;
+		r.depth = views[v].params.depth;
+		r.counts.resize(r.width * static_cast<size_t>(r.height));
+		first_tile[v + 1] = first_tile[v] + TileCount(r.width, r.height, tuning.tile_size);
+	}
 
+	std::vector<int> tile_max(first_tile.back());
+	SharedRenderPool().ParallelFor(first_tile.back(), [&](int i) {
+		const size_t v = std::upper_bound(first_tile.begin(), first_tile.end(), i) - first_tile.begin() - 1;
+		MandelbrotCounts& r = results[v];
+		const TileRect t = TileOf(i - first_tile[v], r.width, r.height, tuning.tile_size);
+		tile_max[i] = ComputeTile(views[v].params, r.width, r.height, t, r.counts.data(), r.width, nullptr, cache,
+			tuning.kernel);
+		});
+
+	for (size_t v = 0; v < views.size(); v++)
+		for (int i = first_tile[v]; i < first_tile[v + 1]; i++)
+			results[v].max = my_max(tile_max[i], results[v].max);
+	return results;
+}
 
-	p.x_start += width / 4 * stepx;
-	auto t1 = std::async(std::launch::async, [xs = p.x_start, ys = p.y_start, stepx, stepy, xstart = width / 4, xend = width / 2, height]{
-		return Loop(xs, ys, stepx, stepy, xstart, xend, height);
+void Mandelbrot_RenderBatch(const std::vector<MandelbrotView>& views, const MandelbrotPalette& palette,
+	const std::function<void(size_t, const FrameBuffer&)>& sink, MandelbrotTileCache* cache)
+{
+	const auto counts = Mandelbrot_ComputeBatch(views, cache);
+
+	// small pictures: one task shades a whole picture
+	SharedRenderPool().ParallelFor(static_cast<int>(views.size()), [&](int v) {
+		const Shader shade{ counts[v], palette };
+		FrameBuffer frame{ counts[v].width, counts[v].height, FrameBuffer::FirstTouch{} };
+		for (int y = 0; y < frame.height; y++)
+			ShadeRow(shade, counts[v], y, frame.Row(y));
+		sink(v, frame);
 		});
+}
 
-	p.x_start += width / 4 * stepx;
-	auto t2 = std::async(std::launch::async, [xs = p.x_start, ys = p.y_start, stepx, stepy, xstart = width / 2, xend = 3 * width / 4, height]{
-		return Loop(xs, ys, stepx, stepy, xstart, xend, height);
+void Mandelbrot_RenderAtlas(const std::vector<MandelbrotView>& views, const MandelbrotPalette& palette,
+	const std::vector<TileRect>& placement, FrameBuffer& atlas, MandelbrotTileCache* cache)
+{
+	const auto counts = Mandelbrot_ComputeBatch(views, cache);
+
+	SharedRenderPool().ParallelFor(static_cast<int>(views.size()), [&](int v) {
+		const Shader shade{ counts[v], palette };
+		for (int y = 0; y < counts[v].height; y++)
+			ShadeRow(shade, counts[v], y, atlas.Row(placement[v].y + y) + placement[v].x);
 		});
+}
+
+std::vector<TileRect> Mandelbrot_AtlasGrid(const std::vector<MandelbrotView>& views, int columns, int& width, int& height)
+{
+	int cell_w = 0, cell_h = 0;
+	for (const auto& v : views)
+	{
+		cell_w = my_max(v.width, cell_w);
+		cell_h = my_max(v.height, cell_h);
+	}
+
+	std::vector<TileRect> placement;
+	for (size_t i = 0; i < views.size(); i++)
+		placement.push_back({ static_cast<int>(i % columns) * cell_w, static_cast<int>(i / columns) * cell_h,
+			views[i].width, views[i].height });
+
+	const int rows = static_cast<int>((views.size() + columns - 1) / columns);
+	width = my_max(1, std::min(columns, static_cast<int>(views.size())) * cell_w);
+	height = my_max(1, rows * cell_h);
+	return placement;
+}
+
+void Mandelbrot_Shade(const MandelbrotCounts& counts, const MandelbrotPalette& palette,
+	std::function<void(int, int, const Image::Colour&)>&& pixel)
+{
+	const Shader shade{ counts, palette };
+	for (int y = 0; y < counts.height; y++)
+		for (int x = 0; x < counts.width; x++)
+			pixel(x, y, shade(y * static_cast<size_t>(counts.width) + x));
+}
+
+void Mandelbrot_Image(MandelbrotParams p, int width, int height, std::function<void(int, int, const Image::Colour&)>&& pixel,
+	MandelbrotTileDone&& tile, MandelbrotTileCache* cache)
+{
+	const MandelbrotCounts counts = Mandelbrot_Compute(p, width, height, false, std::move(tile), cache);
+	if (!pixel)
+		return; // caller only wants the tiles
+
+	Mandelbrot_Shade(counts, MandelbrotPalette{}, std::move(pixel));
+}
+
+MandelbrotParams Mandelbrot_PanView(const MandelbrotParams& p, int width, int height, int dx, int dy)
+{
+	MandelbrotParams moved = p;
+	moved.x_start = p.x_start + dx * (p.x_range / width);
+	moved.y_start = p.y_start + dy * (p.y_range / height);
+	return moved;
+}
+
+// Same fractal at the same depth, the counts of a point are the same
+bool SameFormula(const MandelbrotParams& a, const MandelbrotParams& b)
+{
+	return a.depth == b.depth && a.fractal == b.fractal && a.power == b.power && a.c_re == b.c_re && a.c_im == b.c_im;
+}
+
+bool Mandelbrot_PixelShift(const MandelbrotParams& from, const MandelbrotParams& to, int width, int height,
+	int& dx, int& dy)
+{
+	if (from.x_range != to.x_range || from.y_range != to.y_range || !SameFormula(from, to))
+		return false;
+
+	// moves made by Mandelbrot_PanView are whole pixels up to rounding
+	const double x = (to.x_start - from.x_start) / (from.x_range / width);
+	const double y = (to.y_start - from.y_start) / (from.y_range / height);
+	if (std::abs(x - std::round(x)) > 1e-3 || std::abs(y - std::round(y)) > 1e-3 ||
+		std::abs(std::round(x)) > width || std::abs(std::round(y)) > height)
+		return false;
 
+	dx = static_cast<int>(std::round(x));
+	dy = static_cast<int>(std::round(y));
+	return true;
+}
 
-	p.x_start += width / 4 * stepx;
-	int max = Loop(p.x_start, p.y_start, stepx, stepy, 3 * width / 4, width, height);
+// Move the pixels of a picture so that new pixel (x, y) is old pixel
+// (x + dx, y + dy), pixels coming into view are left as they are
+template <class T, class A>
+void ShiftPixels(std::vector<T, A>& pixels, int width, int height, int dx, int dy)
+{
+	const int n = width - std::abs(dx);
+	const int dst_x = my_max(-dx, 0), src_x = my_max(dx, 0);
+	auto row = [&](int y) {
+		std::memmove(&pixels[y * static_cast<size_t>(width) + dst_x],
+			&pixels[(y + dy) * static_cast<size_t>(width) + src_x], n * sizeof(T));
+	};
 
-	max = my_max(t0.get(), max);
-	max = my_max(t1.get(), max);
-	max = my_max(t2.get(), max);
+	// rows are moved in the order which reads each before it is overwritten
+	if (dy >= 0)
+		for (int y = 0; y < height - dy; y++)
+			row(y);
+	else
+		for (int y = height - 1; y >= -dy; y--)
+			row(y);
+}
 
-	int total = 0;
-	std::vector<int> count_per_pix;
-	count_per_pix.resize(max + 1);
-	for (const auto& v : counts)
+void Mandelbrot_Pan(const MandelbrotParams& from, int dx, int dy, MandelbrotCounts& counts)
+{
+	const int width = counts.width;
+	const int height = counts.height;
+	const bool smooth = !counts.smooth.empty();
+	if (std::abs(dx) >= width || std::abs(dy) >= height)
 	{
-		for (const int c : v)
+		counts = Mandelbrot_Compute(Mandelbrot_PanView(from, width, height, dx, dy), width, height, smooth);
+		return;
+	}
+
+	ShiftPixels(counts.counts, width, height, dx, dy);
+	if (smooth)
+		ShiftPixels(counts.smooth, width, height, dx, dy);
+
+	// columns coming into view over the whole height, then the rows coming
+	// into view over the remaining width
+	std::vector<TileRect> strips;
+	if (dx != 0)
+		strips.push_back({ dx > 0 ? width - dx : 0, 0, std::abs(dx), height });
+	if (dy != 0)
+		strips.push_back({ my_max(-dx, 0), dy > 0 ? height - dy : 0, width - std::abs(dx), std::abs(dy) });
+
+	// split into tiles so that all render threads help
+	const MandelbrotTuning tuning = Mandelbrot_Tuning();
+	std::vector<TileRect> parts;
+	for (const TileRect& strip : strips)
+		for (int i = 0; i < TileCount(strip.width, strip.height, tuning.tile_size); i++)
 		{
-			++count_per_pix[c];
-			total += c;
+			TileRect t = TileOf(i, strip.width, strip.height, tuning.tile_size);
+			t.x += strip.x;
+			t.y += strip.y;
+			parts.push_back(t);
 		}
+
+	const double stepx = from.x_range / width;
+	const double stepy = from.y_range / height;
+	SharedRenderPool().ParallelFor(static_cast<int>(parts.size()), [&](int i) {
+		const TileRect& t = parts[i];
+		const size_t first = t.y * static_cast<size_t>(width) + t.x;
+		const TileRect on_from{ t.x + dx, t.y + dy, t.width, t.height };
+		Loop(from, stepx, stepy, on_from, &counts.counts[first], smooth ? &counts.smooth[first] : nullptr, width,
+			tuning.kernel);
+		});
+
+	counts.max = counts.counts.empty() ? 0 : *std::max_element(counts.counts.begin(), counts.counts.end());
+}
+
+bool Mandelbrot_OnLattice(const MandelbrotParams& p, int width, int height)
+{
+	const double step = p.x_range / width;
+	int exponent;
+	return step > 0 && p.y_range / height == step && std::frexp(step, &exponent) == 0.5 &&
+		std::fmod(p.x_start, step) == 0 && std::fmod(p.y_start, step) == 0;
+}
+
+MandelbrotParams Mandelbrot_LatticeView(const MandelbrotParams& p, int width, int height)
+{
+	const double size = std::sqrt(p.x_range / width * (p.y_range / height));
+	const double step = std::exp2(std::round(std::log2(size)));
+	const double centre_x = p.x_start + p.x_range / 2;
+	const double centre_y = p.y_start + p.y_range / 2;
+
+	MandelbrotParams lattice = p;
+	lattice.x_range = step * width;
+	lattice.y_range = step * height;
+	lattice.x_start = std::round((centre_x - lattice.x_range / 2) / step) * step;
+	lattice.y_start = std::round((centre_y - lattice.y_range / 2) / step) * step;
+	return lattice;
+}
+
+MandelbrotParams Mandelbrot_LatticeZoom(const MandelbrotParams& p, int width, int height, int x, int y, bool in)
+{
+	const double step = p.x_range / width;
+	const double to = in ? step / 2 : step * 2;
+
+	// point of pixel (x, y) is x_start + x * step, all products and sums are
+	// exact on the lattice
+	MandelbrotParams zoomed = p;
+	zoomed.x_range = to * width;
+	zoomed.y_range = to * height;
+	zoomed.x_start = p.x_start + x * step - x * to;
+	zoomed.y_start = p.y_start + y * step - y * to;
+	if (!in)
+	{
+		// first pixel on a multiple of the larger pixel
+		zoomed.x_start -= std::fmod(zoomed.x_start, to);
+		zoomed.y_start -= std::fmod(zoomed.y_start, to);
+	}
+	return zoomed;
+}
+
+// Pixel of `from` at each pixel of `to` along one axis, -1 where there is none
+std::vector<int> LatticeSource(double from_start, double from_step, double to_start, double to_step, int n)
+{
+	// on the lattice the coordinates are whole multiples of the finer step
+	const double fine = std::min(from_step, to_step);
+	const int64_t offset = static_cast<int64_t>((to_start - from_start) / fine);
+	const int64_t to_k = static_cast<int64_t>(to_step / fine);
+	const int64_t from_k = static_cast<int64_t>(from_step / fine);
+
+	std::vector<int> source(n, -1);
+	for (int i = 0; i < n; i++)
+	{
+		const int64_t at = offset + i * to_k;
+		if (at >= 0 && at % from_k == 0 && at / from_k < n)
+			source[i] = static_cast<int>(at / from_k);
 	}
+	return source;
+}
+
+MandelbrotCounts Mandelbrot_ComputeReusing(const MandelbrotParams& from, const MandelbrotCounts& counts,
+	const MandelbrotParams& to)
+{
+	const int width = counts.width;
+	const int height = counts.height;
+	if (counts.Empty() || !SameFormula(from, to) ||
+		!Mandelbrot_OnLattice(from, width, height) || !Mandelbrot_OnLattice(to, width, height))
+		return Mandelbrot_Compute(to, width, height);
 
-	const float totalf = total;
+	const double from_step = from.x_range / width;
+	const double step = to.x_range / width;
+	const std::vector<int> columns = LatticeSource(from.x_start, from_step, to.x_start, step, width);
+	const std::vector<int> rows = LatticeSource(from.y_start, from_step, to.y_start, step, height);
 
-	std::vector<std::vector<float>> hue;
-	hue.resize(width);
-	std::for_each(hue.begin(), hue.end(), [height](auto& v) {v.resize(height); });
+	MandelbrotCounts result;
+	result.width = width;
+	result.height = height;
+	result.depth = to.depth;
+	result.counts.resize(counts.counts.size());
+
+	// columns missing in rows which are reused, as runs of pixels the same
+	// distance apart (typically every other pixel), each computed in one go
+	struct Run {
+		int x, gap, n;
+	};
+	std::vector<int> missing;
 	for (int x = 0; x < width; x++)
+		if (columns[x] < 0)
+			missing.push_back(x);
+	std::vector<Run> runs;
+	for (size_t k = 0; k < missing.size();)
 	{
-		for (int y = 0; y < height; y++)
-		{
-			int count = counts[x][y];
-			for (int i = 0; i < count; i++)
+		const int gap = k + 1 < missing.size() && missing[k + 1] - missing[k] == 2 ? 2 : 1;
+		size_t end = k + 1;
+		while (end < missing.size() && missing[end] - missing[end - 1] == gap)
+			end++;
+		runs.push_back({ missing[k], gap, static_cast<int>(end - k) });
+		k = end;
+	}
+
+	const MandelbrotKernel kernel = Mandelbrot_Tuning().kernel;
+	SharedRenderPool().ParallelFor(height, [&](int y) {
+		int* row = &result.counts[y * static_cast<size_t>(width)];
+		const double cy = to.y_start + y * step;
+		WithFormula(to, [&](const auto& f) {
+			using Formula = std::decay_t<decltype(f)>;
+			auto compute = RowKernel<Formula>(kernel);
+
+			if (rows[y] < 0)
+				return compute(f, to.x_start, step, 0, cy, width, to.depth, row, nullptr);
+
+			const int* old = &counts.counts[rows[y] * static_cast<size_t>(width)];
+			for (int x = 0; x < width; x++)
+				if (columns[x] >= 0)
+					row[x] = old[columns[x]];
+
+			std::vector<int> computed(missing.size());
+			for (const Run& r : runs)
 			{
-				hue[x][y] += count_per_pix[i] / totalf;
+				compute(f, to.x_start + r.x * step, r.gap * step, 0, cy, r.n, to.depth, computed.data(), nullptr);
+				for (int i = 0; i < r.n; i++)
+					row[r.x + i * r.gap] = computed[i];
 			}
+			return 0;
+			});
+		});
 
-			rgb c = hsv2rgb({ hue[x][y], 255, counts[x][y] < max ? 255. : 0 });
-			pixel(x, y, { (float)c.r, (float)c.g, (float)c.b });
-
-		}
-	}
-}
\ No newline at end of file
+	result.max = *std::max_element(result.counts.begin(), result.counts.end());
+	return result;
+}
@@ -1,18 +1,228 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <complex>
+#include <vector>
 #include "image.h"
+#include "framebuffer.h"
+#include "large_alloc.h"
+
+// Escape time fractals the renderer knows, see fractal_formulas.h
+enum class Fractal {
+	mandelbrot,
+	julia,        // c fixed to (c_re, c_im), z starts at the pixel
+	multibrot,    // z^power + c
+	burning_ship,
+	tricorn,
+};
+
+// Highest Multibrot power with its own kernel
+constexpr int kMaxMultibrotPower = 8;
 
 struct MandelbrotParams {
 	double x_start = -2.1;
 	double y_start = -1.2;
 	double x_range = 2.8;
 	double y_range = 2.4;
+	int depth = 2000;
+
+	Fractal fractal = Fractal::mandelbrot;
+	int power = 3;          // multibrot, 2 .. kMaxMultibrotPower
+	double c_re = -0.8;     // julia
+	double c_im = 0.156;
+
+	bool operator==(const MandelbrotParams&) const = default;
+};
+
+// Picture is rendered in square tiles of this size (edge tiles may be
+// smaller), unless tuned otherwise
+constexpr int kMandelbrotTileSize = 64;
+constexpr int kMandelbrotMaxTileSize = 128;
+
+// Kernel computing the counts of a tile
+enum class MandelbrotKernel {
+	lanes,   // kFormulaLanes pixels side by side, vectorised
+	scalar,  // one pixel at a time
+	stream,  // lanes refilled with the next pixel of the tile as each finishes
+};
+
+// Render settings which depend on the machine, see Mandelbrot_AutoTune
+struct MandelbrotTuning {
+	int tile_size = kMandelbrotTileSize;   // 16 .. kMandelbrotMaxTileSize
+	int threads = 0;                       // render threads, 0 - all of the shared pool
+	MandelbrotKernel kernel = MandelbrotKernel::lanes;
 };
 
+// Settings of the renders started from now on
+void Mandelbrot_SetTuning(const MandelbrotTuning& tuning);
+MandelbrotTuning Mandelbrot_Tuning();
+
+// Number of tiles a picture is rendered in with the current settings
+int Mandelbrot_TileCount(int width, int height);
+
+// Called from a render thread each time a tile of iteration counts is done.
+// `counts` points at the top-left count of the tile, rows are `stride` apart.
+// May be called concurrently from several threads.
+using MandelbrotTileDone = std::function<void(const TileRect& tile, const int* counts, int stride)>;
+
 
 struct MColor { float r, g, b; };
 
 //MColor Mandelbrot_Pixel(std::complex<double> c);
-void Mandelbrot_Image(MandelbrotParams p,int width, int height, std::function<void(int, int, const Image::Colour&)>&& pixel);
\ No newline at end of file
+
+// Source of already computed tiles, consulted before a tile is computed and
+// given every tile which had to be computed. Called concurrently from render
+// threads.
+class MandelbrotTileCache {
+public:
+	virtual ~MandelbrotTileCache() = default;
+
+	// Fill `counts` of the tile if it is known, return false otherwise
+	virtual bool Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride) = 0;
+	virtual void Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride) = 0;
+};
+
+// Result of the compute stage: escape iteration count of every pixel, row by
+// row. Points inside the set have count depth + 1. The buffers are first
+// touched by the render threads computing them, see RenderPool.
+struct MandelbrotCounts {
+	int width = 0;
+	int height = 0;
+	int depth = 0;
+	int max = 0;                 // highest count in the picture
+	std::vector<int, LargeAllocator<int>> counts;
+	std::vector<float, LargeAllocator<float>> smooth;   // fractional counts, empty unless requested
+
+	int At(int x, int y) const { return counts[y * static_cast<size_t>(width) + x]; }
+	bool Empty() const { return counts.empty(); }
+};
+
+// How the shade stage turns counts into colours
+struct MandelbrotPalette {
+	enum class Mode {
+		histogram, // hue follows the cumulative histogram of the picture
+		cyclic,    // hue repeats every `cycle` iterations
+	};
+
+	Mode mode = Mode::histogram;
+	double hue_offset = 0;   // histogram: added to the hue
+	double hue_scale = 1;    // histogram: multiplies the hue
+	double cycle = 64;       // cyclic: iterations per turn of the colour wheel
+	Image::Colour inside{ 0.f, 0.f, 0.f };
+};
+
+// View of a part of a picture: rendering `tile` of the returned view gives the
+// same points as that tile of the whole `width` x `height` picture of `p`
+MandelbrotParams Mandelbrot_SubView(const MandelbrotParams& p, int width, int height, const TileRect& tile);
+
+// Compute stage: iteration counts of a picture, rendered in tiles on the
+// shared render pool. Finished tiles go to `tile` (optional). Tiles found in
+// `cache` are not computed; with `smooth` the cache is only written, as it
+// holds integer counts only. Once `cancel` is set tiles not yet started are
+// left at count 0 and not reported. Safe to call from several threads at once.
+MandelbrotCounts Mandelbrot_Compute(const MandelbrotParams& p, int width, int height, bool smooth = false,
+	MandelbrotTileDone&& tile = {}, MandelbrotTileCache* cache = nullptr, const std::atomic<bool>* cancel = nullptr);
+
+// Compute stage with `tuning` instead of the current settings, which are left
+// alone; for calibration renders (Mandelbrot_AutoTune)
+MandelbrotCounts Mandelbrot_ComputeTuned(const MandelbrotParams& p, int width, int height,
+	const MandelbrotTuning& tuning);
+
+// Compute stage straight into a buffer of the caller, rows `stride` counts
+// apart. Returns the highest count.
+int Mandelbrot_ComputeInto(const MandelbrotParams& p, int width, int height, int* counts, int stride,
+	MandelbrotTileCache* cache = nullptr);
+
+// Shade stage: colour counts through a palette. Rows are shaded on the
+// shared render pool.
+void Mandelbrot_Shade(const MandelbrotCounts& counts, const MandelbrotPalette& palette, FrameBuffer& out);
+
+// Shade stage into a buffer of the caller, rows `stride` colours apart
+void Mandelbrot_Shade(const MandelbrotCounts& counts, const MandelbrotPalette& palette, FrameBuffer::Colour* out,
+	int stride);
+
+// Shade stage into a callback, called for every pixel from the calling thread
+void Mandelbrot_Shade(const MandelbrotCounts& counts, const MandelbrotPalette& palette,
+	std::function<void(int, int, const Image::Colour&)>&& pixel);
+
+// Both stages with the default palette. With an empty `pixel` callback the
+// colouring pass is skipped.
+void Mandelbrot_Image(MandelbrotParams p,int width, int height, std::function<void(int, int, const Image::Colour&)>&& pixel,
+	MandelbrotTileDone&& tile = {}, MandelbrotTileCache* cache = nullptr);
+
+// Picture of view `from` redrawn as view `to` by scaling its pixels, as a
+// stand-in until `to` is rendered. Pixels of `to` outside `from` are black.
+// Both frames must have the same size.
+void Mandelbrot_Reproject(const FrameBuffer& src, const MandelbrotParams& from, const MandelbrotParams& to, FrameBuffer& dst);
+
+// View `p` of a `width` x `height` picture moved by whole pixels, positive
+// `dx` and `dy` move it right and down
+MandelbrotParams Mandelbrot_PanView(const MandelbrotParams& p, int width, int height, int dx, int dy);
+
+// True if `to` is `from` moved by whole pixels, the move is set into `dx`, `dy`
+bool Mandelbrot_PixelShift(const MandelbrotParams& from, const MandelbrotParams& to, int width, int height,
+	int& dx, int& dy);
+
+// Turn the counts of view `from` into those of `from` moved by (dx, dy)
+// pixels. Counts still in view are moved in place and only the strips coming
+// into view are computed, on the pixel grid of `from`, so they line up exactly
+// with the moved ones. Costs |dx| * height + |dy| * width pixels instead of a
+// whole picture.
+void Mandelbrot_Pan(const MandelbrotParams& from, int dx, int dy, MandelbrotCounts& counts);
+
+// Views on the power of two lattice have square pixels whose size is a power
+// of two and a first pixel at a multiple of that size. Every pixel coordinate
+// of such a view is exact in a double (for pixels down to about 2^-50), so
+// lattice views zoomed or moved from one another share pixels bit for bit.
+bool Mandelbrot_OnLattice(const MandelbrotParams& p, int width, int height);
+
+// Lattice view nearest to `p`, with about the same centre and pixel size
+MandelbrotParams Mandelbrot_LatticeView(const MandelbrotParams& p, int width, int height);
+
+// Lattice view `p` zoomed 2x in or out, the point under pixel (x, y) stays
+// there (zooming out, up to half a pixel)
+MandelbrotParams Mandelbrot_LatticeZoom(const MandelbrotParams& p, int width, int height, int x, int y, bool in);
+
+// Counts of lattice view `to`, taking the pixels it shares with lattice view
+// `from` (same picture size) from `counts` and computing only the others. Two
+// views 2x apart share a quarter of the pixels of the smaller scale one.
+MandelbrotCounts Mandelbrot_ComputeReusing(const MandelbrotParams& from, const MandelbrotCounts& counts,
+	const MandelbrotParams& to);
+
+// One picture of a batch
+struct MandelbrotView {
+	MandelbrotParams params;
+	int width;
+	int height;
+};
+
+// Compute stage of many (small) pictures at once. Tiles of all of them go to
+// one ParallelFor, so thumbnails keep every render thread busy like a single
+// large frame does.
+std::vector<MandelbrotCounts> Mandelbrot_ComputeBatch(const std::vector<MandelbrotView>& views,
+	MandelbrotTileCache* cache = nullptr);
+
+// Batch of pictures, each given to `sink` with its index once shaded. The
+// sink is called concurrently from render threads.
+void Mandelbrot_RenderBatch(const std::vector<MandelbrotView>& views, const MandelbrotPalette& palette,
+	const std::function<void(size_t view, const FrameBuffer& frame)>& sink, MandelbrotTileCache* cache = nullptr);
+
+// Batch of pictures shaded into one atlas, view i at placement[i] (which
+// must lie inside the atlas and not overlap)
+void Mandelbrot_RenderAtlas(const std::vector<MandelbrotView>& views, const MandelbrotPalette& palette,
+	const std::vector<TileRect>& placement, FrameBuffer& atlas, MandelbrotTileCache* cache = nullptr);
+
+// Placement of views in a grid of `columns` cells as big as the largest view;
+// `width` and `height` are set to the size of the atlas
+std::vector<TileRect> Mandelbrot_AtlasGrid(const std::vector<MandelbrotView>& views, int columns, int& width, int& height);
+
+// Cheap colour of a single iteration count, usable before the whole picture
+// is known (final colours depend on the histogram of the entire picture).
+Image::Colour Mandelbrot_PreviewColour(int count, int depth);
+
+// Colour of a single count through `palette`, for tiles shown before the
+// whole picture is known. Cyclic palettes give the final colour; the
+// histogram of the picture is not known yet, so with the histogram mode the
+// hue follows count / depth and changes once the frame is shaded.
+Image::Colour Mandelbrot_PartialColour(int count, int depth, const MandelbrotPalette& palette);
@@ -0,0 +1,161 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include "nucleus.h"
+
+namespace {
+
+using Complex = std::complex<double>;
+
+constexpr int kMaxNewtonSteps = 64;
+constexpr double kBoxEscape = 1e12;       // |z|^2 at which a box corner is given up
+constexpr double kFrameSpan = 2.4;        // shorter side of the view per unit of size
+constexpr int kDepthPerPeriod = 20;
+constexpr double kMinRelativeSize = 1e-12; // smaller than this doubles cannot resolve
+
+// Crossings of the positive real axis by the closed polygon, odd when it
+// winds around the origin
+bool SurroundsOrigin(const Complex* q, int n)
+{
+	int crossings = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const Complex a = q[i];
+		const Complex b = q[(i + 1) % n];
+		if ((a.imag() > 0) == (b.imag() > 0))
+			continue;
+		const double x = a.real() - a.imag() * (b.real() - a.real()) / (b.imag() - a.imag());
+		if (x > 0)
+			crossings++;
+	}
+	return crossings % 2 == 1;
+}
+
+} // namespace
+
+int Mandelbrot_BoxPeriod(double re, double im, double radius, int max_period)
+{
+	const Complex c[4] = {
+		{ re - radius, im - radius }, { re + radius, im - radius },
+		{ re + radius, im + radius }, { re - radius, im + radius } };
+	Complex z[4] = {};
+	for (int n = 1; n <= max_period; n++)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			z[k] = z[k] * z[k] + c[k];
+			if (std::norm(z[k]) > kBoxEscape)
+				return 0;
+		}
+		if (SurroundsOrigin(z, 4))
+			return n;
+	}
+	return 0;
+}
+
+bool Mandelbrot_Nucleus(double re, double im, int period, MandelbrotNucleus& nucleus)
+{
+	if (period <= 0)
+		return false;
+
+	Complex c{ re, im };
+	bool converged = false;
+	for (int step = 0; step < kMaxNewtonSteps && !converged; step++)
+	{
+		Complex z = 0, dz = 0;
+		for (int i = 0; i < period; i++)
+		{
+			dz = 2. * z * dz + 1.;
+			z = z * z + c;
+		}
+		const Complex delta = z / dz;
+		if (!std::isfinite(delta.real()) || !std::isfinite(delta.imag()))
+			return false;
+		c -= delta;
+		converged = std::abs(delta) <= 1e-15 * std::max(1., std::abs(c));
+	}
+	if (!converged)
+		return false;
+
+	// size estimate: with l the derivative of z along the orbit,
+	// size = 1 / (b l^2) where b = sum of 1 / l over the period
+	Complex z = 0, l = 1, b = 1;
+	for (int i = 1; i < period; i++)
+	{
+		z = z * z + c;
+		l = 2. * z * l;
+		b += 1. / l;
+	}
+	const double size = 1. / std::abs(b * l * l);
+	if (!std::isfinite(size))
+		return false;
+
+	nucleus.re = c.real();
+	nucleus.im = c.imag();
+	nucleus.period = period;
+	nucleus.size = size;
+	return true;
+}
+
+MandelbrotParams Mandelbrot_FrameNucleus(const MandelbrotParams& p, const MandelbrotNucleus& nucleus)
+{
+	MandelbrotParams to = p;
+	const double scale = kFrameSpan * nucleus.size / std::min(p.x_range, p.y_range);
+	to.x_range = p.x_range * scale;
+	to.y_range = p.y_range * scale;
+	to.x_start = nucleus.re - to.x_range / 2;
+	to.y_start = nucleus.im - to.y_range / 2;
+	to.depth = std::max(p.depth, kDepthPerPeriod * nucleus.period);
+	return to;
+}
+
+bool Mandelbrot_LocateMinibrot(const MandelbrotParams& p, int width, int height, int x, int y,
+	MandelbrotNucleus& nucleus)
+{
+	if (p.fractal != Fractal::mandelbrot || width <= 0 || height <= 0)
+		return false;
+
+	const double re = p.x_start + (x + 0.5) * p.x_range / width;
+	const double im = p.y_start + (y + 0.5) * p.y_range / height;
+	const double view = std::min(p.x_range, p.y_range);
+	const double pixel = std::min(p.x_range / width, p.y_range / height);
+	for (double radius = view / 4; radius >= pixel; radius /= 2)
+	{
+		const int period = Mandelbrot_BoxPeriod(re, im, radius, p.depth);
+		MandelbrotNucleus found;
+		if (period == 0 || !Mandelbrot_Nucleus(re, im, period, found))
+			continue;
+		// Newton may run off to another nucleus of the same period
+		if (std::abs(found.re - re) > 2 * radius || std::abs(found.im - im) > 2 * radius)
+			continue;
+		// the one already framed by the view, look closer
+		if (kFrameSpan * found.size >= view / 2)
+			continue;
+		if (found.size < kMinRelativeSize * std::max(1., std::hypot(found.re, found.im)))
+			return false;
+		nucleus = found;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mandel_algo.h"
+
+// Locating mini-brots (hyperbolic components) of the Mandelbrot set without
+// rendering the way down to them.
+//
+// The box-period test iterates the corners of a box around a point; the first
+// iteration whose corner images surround the origin gives the period of the
+// lowest period component in the box. Newton's method on z_period(c) = 0 then
+// finds its nucleus, and the size estimate of the component (relative to the
+// whole set) tells how far to zoom. Plain Mandelbrot set only.
+
+struct MandelbrotNucleus {
+	double re = 0;
+	double im = 0;
+	int period = 0;
+	double size = 0;   // 1 for the whole set
+};
+
+// Period of the component within `radius` of (re, im), 0 if none is found up
+// to `max_period` iterations
+int Mandelbrot_BoxPeriod(double re, double im, double radius, int max_period);
+
+// Nucleus of period `period` by Newton's method from (re, im), with its size.
+// False if the iteration does not converge.
+bool Mandelbrot_Nucleus(double re, double im, int period, MandelbrotNucleus& nucleus);
+
+// View with the aspect of `p` centred on the nucleus and framing its
+// mini-brot, depth raised to resolve the period
+MandelbrotParams Mandelbrot_FrameNucleus(const MandelbrotParams& p, const MandelbrotNucleus& nucleus);
+
+// Mini-brot smaller than the view near pixel (x, y): boxes from a quarter of
+// the view down to a pixel around it are tried until one holds a nucleus
+// which Newton finds in the box and doubles can still render.
+bool Mandelbrot_LocateMinibrot(const MandelbrotParams& p, int width, int height, int x, int y,
+	MandelbrotNucleus& nucleus);
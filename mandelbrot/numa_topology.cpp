@@ -0,0 +1,143 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <fstream>
+#include <string>
+#include "numa_topology.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _WIN32
+
+std::vector<NumaNode> NumaNodes()
+{
+	std::vector<NumaNode> nodes;
+	ULONG highest = 0;
+	if (GetNumaHighestNodeNumber(&highest))
+	{
+		for (USHORT n = 0; n <= highest; n++)
+		{
+			GROUP_AFFINITY affinity{};
+			if (!GetNumaNodeProcessorMaskEx(n, &affinity) || affinity.Mask == 0)
+				continue;
+
+			NumaNode node{ n, {} };
+			for (int bit = 0; bit < 64; bit++)
+				if (affinity.Mask & (KAFFINITY{ 1 } << bit))
+					node.cpus.push_back(affinity.Group * 64 + bit);
+			nodes.push_back(std::move(node));
+		}
+	}
+
+	if (nodes.empty())
+		nodes.push_back({ 0, {} });
+	return nodes;
+}
+
+bool PinThreadToNode(const NumaNode& node)
+{
+	if (node.cpus.empty())
+		return false;
+
+	// a node never spans processor groups
+	GROUP_AFFINITY affinity{};
+	affinity.Group = static_cast<WORD>(node.cpus.front() / 64);
+	for (const int cpu : node.cpus)
+		affinity.Mask |= KAFFINITY{ 1 } << (cpu % 64);
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+#else
+
+namespace {
+
+// "0-3,8-11" as written in sysfs cpulist files
+std::vector<int> ParseCpuList(const std::string& list)
+{
+	std::vector<int> cpus;
+	size_t pos = 0;
+	while (pos < list.size())
+	{
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+		const std::string range = list.substr(pos, end - pos);
+		const size_t dash = range.find('-');
+		try
+		{
+			const int first = std::stoi(range);
+			const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		}
+		catch (const std::exception&)
+		{
+		}
+		pos = end + 1;
+	}
+	return cpus;
+}
+
+} // namespace
+
+std::vector<NumaNode> NumaNodes()
+{
+	std::vector<NumaNode> nodes;
+	// node numbers may have holes, give up after a few missing ones
+	for (int n = 0, missing = 0; missing < 8; n++)
+	{
+		std::ifstream file{ "/sys/devices/system/node/node" + std::to_string(n) + "/cpulist" };
+		std::string list;
+		if (!std::getline(file, list))
+		{
+			missing++;
+			continue;
+		}
+		missing = 0;
+
+		NumaNode node{ n, ParseCpuList(list) };
+		if (!node.cpus.empty())
+			nodes.push_back(std::move(node));
+	}
+
+	if (nodes.empty())
+		nodes.push_back({ 0, {} });
+	return nodes;
+}
+
+bool PinThreadToNode(const NumaNode& node)
+{
+	if (node.cpus.empty())
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const int cpu : node.cpus)
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+// CPUs of one NUMA node. On Windows a CPU number is group * 64 + index of the
+// processor in its group.
+struct NumaNode {
+	int id;
+	std::vector<int> cpus;
+};
+
+// Nodes of this machine which have CPUs. A machine without NUMA (or where the
+// topology cannot be read) is one node holding no CPU list.
+std::vector<NumaNode> NumaNodes();
+
+// Restrict the calling thread to the CPUs of `node`
+bool PinThreadToNode(const NumaNode& node);
@@ -0,0 +1,174 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdint>
+#include "prefetch.h"
+#include "render_pool.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Speculative work runs when nothing else wants the CPU
+void LowerThreadPriority()
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+	// on Linux the nice value of PRIO_PROCESS 0 is the calling thread's
+	setpriority(PRIO_PROCESS, 0, 10);
+#endif
+}
+
+} // namespace
+
+MandelbrotPrefetch::MandelbrotPrefetch(MandelbrotTileCache* cache_, size_t capacity_)
+	: cache{ cache_ }
+	, capacity{ std::max<size_t>(capacity_, 1) }
+	, worker{ [this] { Worker(); } }
+{
+}
+
+MandelbrotPrefetch::~MandelbrotPrefetch()
+{
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		stop = true;
+		cancel = true;
+	}
+	changed.notify_all();
+	worker.join();
+}
+
+bool MandelbrotPrefetch::Known(const View& v) const
+{
+	return (running && current == v) ||
+		std::any_of(entries.begin(), entries.end(), [&](const Entry& e) { return e.view == v; });
+}
+
+void MandelbrotPrefetch::Speculate(const MandelbrotParams& p, int width, int height)
+{
+	const View v{ p, width, height };
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		if (Known(v))
+			return;
+		next = v;
+		pending = true;
+	}
+	changed.notify_all();
+}
+
+bool MandelbrotPrefetch::Take(const MandelbrotParams& p, int width, int height, MandelbrotCounts& counts)
+{
+	const View v{ p, width, height };
+	std::unique_lock<std::mutex> guard{ lock };
+	pending = false;
+	paused++;
+
+	// the view being computed is the one asked for, finishing it is quicker
+	// than starting again
+	if (running && current == v)
+		changed.wait(guard, [&] { return !running; });
+	else if (running)
+		cancel = true;
+
+	const auto hit = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.view == v; });
+	if (hit == entries.end())
+		return false;
+
+	counts = std::move(hit->counts);
+	entries.erase(hit);
+	hits++;
+	return true;
+}
+
+void MandelbrotPrefetch::Preempt()
+{
+	std::lock_guard<std::mutex> guard{ lock };
+	pending = false;
+	paused++;
+	if (running)
+		cancel = true;
+}
+
+void MandelbrotPrefetch::Resume()
+{
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		if (paused > 0)
+			paused--;
+	}
+	changed.notify_all();
+}
+
+void MandelbrotPrefetch::Worker()
+{
+	LowerThreadPriority();
+	RenderPool::LimitCallerHelpers(std::max(SharedRenderPool().Threads() / 4, 1));
+
+	std::unique_lock<std::mutex> guard{ lock };
+	for (;;)
+	{
+		changed.wait(guard, [&] { return stop || (pending && paused == 0); });
+		if (stop)
+			return;
+
+		current = next;
+		pending = false;
+		running = true;
+		cancel = false;
+
+		guard.unlock();
+		std::atomic<std::int64_t> done{ 0 };
+		MandelbrotCounts counts;
+		bool failed = false;
+		try
+		{
+			counts = Mandelbrot_Compute(current.params, current.width, current.height, false,
+				[&done](const TileRect& t, const int*, int) { done += t.width * static_cast<std::int64_t>(t.height); },
+				cache, &cancel);
+		}
+		catch (...)
+		{
+			// out of memory: the view is dropped, a real request computes it
+			failed = true;
+		}
+		guard.lock();
+
+		// a render cancelled before its last tile has holes, one cancelled
+		// after it is complete
+		if (!failed && done == current.width * static_cast<std::int64_t>(current.height))
+		{
+			entries.push_front({ current, std::move(counts) });
+			if (entries.size() > capacity)
+				entries.pop_back();
+		}
+		running = false;
+		changed.notify_all();
+	}
+}
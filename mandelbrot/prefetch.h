@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "mandel_algo.h"
+
+// Speculative renders of the views the user is likely to ask for next (the
+// zoom under the cursor), computed while the renderer is idle.
+//
+// One view is computed at a time on a thread of its own, at below normal
+// priority and with at most a quarter of the shared render pool helping.
+// Finished counts are kept in a small cache keyed by the view and picture
+// size. A real request either takes its counts from the cache, waits for the
+// speculative render of exactly its view, or cancels whatever is being
+// computed so that the pool is free for it; no speculative render starts
+// until it calls Resume(). Tiles finished before a cancel still reach the
+// tile cache given to the constructor, and a render whose every tile was
+// done when the cancel came is kept. A render which fails is dropped.
+class MandelbrotPrefetch {
+public:
+	explicit MandelbrotPrefetch(MandelbrotTileCache* cache = nullptr, size_t capacity = 4);
+	~MandelbrotPrefetch();
+
+	MandelbrotPrefetch(const MandelbrotPrefetch&) = delete;
+	MandelbrotPrefetch& operator=(const MandelbrotPrefetch&) = delete;
+
+	// Compute `p` when the worker is free, replacing the view which was asked
+	// for before and is not started yet. Views already known are skipped.
+	void Speculate(const MandelbrotParams& p, int width, int height);
+
+	// Counts of a real request: true with `counts` set if the view is cached
+	// or was being computed (then this waits for it). Otherwise the
+	// speculative render is cancelled and the caller renders itself. Holds
+	// speculative work back like Preempt().
+	bool Take(const MandelbrotParams& p, int width, int height, MandelbrotCounts& counts);
+
+	// Cancel speculative work and start none until the matching Resume(),
+	// for real renders of other kinds
+	void Preempt();
+	void Resume();
+
+	// Number of requests served from speculative renders
+	unsigned Hits() const { return hits; }
+
+private:
+	struct View {
+		MandelbrotParams params;
+		int width = 0;
+		int height = 0;
+
+		bool operator==(const View&) const = default;
+	};
+	struct Entry {
+		View view;
+		MandelbrotCounts counts;
+	};
+
+	void Worker();
+	bool Known(const View& v) const;
+
+	MandelbrotTileCache* const cache;
+	const size_t capacity;
+
+	mutable std::mutex lock;
+	std::condition_variable changed;
+	std::deque<Entry> entries;     // most recent first
+	bool pending = false;          // `next` waits to be computed
+	View next;
+	int paused = 0;                // real renders between Take/Preempt and Resume
+	bool running = false;          // `current` is being computed
+	View current;
+	std::atomic<bool> cancel{ false };
+	bool stop = false;
+	std::atomic<unsigned> hits{ 0 };
+	std::thread worker;
+};
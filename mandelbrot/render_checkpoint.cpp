@@ -0,0 +1,300 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "render_checkpoint.h"
+#include "count_codec.h"
+#include "durable_file.h"
+
+namespace {
+constexpr char kManifestMagic[8] = { 'M', 'B', 'J', 'O', 'B', 'C', 'K', '1' };
+constexpr char kSegmentMagic[8] = { 'M', 'B', 'S', 'E', 'G', 'M', 'T', '1' };
+constexpr std::uint32_t kVersion = 1;
+constexpr const char* kManifestName = "manifest.mbj";
+
+// Tiles are told apart by their top-left corner, the size is checked on Load
+std::uint64_t TileKey(const TileRect& t)
+{
+	return static_cast<std::uint64_t>(static_cast<std::uint32_t>(t.x)) << 32 | static_cast<std::uint32_t>(t.y);
+}
+
+template <typename T>
+void Append(std::vector<char>& bytes, const T& value)
+{
+	const char* p = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+} // namespace
+
+struct RenderCheckpoint::Manifest {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t segments;      // written so far, for information: Open looks for the files
+	std::int32_t width, height, depth;
+	std::int32_t fractal, power;
+	std::uint32_t tiles;         // in the segments
+	double x_start, y_start, x_range, y_range;
+	double c_re, c_im;
+};
+
+struct RenderCheckpoint::SegmentHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t tiles;
+};
+
+struct RenderCheckpoint::TileRecord {
+	std::int32_t x, y, width, height;
+	std::uint32_t bytes;         // of count coded tile following the record
+	std::uint32_t reserved;
+};
+
+static_assert(sizeof(RenderCheckpoint::Manifest) == 88, "file format");
+static_assert(sizeof(RenderCheckpoint::SegmentHeader) == 16, "file format");
+static_assert(sizeof(RenderCheckpoint::TileRecord) == 24, "file format");
+
+RenderCheckpoint::RenderCheckpoint(std::chrono::milliseconds interval_)
+	: interval{ interval_ }
+{
+}
+
+RenderCheckpoint::~RenderCheckpoint()
+{
+	if (!dir.empty())
+		Flush();
+}
+
+bool RenderCheckpoint::Open(const std::string& dir_, const MandelbrotParams& p, int width_, int height_)
+{
+	namespace fs = std::filesystem;
+	dir = dir_;
+	job = p;
+	width = width_;
+	height = height_;
+	saved.clear();
+	pending.clear();
+	segments = 0;
+	resumed = 0;
+
+	std::error_code error;
+	fs::create_directories(dir, error);
+	if (!fs::is_directory(dir, error))
+		return false;
+
+	bool same = false;
+	{
+		std::ifstream file{ (fs::path{ dir } / kManifestName).string(), std::ios::binary };
+		Manifest m{};
+		if (file.read(reinterpret_cast<char*>(&m), sizeof(m)) &&
+			std::memcmp(m.magic, kManifestMagic, sizeof(kManifestMagic)) == 0 && m.version == kVersion)
+		{
+			MandelbrotParams q;
+			q.x_start = m.x_start;
+			q.y_start = m.y_start;
+			q.x_range = m.x_range;
+			q.y_range = m.y_range;
+			q.depth = m.depth;
+			q.fractal = static_cast<Fractal>(m.fractal);
+			q.power = m.power;
+			q.c_re = m.c_re;
+			q.c_im = m.c_im;
+			same = SameJob(q, m.width, m.height);
+		}
+	}
+
+	if (same)
+	{
+		// segments are numbered without gaps, a damaged one (torn by a power
+		// cut) only costs its own tiles
+		while (fs::exists(SegmentPath(segments), error))
+			ReadSegment(SegmentPath(segments++));
+	}
+	else
+	{
+		// another job's segments go before the manifest names this one
+		for (std::uint32_t n = 0; fs::exists(SegmentPath(n), error); n++)
+			fs::remove(SegmentPath(n), error);
+	}
+	resumed = static_cast<int>(saved.size());
+	tiles_written = static_cast<std::uint32_t>(saved.size());
+	last_write = std::chrono::steady_clock::now();
+	return WriteManifest();
+}
+
+bool RenderCheckpoint::SameJob(const MandelbrotParams& p, int width_, int height_) const
+{
+	return p == job && width_ == width && height_ == height;
+}
+
+bool RenderCheckpoint::ReadSegment(const std::string& path)
+{
+	std::ifstream file{ path, std::ios::binary };
+	const std::vector<char> data{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+	SegmentHeader h;
+	if (data.size() < sizeof(h))
+		return false;
+	std::memcpy(&h, data.data(), sizeof(h));
+	if (std::memcmp(h.magic, kSegmentMagic, sizeof(kSegmentMagic)) != 0 || h.version != kVersion)
+		return false;
+
+	size_t at = sizeof(h);
+	for (std::uint32_t i = 0; i < h.tiles; i++)
+	{
+		TileRecord r;
+		if (data.size() - at < sizeof(r))
+			return false;
+		std::memcpy(&r, data.data() + at, sizeof(r));
+		at += sizeof(r);
+		if (data.size() - at < r.bytes)
+			return false;
+		const TileRect t{ r.x, r.y, r.width, r.height };
+		if (t.x >= 0 && t.y >= 0 && t.width > 0 && t.height > 0 && t.x + t.width <= width && t.y + t.height <= height)
+			saved[TileKey(t)] = { t, std::vector<std::uint8_t>(data.begin() + at, data.begin() + at + r.bytes) };
+		at += r.bytes;
+	}
+	return true;
+}
+
+std::string RenderCheckpoint::SegmentPath(std::uint32_t n) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "tiles_%06u.mbs", n);
+	return (std::filesystem::path{ dir } / name).string();
+}
+
+bool RenderCheckpoint::WriteManifest()
+{
+	Manifest m{};
+	std::memcpy(m.magic, kManifestMagic, sizeof(kManifestMagic));
+	m.version = kVersion;
+	m.segments = segments;
+	m.width = width;
+	m.height = height;
+	m.depth = job.depth;
+	m.fractal = static_cast<std::int32_t>(job.fractal);
+	m.power = job.power;
+	m.tiles = tiles_written;
+	m.x_start = job.x_start;
+	m.y_start = job.y_start;
+	m.x_range = job.x_range;
+	m.y_range = job.y_range;
+	m.c_re = job.c_re;
+	m.c_im = job.c_im;
+
+	std::vector<char> bytes;
+	Append(bytes, m);
+	return WriteFileDurably((std::filesystem::path{ dir } / kManifestName).string(), bytes.data(), bytes.size());
+}
+
+bool RenderCheckpoint::Load(const MandelbrotParams& p, int width_, int height_, const TileRect& tile, int* counts,
+	int stride)
+{
+	if (!SameJob(p, width_, height_))
+		return false;
+	// saved is only written by Open
+	const auto found = saved.find(TileKey(tile));
+	if (found == saved.end() || found->second.tile.width != tile.width || found->second.tile.height != tile.height)
+		return false;
+	const auto& data = found->second.data;
+	return DecodeCounts(data.data(), data.size(), counts, tile.width, tile.height, stride, job.depth + 1);
+}
+
+void RenderCheckpoint::Save(const MandelbrotParams& p, int width_, int height_, const TileRect& tile,
+	const int* counts, int stride)
+{
+	if (dir.empty() || !SameJob(p, width_, height_))
+		return;
+	CodedTile tile_data{ tile, EncodeCounts(counts, tile.width, tile.height, stride) };
+
+	bool due;
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		pending.push_back(std::move(tile_data));
+		due = std::chrono::steady_clock::now() - last_write >= interval;
+	}
+	// the render thread which notices writes the segment, the others go on
+	if (due)
+		Flush();
+}
+
+bool RenderCheckpoint::Flush()
+{
+	std::lock_guard<std::mutex> writing{ write_lock };
+	std::vector<CodedTile> tiles;
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		tiles.swap(pending);
+		last_write = std::chrono::steady_clock::now();
+	}
+	if (tiles.empty())
+		return true;
+
+	SegmentHeader h{};
+	std::memcpy(h.magic, kSegmentMagic, sizeof(kSegmentMagic));
+	h.version = kVersion;
+	h.tiles = static_cast<std::uint32_t>(tiles.size());
+
+	std::vector<char> bytes;
+	Append(bytes, h);
+	for (const auto& t : tiles)
+	{
+		Append(bytes, TileRecord{ t.tile.x, t.tile.y, t.tile.width, t.tile.height,
+			static_cast<std::uint32_t>(t.data.size()), 0 });
+		bytes.insert(bytes.end(), t.data.begin(), t.data.end());
+	}
+
+	if (!WriteFileDurably(SegmentPath(segments), bytes.data(), bytes.size()))
+	{
+		// keep them for the next try
+		std::lock_guard<std::mutex> guard{ lock };
+		pending.insert(pending.end(), std::make_move_iterator(tiles.begin()), std::make_move_iterator(tiles.end()));
+		return false;
+	}
+	segments++;
+	tiles_written += h.tiles;
+	return WriteManifest();
+}
+
+void RenderCheckpoint::Remove()
+{
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		pending.clear();
+	}
+	// only the files of the checkpoint, the directory goes if nothing else is in it
+	namespace fs = std::filesystem;
+	std::error_code error;
+	std::lock_guard<std::mutex> writing{ write_lock };
+	for (std::uint32_t n = 0; n <= segments; n++)
+	{
+		fs::remove(SegmentPath(n), error);
+		fs::remove(SegmentPath(n) + ".tmp", error);
+	}
+	fs::remove(fs::path{ dir } / kManifestName, error);
+	fs::remove((fs::path{ dir } / kManifestName).string() + ".tmp", error);
+	fs::remove(dir, error);
+	dir.clear();
+}
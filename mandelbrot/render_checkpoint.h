@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mandel_algo.h"
+
+// Checkpoint of one long render, kept in a directory so that a killed job
+// resumes where it was.
+//
+// Given to the renderer as its tile cache: finished tiles are collected
+// (count coded, count_codec.h) and every `interval` written out as a new
+// segment file next to a manifest describing the job. Both are synced to
+// the disk before being renamed into place (durable_file.h), so a crash or
+// power cut loses at most the tiles of the last interval. Opening the
+// directory again for the same job answers Load for every tile already
+// saved and only the missing ones are computed; a different job starts
+// over. A segment which still comes back damaged (a disk which does not
+// honour syncs) is skipped as far as it cannot be parsed, and a tile whose
+// counts fail to decode or lie outside 0 .. depth + 1 is computed again.
+//
+// Only tiles of the job given to Open are taken, for the whole picture.
+class RenderCheckpoint : public MandelbrotTileCache {
+public:
+	explicit RenderCheckpoint(std::chrono::milliseconds interval = std::chrono::seconds(5));
+	~RenderCheckpoint() override;
+
+	// Resume the job `p` at width x height from `dir` or start it there.
+	// False if the directory cannot be written.
+	bool Open(const std::string& dir, const MandelbrotParams& p, int width, int height);
+
+	// Tiles found when the job was opened
+	int Resumed() const { return resumed; }
+
+	bool Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride) override;
+	void Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride) override;
+
+	// Write the tiles not yet in a segment
+	bool Flush();
+
+	// Delete the checkpoint once the result of the job is safely stored
+	void Remove();
+
+	// on-disk records, see render_checkpoint.cpp
+	struct Manifest;
+	struct SegmentHeader;
+	struct TileRecord;
+
+private:
+	struct CodedTile {
+		TileRect tile;
+		std::vector<std::uint8_t> data;
+	};
+
+	bool SameJob(const MandelbrotParams& p, int width, int height) const;
+	bool ReadSegment(const std::string& path);
+	bool WriteManifest();
+	std::string SegmentPath(std::uint32_t n) const;
+
+	const std::chrono::milliseconds interval;
+	std::string dir;
+	MandelbrotParams job;
+	int width = 0;
+	int height = 0;
+	int resumed = 0;
+
+	// count coded tiles of the segments read at Open, by top-left corner
+	std::unordered_map<std::uint64_t, CodedTile> saved;
+
+	std::mutex lock;             // pending tiles and the time of the last segment
+	std::vector<CodedTile> pending;
+	std::chrono::steady_clock::time_point last_write;
+
+	std::mutex write_lock;       // segment files and the manifest
+	std::uint32_t segments = 0;
+	std::uint32_t tiles_written = 0;
+};
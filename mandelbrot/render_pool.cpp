@@ -0,0 +1,197 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "render_pool.h"
+
+namespace {
+thread_local int caller_helper_limit = -1;
+}
+
+RenderPool::RenderPool(int threads)
+{
+	// at least one pool thread, or submitted tasks would never run
+	threads = std::max(threads, 2);
+
+	// only as many nodes as there are threads to put on them
+	auto topology = NumaNodes();
+	topology.resize(std::min(topology.size(), static_cast<size_t>(std::max(threads - 1, 1))));
+	for (auto& t : topology)
+	{
+		nodes.push_back(std::make_unique<Node>());
+		nodes.back()->topology = std::move(t);
+	}
+
+	// with a single node the scheduler knows best where to run the threads
+	const bool pin = nodes.size() > 1;
+
+	// the thread calling ParallelFor works too, so one less is enough
+	for (int i = 1; i < threads; i++)
+	{
+		const int n = (i - 1) % Nodes();
+		Node& node = *nodes[n];
+		node.threads++;
+		helper_nodes.push_back(n);
+		workers.emplace_back([this, &node, pin] {
+			if (pin)
+				PinThreadToNode(node.topology);
+			WorkerLoop(node);
+			});
+	}
+	active = Threads();
+}
+
+RenderPool::~RenderPool()
+{
+	stop = true;
+	for (auto& node : nodes)
+	{
+		// taking the lock orders the store before any waiter checks it
+		{ std::lock_guard<std::mutex> guard{ node->lock }; }
+		node->wake.notify_all();
+	}
+	for (auto& w : workers)
+		w.join();
+}
+
+void RenderPool::Submit(std::function<void()> task, int node)
+{
+	Node& target = *nodes[node >= 0 ? node % Nodes() : next_node++ % nodes.size()];
+	{
+		std::lock_guard<std::mutex> guard{ target.lock };
+		target.tasks.push_back(std::move(task));
+	}
+	target.wake.notify_one();
+}
+
+void RenderPool::SetActiveThreads(int threads)
+{
+	active = std::clamp(threads, 0, Threads());
+}
+
+bool RenderPool::TrySteal(std::function<void()>& task)
+{
+	for (auto& node : nodes)
+	{
+		std::lock_guard<std::mutex> guard{ node->lock };
+		if (!node->tasks.empty())
+		{
+			task = std::move(node->tasks.front());
+			node->tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void RenderPool::WorkerLoop(Node& node)
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard{ node.lock };
+			node.wake.wait(guard, [&] { return stop || !node.tasks.empty(); });
+			if (stop && node.tasks.empty())
+				return;
+			task = std::move(node.tasks.front());
+			node.tasks.pop_front();
+		}
+		task();
+
+		// help nodes with a backlog before going back to sleep
+		while (nodes.size() > 1 && TrySteal(task))
+			task();
+	}
+}
+
+void RenderPool::ParallelFor(int count, const std::function<void(int)>& job, int helpers)
+{
+	if (count <= 0)
+		return;
+
+	// shared with helper tasks which may start after this call returned
+	// (when all items were already taken by others)
+	struct Range {
+		std::atomic<int> next{ 0 };
+		int end = 0;
+	};
+	struct State {
+		explicit State(size_t nodes) : ranges(nodes) {}
+		std::vector<Range> ranges;
+		std::atomic<int> done{ 0 };
+		std::mutex lock;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared<State>(nodes.size());
+
+	// contiguous range per node, sized by its number of threads
+	const int pool_threads = std::max(Threads(), 1);
+	int first = 0, weight = 0;
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		weight += n + 1 == nodes.size() ? pool_threads - weight : nodes[n]->threads;
+		state->ranges[n].next = first;
+		state->ranges[n].end = static_cast<int>(static_cast<int64_t>(count) * weight / pool_threads);
+		first = state->ranges[n].end;
+	}
+
+	// own range first, then whatever is left in the others
+	auto run = [state, count, &job](size_t node) {
+		const size_t ranges = state->ranges.size();
+		for (size_t k = 0; k < ranges; k++)
+		{
+			Range& r = state->ranges[(node + k) % ranges];
+			for (int i = r.next++; i < r.end; i = r.next++)
+			{
+				job(i);
+				if (++state->done == count)
+				{
+					std::lock_guard<std::mutex> guard{ state->lock };
+					state->finished.notify_all();
+				}
+			}
+		}
+	};
+
+	helpers = std::min(helpers >= 0 ? std::min(helpers, Threads()) : active.load(), count - 1);
+	if (caller_helper_limit >= 0)
+		helpers = std::min(helpers, caller_helper_limit);
+	for (int i = 0; i < helpers; i++)
+		Submit([run, n = helper_nodes[i]] { run(n); }, helper_nodes[i]);
+
+	run(0);
+
+	std::unique_lock<std::mutex> guard{ state->lock };
+	state->finished.wait(guard, [&] { return state->done == count; });
+}
+
+void RenderPool::LimitCallerHelpers(int helpers)
+{
+	caller_helper_limit = helpers;
+}
+
+RenderPool& SharedRenderPool()
+{
+	static RenderPool pool;
+	return pool;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "numa_topology.h"
+
+// Fixed set of render threads shared by everything that renders in the
+// process (GUI frames, tile server requests, ...), so concurrent renders
+// share the cores instead of each one starting its own threads.
+//
+// On a NUMA machine the threads are spread over the nodes and pinned to the
+// CPUs of their node, each node with its own task queue. ParallelFor gives
+// every node a contiguous range of the items, so a node keeps working on the
+// same part of a picture in the compute and shade stages and buffers
+// allocated untouched (LargeAllocator) get their pages on that node.
+class RenderPool {
+public:
+	explicit RenderPool(int threads = std::thread::hardware_concurrency());
+	~RenderPool();
+
+	RenderPool(const RenderPool&) = delete;
+	RenderPool& operator=(const RenderPool&) = delete;
+
+	// Number of pool threads (the caller of ParallelFor is an extra one)
+	int Threads() const { return static_cast<int>(workers.size()); }
+
+	// Limit the pool threads helping each ParallelFor to `threads` (at most
+	// Threads()), for machines where fewer threads render faster
+	void SetActiveThreads(int threads);
+	int ActiveThreads() const { return active; }
+
+	// Number of NUMA nodes the threads are spread over
+	int Nodes() const { return static_cast<int>(nodes.size()); }
+
+	// Queue a task, returns immediately. Without a node the tasks go to the
+	// nodes in turn.
+	void Submit(std::function<void()> task, int node = -1);
+
+	// Call job(i) for every i in [0, count) on the pool threads and on the
+	// calling thread, return when all calls finished. Items are handed out one
+	// by one so uneven items balance out; a node whose range is finished helps
+	// with the others. `job` must not throw. `helpers` (>= 0) replaces the
+	// active threads for this call only, as calibration renders need.
+	void ParallelFor(int count, const std::function<void(int)>& job, int helpers = -1);
+
+	// Cap the pool threads helping ParallelFor calls made from the calling
+	// thread at `helpers` (< 0 - no cap), so that background work leaves most
+	// of the pool to interactive renders
+	static void LimitCallerHelpers(int helpers);
+
+private:
+	struct Node {
+		NumaNode topology;
+		std::mutex lock;
+		std::condition_variable wake;
+		std::deque<std::function<void()>> tasks;
+		int threads = 0;
+	};
+
+	void WorkerLoop(Node& node);
+	bool TrySteal(std::function<void()>& task);
+
+	std::vector<std::unique_ptr<Node>> nodes;
+	std::vector<int> helper_nodes; // node of the n-th ParallelFor helper
+	std::atomic<unsigned> next_node{ 0 };
+	std::atomic<bool> stop{ false };
+	std::atomic<int> active{ 0 };
+	std::vector<std::thread> workers;
+};
+
+// Pool used by Mandelbrot_Image and friends
+RenderPool& SharedRenderPool();
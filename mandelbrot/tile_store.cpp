@@ -0,0 +1,347 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include "tile_store.h"
+
+namespace {
+constexpr char kMagic[8] = { 'M', 'B', 'T', 'I', 'L', 'E', 'S', '1' };
+constexpr std::uint32_t kVersion = 2;
+constexpr std::size_t kInitialData = 16 << 20;
+}
+
+struct TileStore::Header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t index_capacity;
+	std::uint64_t data_end;     // first free byte of the data area
+	std::uint32_t entries;
+	std::uint32_t has_last_view;
+	double last_x_start, last_y_start, last_x_range, last_y_range;
+	double last_c_re, last_c_im;
+	std::int32_t last_depth, last_width, last_height;
+	std::int32_t last_fractal, last_power;
+	std::uint8_t reserved[28];
+};
+
+struct TileStore::Entry {
+	std::uint64_t hash;         // 0 - free slot
+	double x_start, y_start, x_range, y_range;
+	double c_re, c_im;
+	std::int32_t depth, width, height;
+	std::int32_t tile_x, tile_y, tile_w, tile_h;
+	std::int32_t fractal, power;
+	std::uint32_t element_size; // 2 or 4 bytes per count
+	std::uint64_t offset;       // of the counts in the file
+
+	bool SameKey(const Entry& o) const {
+		return hash == o.hash && x_start == o.x_start && y_start == o.y_start && x_range == o.x_range &&
+			y_range == o.y_range && c_re == o.c_re && c_im == o.c_im && depth == o.depth && width == o.width &&
+			height == o.height && tile_x == o.tile_x && tile_y == o.tile_y && tile_w == o.tile_w &&
+			tile_h == o.tile_h && fractal == o.fractal && power == o.power;
+	}
+};
+
+static_assert(sizeof(TileStore::Header) == 128, "file format");
+static_assert(sizeof(TileStore::Entry) == 104, "file format");
+
+namespace {
+
+// Tiles are keyed by their rectangle, which follows the tile size of the
+// settings (Mandelbrot_SetTuning): after the tile size changes the stored
+// tiles are not found any more and go when the store starts over.
+TileStore::Entry MakeKey(const MandelbrotParams& p, int width, int height, const TileRect& t)
+{
+	TileStore::Entry e{};
+	e.x_start = p.x_start;
+	e.y_start = p.y_start;
+	e.x_range = p.x_range;
+	e.y_range = p.y_range;
+	e.depth = p.depth;
+	e.width = width;
+	e.height = height;
+	e.tile_x = t.x;
+	e.tile_y = t.y;
+	e.tile_w = t.width;
+	e.tile_h = t.height;
+	// parameters a formula does not use must not split the cache
+	e.fractal = static_cast<std::int32_t>(p.fractal);
+	if (p.fractal == Fractal::multibrot)
+		e.power = p.power;
+	if (p.fractal == Fractal::julia)
+	{
+		e.c_re = p.c_re;
+		e.c_im = p.c_im;
+	}
+
+	// FNV-1a over the key fields
+	std::uint64_t h = 14695981039346656037ull;
+	const auto* bytes = reinterpret_cast<const std::uint8_t*>(&e.x_start);
+	const auto* end = reinterpret_cast<const std::uint8_t*>(&e.element_size);
+	for (; bytes != end; ++bytes)
+		h = (h ^ *bytes) * 1099511628211ull;
+	e.hash = h ? h : 1;
+	return e;
+}
+
+} // namespace
+
+bool TileStore::Open(const std::string& path, std::uint32_t index_capacity)
+{
+	std::unique_lock<std::shared_mutex> guard{ lock };
+	if (!file.Open(path, sizeof(Header)))
+		return false;
+
+	return Usable() || Create(std::bit_ceil(std::max(index_capacity, 1u)));
+}
+
+bool TileStore::Usable() const
+{
+	// a torn or damaged file must not send Find around an index without a
+	// free slot, nor Load outside of the data area
+	const Header& h = Head();
+	if (file.Size() < sizeof(Header) || std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion ||
+		!std::has_single_bit(h.index_capacity))
+		return false;
+	const std::uint64_t data_start = sizeof(Header) + std::uint64_t{ h.index_capacity } * sizeof(Entry);
+	if (data_start > h.data_end || h.data_end > file.Size())
+		return false;
+
+	const auto* index = reinterpret_cast<const Entry*>(file.Data() + sizeof(Header));
+	std::uint32_t used = 0;
+	for (std::uint32_t i = 0; i < h.index_capacity; i++)
+	{
+		const Entry& e = index[i];
+		if (e.hash == 0)
+			continue;
+		used++;
+		if ((e.element_size != 2 && e.element_size != 4) || e.tile_w <= 0 || e.tile_h <= 0 ||
+			e.tile_w > kMandelbrotMaxTileSize || e.tile_h > kMandelbrotMaxTileSize || e.offset < data_start ||
+			e.offset > h.data_end || e.offset % 8 != 0 ||
+			std::uint64_t(e.tile_w) * std::uint64_t(e.tile_h) * e.element_size > h.data_end - e.offset)
+			return false;
+	}
+	return used == h.entries && used < h.index_capacity;
+}
+
+bool TileStore::Create(std::uint32_t index_capacity)
+{
+	const std::size_t data_start = sizeof(Header) + index_capacity * sizeof(Entry);
+	if (!file.Resize(data_start + kInitialData))
+		return false;
+
+	// forget whatever was in the file, the data area is unreachable without index
+	std::memset(file.Data(), 0, data_start);
+
+	Header& h = Head();
+	std::memcpy(h.magic, kMagic, sizeof(kMagic));
+	h.version = kVersion;
+	h.index_capacity = index_capacity;
+	h.data_end = data_start;
+	return true;
+}
+
+void TileStore::Clear()
+{
+	// the data area is kept and overwritten, only the index is emptied
+	Header& h = Head();
+	std::memset(Index(), 0, std::size_t{ h.index_capacity } * sizeof(Entry));
+	h.entries = 0;
+	h.data_end = sizeof(Header) + std::uint64_t{ h.index_capacity } * sizeof(Entry);
+}
+
+TileStore::Header& TileStore::Head()
+{
+	return *reinterpret_cast<Header*>(file.Data());
+}
+
+const TileStore::Header& TileStore::Head() const
+{
+	return *reinterpret_cast<const Header*>(file.Data());
+}
+
+TileStore::Entry* TileStore::Index()
+{
+	return reinterpret_cast<Entry*>(file.Data() + sizeof(Header));
+}
+
+const TileStore::Entry* TileStore::Find(const Entry& key) const
+{
+	const auto* index = reinterpret_cast<const Entry*>(file.Data() + sizeof(Header));
+	const std::uint32_t mask = Head().index_capacity - 1;
+	for (std::uint32_t i = key.hash & mask;; i = (i + 1) & mask)
+	{
+		if (index[i].hash == 0)
+			return nullptr;
+		if (index[i].SameKey(key))
+			return &index[i];
+	}
+}
+
+std::uint32_t TileStore::Tiles() const
+{
+	std::shared_lock<std::shared_mutex> guard{ lock };
+	return Valid() ? Head().entries : 0;
+}
+
+bool TileStore::Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride)
+{
+	std::shared_lock<std::shared_mutex> guard{ lock };
+	if (!Valid())
+		return false;
+
+	const Entry* e = Find(MakeKey(p, width, height, tile));
+	if (!e)
+		return false;
+
+	// counts index the shader's histogram, a tile holding one outside of
+	// 0 .. depth + 1 is damaged and computed again
+	const auto limit = static_cast<std::uint32_t>(p.depth) + 1;
+	bool bad = false;
+	const std::uint8_t* src = file.Data() + e->offset;
+	for (int y = 0; y < tile.height; y++)
+	{
+		int* row = counts + y * static_cast<size_t>(stride);
+		if (e->element_size == 2)
+		{
+			const auto* s = reinterpret_cast<const std::uint16_t*>(src) + y * static_cast<size_t>(tile.width);
+			for (int x = 0; x < tile.width; x++)
+				row[x] = s[x];
+		}
+		else
+			std::memcpy(row, src + y * static_cast<size_t>(tile.width) * 4, tile.width * sizeof(int));
+		for (int x = 0; x < tile.width; x++)
+			bad |= static_cast<std::uint32_t>(row[x]) > limit;
+	}
+	return !bad;
+}
+
+void TileStore::Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride)
+{
+	std::unique_lock<std::shared_mutex> guard{ lock };
+	if (!Valid())
+		return;
+
+	// the size Open accepts for an entry
+	if (tile.width > kMandelbrotMaxTileSize || tile.height > kMandelbrotMaxTileSize)
+		return;
+
+	Entry e = MakeKey(p, width, height, tile);
+	if (Find(e))
+		return;
+
+	// keep the open-addressing index at most 3/4 full
+	const std::uint32_t limit = Head().index_capacity / 4 * 3;
+	if (limit == 0)
+		return;
+	if (Head().entries + 1 > limit)
+		Clear();
+
+	// counts go up to depth + 1
+	e.element_size = p.depth < 0xFFFF ? 2 : 4;
+	const std::size_t bytes = (tile.width * static_cast<size_t>(tile.height) * e.element_size + 7) & ~std::size_t{ 7 };
+	const std::size_t needed = Head().data_end + bytes;
+	if (needed > file.Size() && !file.Resize(needed > 2 * file.Size() ? needed : 2 * file.Size()))
+		return;
+
+	e.offset = Head().data_end;
+	std::uint8_t* dst = file.Data() + e.offset;
+	for (int y = 0; y < tile.height; y++)
+	{
+		const int* row = counts + y * static_cast<size_t>(stride);
+		if (e.element_size == 2)
+		{
+			auto* d = reinterpret_cast<std::uint16_t*>(dst) + y * static_cast<size_t>(tile.width);
+			for (int x = 0; x < tile.width; x++)
+				d[x] = static_cast<std::uint16_t>(row[x]);
+		}
+		else
+			std::memcpy(dst + y * static_cast<size_t>(tile.width) * 4, row, tile.width * sizeof(int));
+	}
+
+	// data first, then the slot; the hash marks the slot used
+	const std::uint32_t mask = Head().index_capacity - 1;
+	Entry* index = Index();
+	std::uint32_t i = e.hash & mask;
+	while (index[i].hash != 0)
+		i = (i + 1) & mask;
+	const std::uint64_t hash = e.hash;
+	e.hash = 0;
+	index[i] = e;
+	index[i].hash = hash;
+
+	Head().data_end += bytes;
+	Head().entries++;
+}
+
+bool TileStore::LastView(MandelbrotParams& p, int& width, int& height) const
+{
+	std::shared_lock<std::shared_mutex> guard{ lock };
+	if (!Valid() || !Head().has_last_view)
+		return false;
+
+	const Header& h = Head();
+	if (h.last_depth <= 0 || h.last_width <= 0 || h.last_height <= 0 || h.last_fractal < 0 ||
+		h.last_fractal > static_cast<std::int32_t>(Fractal::tricorn) || h.last_power < 2 ||
+		h.last_power > kMaxMultibrotPower)
+		return false;
+	p.x_start = h.last_x_start;
+	p.y_start = h.last_y_start;
+	p.x_range = h.last_x_range;
+	p.y_range = h.last_y_range;
+	p.depth = h.last_depth;
+	p.fractal = static_cast<Fractal>(h.last_fractal);
+	p.power = h.last_power;
+	p.c_re = h.last_c_re;
+	p.c_im = h.last_c_im;
+	width = h.last_width;
+	height = h.last_height;
+	return true;
+}
+
+void TileStore::SetLastView(const MandelbrotParams& p, int width, int height)
+{
+	std::unique_lock<std::shared_mutex> guard{ lock };
+	if (!Valid())
+		return;
+
+	Header& h = Head();
+	h.last_x_start = p.x_start;
+	h.last_y_start = p.y_start;
+	h.last_x_range = p.x_range;
+	h.last_y_range = p.y_range;
+	h.last_depth = p.depth;
+	h.last_fractal = static_cast<std::int32_t>(p.fractal);
+	h.last_power = p.power;
+	h.last_c_re = p.c_re;
+	h.last_c_im = p.c_im;
+	h.last_width = width;
+	h.last_height = height;
+	h.has_last_view = 1;
+}
+
+void TileStore::Flush()
+{
+	std::shared_lock<std::shared_mutex> guard{ lock };
+	file.Flush();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include "mapped_file.h"
+#include "mandel_algo.h"
+
+// Persistent store of raw iteration-count tiles in one memory-mapped file.
+//
+// A tile is identified by the view (MandelbrotParams including depth), the
+// size of the whole picture and the tile rectangle, i.e. by exactly what was
+// computed. Counts are kept as 16 bit values when the depth allows it.
+//
+// File layout: header, fixed-size open-addressing index, appended tile data.
+// Tile data is written before its index slot is marked used, so a crash
+// never leaves an entry pointing at garbage. When the index is full the store
+// starts over empty, the tiles of the views in use are soon saved again. One
+// process at a time: Open fails while another store has the file open.
+class TileStore : public MandelbrotTileCache {
+public:
+	// Open or create the store. An unreadable, incompatible or damaged file
+	// (index not a power of two, entries outside of the data area) is
+	// recreated empty.
+	//
+	// @param index_capacity - maximum number of tiles for a new file, power of two
+	bool Open(const std::string& path, std::uint32_t index_capacity = 1 << 16);
+
+	bool Valid() const { return file.Valid(); }
+
+	// number of stored tiles
+	std::uint32_t Tiles() const;
+
+	bool Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride) override;
+	void Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride) override;
+
+	// View shown when the application was last closed
+	bool LastView(MandelbrotParams& p, int& width, int& height) const;
+	void SetLastView(const MandelbrotParams& p, int width, int height);
+
+	void Flush();
+
+	// on-disk records, see tile_store.cpp
+	struct Header;
+	struct Entry;
+
+private:
+	bool Usable() const;
+	bool Create(std::uint32_t index_capacity);
+	void Clear();
+	Header& Head();
+	const Header& Head() const;
+	Entry* Index();
+	const Entry* Find(const Entry& key) const;
+
+	MappedFile file;
+	mutable std::shared_mutex lock;
+};
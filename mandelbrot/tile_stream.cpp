@@ -0,0 +1,241 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <utility>
+#include "tile_stream.h"
+#include "render_pool.h"
+
+struct MandelbrotRender::State {
+	std::mutex lock;
+	std::condition_variable changed;         // for the blocking consumers
+	std::deque<MandelbrotTile> ready;        // finished, not delivered yet
+	std::coroutine_handle<> tile_waiter;
+	std::coroutine_handle<> frame_waiter;
+	MandelbrotCounts counts;
+	std::exception_ptr error;                // first failure, rethrown with the frame
+	bool finished = false;
+	int total = 0;
+	std::atomic<int> done{ 0 };
+	std::atomic<bool> cancel{ false };
+	std::atomic<bool> subscribed{ false };   // a consumer takes the tiles
+
+	// resume outside of the lock, the coroutine may come straight back
+	static void Resume(std::coroutine_handle<> h)
+	{
+		if (h)
+			h.resume();
+	}
+
+	// keep the first failure and stop the tiles not started yet
+	void Fail(std::exception_ptr e)
+	{
+		{
+			std::lock_guard<std::mutex> guard{ lock };
+			if (!error)
+				error = std::move(e);
+		}
+		cancel = true;
+	}
+
+	void ThrowIfFailed() const
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+};
+
+MandelbrotRender Mandelbrot_RenderAsync(const MandelbrotParams& p, int width, int height, MandelbrotTileCache* cache)
+{
+	auto state = std::make_shared<MandelbrotRender::State>();
+	state->total = Mandelbrot_TileCount(width, height);
+
+	// nothing may leave the task: the pool thread would terminate and the
+	// waiters would never be resumed, so failures finish the frame as well
+	SharedRenderPool().Submit([state, p, width, height, cache] {
+		MandelbrotCounts counts;
+		try
+		{
+			counts = Mandelbrot_Compute(p, width, height, false,
+				[&state](const TileRect& t, const int* c, int stride) {
+					if (!state->subscribed)
+					{
+						state->done++;
+						return;
+					}
+
+					std::coroutine_handle<> waiter;
+					try
+					{
+						MandelbrotTile tile{ t, std::vector<int>(t.width * static_cast<size_t>(t.height)) };
+						for (int y = 0; y < t.height; y++)
+							std::copy_n(c + y * static_cast<size_t>(stride), t.width, &tile.counts[y * static_cast<size_t>(t.width)]);
+
+						std::lock_guard<std::mutex> guard{ state->lock };
+						state->ready.push_back(std::move(tile));
+						state->done++;
+						waiter = std::exchange(state->tile_waiter, {});
+					}
+					catch (...)
+					{
+						state->Fail(std::current_exception());
+						return;
+					}
+					state->changed.notify_all();
+					MandelbrotRender::State::Resume(waiter);
+				},
+				cache, &state->cancel);
+		}
+		catch (...)
+		{
+			state->Fail(std::current_exception());
+		}
+
+		std::coroutine_handle<> tile_waiter, frame_waiter;
+		{
+			std::lock_guard<std::mutex> guard{ state->lock };
+			state->counts = std::move(counts);
+			state->finished = true;
+			tile_waiter = std::exchange(state->tile_waiter, {});
+			frame_waiter = std::exchange(state->frame_waiter, {});
+		}
+		state->changed.notify_all();
+		MandelbrotRender::State::Resume(tile_waiter);
+		MandelbrotRender::State::Resume(frame_waiter);
+		});
+
+	return MandelbrotRender{ state };
+}
+
+void MandelbrotRender::Subscribe()
+{
+	state->subscribed = true;
+}
+
+void MandelbrotRender::Cancel()
+{
+	state->cancel = true;
+}
+
+bool MandelbrotRender::Cancelled() const
+{
+	return state->cancel;
+}
+
+int MandelbrotRender::TilesDone() const
+{
+	return state->done;
+}
+
+int MandelbrotRender::TilesTotal() const
+{
+	return state->total;
+}
+
+bool MandelbrotRender::Done() const
+{
+	std::lock_guard<std::mutex> guard{ state->lock };
+	return state->finished;
+}
+
+bool MandelbrotRender::TileAwaiter::await_ready()
+{
+	std::lock_guard<std::mutex> guard{ state.lock };
+	return !state.ready.empty() || state.finished;
+}
+
+bool MandelbrotRender::TileAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	std::lock_guard<std::mutex> guard{ state.lock };
+	if (!state.ready.empty() || state.finished)
+		return false; // arrived meanwhile, carry on
+	state.tile_waiter = h;
+	return true;
+}
+
+std::optional<MandelbrotTile> MandelbrotRender::TileAwaiter::await_resume()
+{
+	std::lock_guard<std::mutex> guard{ state.lock };
+	if (state.ready.empty())
+		return std::nullopt;
+	MandelbrotTile tile = std::move(state.ready.front());
+	state.ready.pop_front();
+	return tile;
+}
+
+bool MandelbrotRender::FrameAwaiter::await_ready()
+{
+	std::lock_guard<std::mutex> guard{ state.lock };
+	return state.finished;
+}
+
+bool MandelbrotRender::FrameAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	std::lock_guard<std::mutex> guard{ state.lock };
+	if (state.finished)
+		return false;
+	state.frame_waiter = h;
+	return true;
+}
+
+MandelbrotCounts MandelbrotRender::FrameAwaiter::await_resume()
+{
+	std::lock_guard<std::mutex> guard{ state.lock };
+	state.ThrowIfFailed();
+	return state.counts;
+}
+
+namespace {
+
+// holds the state itself, the generator may outlive the render handle
+Generator<MandelbrotTile> TileGenerator(std::shared_ptr<MandelbrotRender::State> state)
+{
+	for (;;)
+	{
+		std::unique_lock<std::mutex> guard{ state->lock };
+		state->changed.wait(guard, [&] { return !state->ready.empty() || state->finished; });
+		if (state->ready.empty())
+			co_return;
+		MandelbrotTile tile = std::move(state->ready.front());
+		state->ready.pop_front();
+		guard.unlock();
+
+		co_yield std::move(tile);
+	}
+}
+
+} // namespace
+
+Generator<MandelbrotTile> MandelbrotRender::Tiles()
+{
+	Subscribe();
+	return TileGenerator(state);
+}
+
+MandelbrotCounts MandelbrotRender::Wait()
+{
+	std::unique_lock<std::mutex> guard{ state->lock };
+	state->changed.wait(guard, [this] { return state->finished; });
+	state->ThrowIfFailed();
+	return state->counts;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "generator.h"
+#include "mandel_algo.h"
+
+// Iteration counts of one finished tile, rows tightly packed
+struct MandelbrotTile {
+	TileRect rect;
+	std::vector<int> counts;
+};
+
+// Handle of a render running in the background on the shared render pool.
+//
+// Tiles come out in the order they finish, either to a coroutine:
+//
+//	while (auto tile = co_await render.NextTile())
+//		Show(*tile);
+//	MandelbrotCounts counts = co_await render;
+//
+// or through the blocking generator Tiles() on a thread of its own. An
+// awaiting coroutine is resumed on the render thread which finished the tile
+// (or the frame), it should hand longer work elsewhere. One coroutine may wait
+// for tiles and one for the frame at a time. Tiles are kept for delivery only
+// from the first NextTile() or Tiles() call on, those finished before are
+// only in the frame; a render nobody takes tiles from holds no copies.
+//
+// When the render fails (memory for the frame or a tile runs out) the tiles
+// not started yet are skipped, the tile stream ends and the exception is
+// thrown again from the frame: co_await render or Wait().
+class MandelbrotRender {
+public:
+	struct State;
+
+	explicit MandelbrotRender(std::shared_ptr<State> s) : state{ std::move(s) } {}
+
+	// Stop computing tiles not started yet; the frame completes early with
+	// those tiles at count 0
+	void Cancel();
+	bool Cancelled() const;
+
+	int TilesDone() const;
+	int TilesTotal() const;
+	double Progress() const { return TilesTotal() ? TilesDone() / static_cast<double>(TilesTotal()) : 1.; }
+	bool Done() const;
+
+	// Next finished tile, nothing once all were delivered
+	auto NextTile()
+	{
+		Subscribe();
+		return TileAwaiter{ *state };
+	}
+
+	// Whole frame, once every tile is done; throws what stopped the render
+	auto operator co_await() { return FrameAwaiter{ *state }; }
+
+	// Blocking variant of NextTile(), for consumers on their own thread
+	Generator<MandelbrotTile> Tiles();
+
+	// Block until the frame is done, throws like co_await
+	MandelbrotCounts Wait();
+
+private:
+	void Subscribe();
+
+	struct TileAwaiter {
+		State& state;
+		bool await_ready();
+		bool await_suspend(std::coroutine_handle<> h);
+		std::optional<MandelbrotTile> await_resume();
+	};
+
+	struct FrameAwaiter {
+		State& state;
+		bool await_ready();
+		bool await_suspend(std::coroutine_handle<> h);
+		MandelbrotCounts await_resume();
+	};
+
+	std::shared_ptr<State> state;
+};
+
+// Start computing the counts of a picture, returns at once
+MandelbrotRender Mandelbrot_RenderAsync(const MandelbrotParams& p, int width, int height,
+	MandelbrotTileCache* cache = nullptr);
@@ -0,0 +1,93 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include "cluster_protocol.h"
+
+namespace {
+// bigger messages are not produced by this protocol, refuse to allocate them
+constexpr std::uint32_t kMaxMessage = 256u << 20;
+}
+
+ClusterJob MakeClusterJob(std::uint64_t id, const MandelbrotParams& p, int width, int height, const TileRect& tile)
+{
+	ClusterJob job{};
+	job.id = id;
+	job.x_start = p.x_start;
+	job.y_start = p.y_start;
+	job.x_range = p.x_range;
+	job.y_range = p.y_range;
+	job.c_re = p.c_re;
+	job.c_im = p.c_im;
+	job.depth = p.depth;
+	job.fractal = static_cast<std::int32_t>(p.fractal);
+	job.power = p.power;
+	job.width = width;
+	job.height = height;
+	job.tile_x = tile.x;
+	job.tile_y = tile.y;
+	job.tile_w = tile.width;
+	job.tile_h = tile.height;
+	return job;
+}
+
+void FromClusterJob(const ClusterJob& job, MandelbrotParams& p, TileRect& tile)
+{
+	p.x_start = job.x_start;
+	p.y_start = job.y_start;
+	p.x_range = job.x_range;
+	p.y_range = job.y_range;
+	p.c_re = job.c_re;
+	p.c_im = job.c_im;
+	p.depth = job.depth;
+	p.fractal = static_cast<Fractal>(job.fractal);
+	p.power = job.power;
+	tile = { job.tile_x, job.tile_y, job.tile_w, job.tile_h };
+}
+
+bool ValidClusterJob(const ClusterJob& job)
+{
+	const auto inside = [](std::int32_t start, std::int32_t size, std::int32_t whole) {
+		return start >= 0 && size > 0 && size <= kClusterMaxTile &&
+			static_cast<std::int64_t>(start) + size <= whole;
+	};
+	return job.width > 0 && job.height > 0 && inside(job.tile_x, job.tile_w, job.width) &&
+		inside(job.tile_y, job.tile_h, job.height) && job.depth > 0 && job.depth < INT32_MAX &&
+		job.fractal >= 0 && job.fractal <= static_cast<std::int32_t>(Fractal::tricorn) &&
+		job.power >= 2 && job.power <= kMaxMultibrotPower && job.x_range > 0 && job.y_range > 0;
+}
+
+bool ClusterSend(const Socket& s, ClusterMessage type, const void* body, size_t size, const void* extra, size_t extra_size)
+{
+	const ClusterHeader header{ kClusterMagic, static_cast<std::uint32_t>(type),
+		static_cast<std::uint32_t>(size + extra_size), 0 };
+	return s.SendAll(&header, sizeof(header)) && s.SendAll(body, size) &&
+		(extra_size == 0 || s.SendAll(extra, extra_size));
+}
+
+bool ClusterReceive(const Socket& s, ClusterMessage& type, std::vector<std::uint8_t>& body)
+{
+	ClusterHeader header;
+	if (!s.ReceiveAll(&header, sizeof(header)) || header.magic != kClusterMagic || header.size > kMaxMessage)
+		return false;
+
+	type = static_cast<ClusterMessage>(header.type);
+	body.resize(header.size);
+	return header.size == 0 || s.ReceiveAll(body.data(), body.size());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "socket.h"
+#include "mandel_algo.h"
+
+// Messages between the render coordinator and workers over TCP.
+//
+// Every message is a ClusterHeader followed by `size` bytes of body. Bodies
+// are sent as the raw structs below, both sides must share byte order (all
+// our render machines are x86-64).
+
+constexpr std::uint32_t kClusterMagic = 0x4D42434C; // "MBCL"
+
+// Largest job tile a worker computes
+constexpr int kClusterMaxTile = 1024;
+
+enum class ClusterMessage : std::uint32_t {
+	job = 1,    // coordinator -> worker: ClusterJob
+	result = 2, // worker -> coordinator: ClusterResult + encoded counts
+};
+
+struct ClusterHeader {
+	std::uint32_t magic;
+	std::uint32_t type;
+	std::uint32_t size;
+	std::uint32_t reserved;
+};
+
+// Compute `tile` of the `width` x `height` picture of the view
+struct ClusterJob {
+	std::uint64_t id;
+	double x_start, y_start, x_range, y_range;
+	double c_re, c_im;
+	std::int32_t depth, width, height;
+	std::int32_t tile_x, tile_y, tile_w, tile_h;
+	std::int32_t fractal, power;
+	std::int32_t reserved;
+};
+
+// Counts of a job, encoded with EncodeCounts() (row deltas, Rice coded)
+struct ClusterResult {
+	std::uint64_t id;
+	std::int32_t tile_w, tile_h;
+};
+
+static_assert(sizeof(ClusterHeader) == 16, "wire format");
+static_assert(sizeof(ClusterJob) == 96, "wire format");
+static_assert(sizeof(ClusterResult) == 16, "wire format");
+
+ClusterJob MakeClusterJob(std::uint64_t id, const MandelbrotParams& p, int width, int height, const TileRect& tile);
+void FromClusterJob(const ClusterJob& job, MandelbrotParams& p, TileRect& tile);
+
+// A job a worker can compute: a tile of at most kClusterMaxTile inside the
+// picture, a positive depth and a known fractal. Anything else comes from a
+// broken or hostile peer.
+bool ValidClusterJob(const ClusterJob& job);
+
+// Send header, `body` and optional `extra` bytes appended to the body
+bool ClusterSend(const Socket& s, ClusterMessage type, const void* body, size_t size,
+	const void* extra = nullptr, size_t extra_size = 0);
+
+// Receive one whole message
+bool ClusterReceive(const Socket& s, ClusterMessage& type, std::vector<std::uint8_t>& body);
@@ -0,0 +1,187 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "coordinator.h"
+#include "cluster_protocol.h"
+#include "count_codec.h"
+#include "debug_output.h"
+
+namespace {
+constexpr int kConnectAttempts = 3;
+}
+
+Coordinator::Coordinator(std::vector<ClusterEndpoint> workers_, int job_tile_size_, int timeout_ms_)
+	: workers{ std::move(workers_) }
+	, job_tile_size{ std::clamp(job_tile_size_, 1, kClusterMaxTile) }
+	, timeout_ms{ timeout_ms_ }
+{
+}
+
+MandelbrotCounts Coordinator::Render(const MandelbrotParams& p, int width, int height, MandelbrotTileCache* cache)
+{
+	MandelbrotCounts result;
+	result.width = width;
+	result.height = height;
+	result.depth = p.depth;
+	result.counts.resize(width * static_cast<size_t>(height));
+
+	std::vector<TileRect> tiles;
+	for (int y = 0; y < height; y += job_tile_size)
+		for (int x = 0; x < width; x += job_tile_size)
+			tiles.push_back({ x, y, std::min(job_tile_size, width - x), std::min(job_tile_size, height - y) });
+
+	stats = {};
+	stats.tiles = static_cast<int>(tiles.size());
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::deque<int> pending;
+	for (int i = 0; i < stats.tiles; i++)
+	{
+		const TileRect& t = tiles[i];
+		if (cache && cache->Load(p, width, height, t, &result.counts[t.y * static_cast<size_t>(width) + t.x], width))
+			stats.cached_tiles++;
+		else
+			pending.push_back(i);
+	}
+	int done = stats.cached_tiles;
+	int alive = static_cast<int>(workers.size());
+
+	// take a tile, or wait while other workers may still give theirs back
+	auto take = [&](int& tile) {
+		std::unique_lock<std::mutex> guard{ lock };
+		changed.wait(guard, [&] { return !pending.empty() || done == stats.tiles; });
+		if (pending.empty())
+			return false;
+		tile = pending.front();
+		pending.pop_front();
+		return true;
+	};
+
+	auto give_back = [&](int tile) {
+		std::lock_guard<std::mutex> guard{ lock };
+		pending.push_front(tile);
+		stats.retries++;
+		changed.notify_all();
+	};
+
+	auto serve = [&](const ClusterEndpoint& endpoint) {
+		std::vector<std::uint8_t> body;
+		for (int attempt = 0; attempt < kConnectAttempts; attempt++)
+		{
+			Socket s = Socket::Connect(endpoint.host, endpoint.port);
+			if (!s)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(200 << attempt));
+				continue;
+			}
+			s.SetReceiveTimeout(timeout_ms);
+
+			int i;
+			while (take(i))
+			{
+				const TileRect& t = tiles[i];
+				const ClusterJob job = MakeClusterJob(i, p, width, height, t);
+
+				ClusterMessage type;
+				ClusterResult r;
+				bool ok = ClusterSend(s, ClusterMessage::job, &job, sizeof(job)) && ClusterReceive(s, type, body) &&
+					type == ClusterMessage::result && body.size() >= sizeof(r);
+				if (ok)
+				{
+					std::memcpy(&r, body.data(), sizeof(r));
+					ok = r.id == static_cast<std::uint64_t>(i) && r.tile_w == t.width && r.tile_h == t.height &&
+						DecodeCounts(body.data() + sizeof(r), body.size() - sizeof(r),
+							&result.counts[t.y * static_cast<size_t>(width) + t.x], t.width, t.height, width, p.depth + 1);
+				}
+
+				if (!ok)
+				{
+					OutputDebugString("worker " + endpoint.host + ":" + std::to_string(endpoint.port) +
+						" lost tile " + std::to_string(i) + "\n");
+					give_back(i);
+					break; // reconnect
+				}
+				if (cache)
+					cache->Save(p, width, height, t, &result.counts[t.y * static_cast<size_t>(width) + t.x], width);
+
+				std::lock_guard<std::mutex> guard{ lock };
+				if (++done == stats.tiles)
+					changed.notify_all();
+			}
+
+			std::lock_guard<std::mutex> guard{ lock };
+			if (done == stats.tiles)
+				break;
+		}
+
+		std::lock_guard<std::mutex> guard{ lock };
+		--alive;
+		changed.notify_all();
+	};
+
+	std::vector<std::thread> threads;
+	for (const auto& w : workers)
+		threads.emplace_back(serve, std::cref(w));
+
+	{
+		std::unique_lock<std::mutex> guard{ lock };
+		changed.wait(guard, [&] { return done == stats.tiles || alive == 0; });
+	}
+
+	// every worker gave up, finish the remaining tiles here
+	for (;;)
+	{
+		int i;
+		{
+			std::lock_guard<std::mutex> guard{ lock };
+			if (pending.empty())
+				break;
+			i = pending.front();
+			pending.pop_front();
+		}
+
+		const TileRect& t = tiles[i];
+		const MandelbrotCounts local = Mandelbrot_Compute(Mandelbrot_SubView(p, width, height, t), t.width, t.height);
+		for (int y = 0; y < t.height; y++)
+			std::copy_n(&local.counts[y * static_cast<size_t>(t.width)], t.width,
+				&result.counts[(t.y + y) * static_cast<size_t>(width) + t.x]);
+		if (cache)
+			cache->Save(p, width, height, t, &result.counts[t.y * static_cast<size_t>(width) + t.x], width);
+
+		std::lock_guard<std::mutex> guard{ lock };
+		stats.local_tiles++;
+		if (++done == stats.tiles)
+			changed.notify_all();
+	}
+
+	for (auto& t : threads)
+		t.join();
+
+	for (const int c : result.counts)
+		result.max = std::max(c, result.max);
+	return result;
+}
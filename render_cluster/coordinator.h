@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mandel_algo.h"
+
+struct ClusterEndpoint {
+	std::string host;
+	std::uint16_t port;
+};
+
+struct ClusterStats {
+	int tiles = 0;        // job tiles of the picture
+	int retries = 0;      // tiles sent again after a worker failed or timed out
+	int local_tiles = 0;  // tiles computed by the coordinator (no worker left)
+	int cached_tiles = 0; // tiles taken from the cache, not computed at all
+};
+
+// Splits a picture into job tiles and has them computed by worker processes.
+//
+// Each worker gets one connection and one job at a time, so faster workers
+// simply take more tiles. A tile whose worker fails or does not answer within
+// the timeout goes back to the queue for another worker; the connection is
+// re-established a few times before the worker is given up. Tiles left when
+// no worker remains are computed locally. With a cache (a RenderCheckpoint
+// of the job, say) only tiles it does not know are sent out, and every tile
+// received is given to it.
+class Coordinator {
+public:
+	explicit Coordinator(std::vector<ClusterEndpoint> workers, int job_tile_size = 256, int timeout_ms = 60000);
+
+	MandelbrotCounts Render(const MandelbrotParams& p, int width, int height, MandelbrotTileCache* cache = nullptr);
+
+	ClusterStats Stats() const { return stats; }
+
+private:
+	std::vector<ClusterEndpoint> workers;
+	int job_tile_size;
+	int timeout_ms;
+	ClusterStats stats;
+};
@@ -0,0 +1,282 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// main_render_cluster.cpp : distributed rendering of large pictures.
+//
+// usage:
+//   render_cluster worker <port> [--public]
+//   render_cluster render <width> <height> <out.png> [<host:port>...] [--view x y x_range y_range] [--depth n]
+//                  [--huge-pages] [--checkpoint dir]
+//   render_cluster pyramid <width> <height> <out_dir> [<host:port>...] [--view x y x_range y_range] [--depth n]
+//   render_cluster shade <in.mbc> <out.png>
+//
+// Rendering to a .mbc file keeps the raw counts (count_file.h), shade turns
+// them into a picture later. pyramid writes every zoom level of the picture
+// as 256x256 tiles, out_dir/<z>/<x>/<y>.png with level 0 the whole picture
+// in one tile. With --checkpoint finished tiles are saved to dir every few
+// seconds (render_checkpoint.h); running the same command again after a
+// crash computes only the tiles which were not saved, and dir is removed
+// once the output is written.
+//
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "socket.h"
+#include "coordinator.h"
+#include "worker.h"
+#include "png_writer.h"
+#include "durable_file.h"
+#include "count_file.h"
+#include "mip_pyramid.h"
+#include "render_checkpoint.h"
+#include "render_pool.h"
+
+namespace {
+
+constexpr int kPyramidTile = 256;
+
+int Usage()
+{
+	std::fprintf(stderr,
+		"usage:\n"
+		"  render_cluster worker <port> [--public]\n"
+		"  render_cluster render <width> <height> <out.png> [<host:port>...] [--view x y x_range y_range] [--depth n]\n"
+		"                 [--huge-pages] [--checkpoint dir]\n"
+		"  render_cluster pyramid <width> <height> <out_dir> [<host:port>...] [--view x y x_range y_range]\n"
+		"                 [--depth n]\n"
+		"  render_cluster shade <in.mbc> <out.png>\n");
+	return 2;
+}
+
+bool IsCountFile(const std::string& path)
+{
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".mbc") == 0;
+}
+
+// The picture of `counts`, stored to disk before it returns true
+bool WritePng(const std::string& path, const MandelbrotCounts& counts)
+{
+	FrameBuffer frame{ counts.width, counts.height, FrameBuffer::FirstTouch{} };
+	Mandelbrot_Shade(counts, MandelbrotPalette{}, frame);
+	const std::string png = EncodePng(frame);
+	return WriteFileDurably(path, png.data(), png.size());
+}
+
+// View, depth and worker options from argv[first] on, --checkpoint only where
+// `checkpoint` is given
+bool ParseOptions(int argc, char* argv[], int first, MandelbrotParams& p, std::vector<ClusterEndpoint>& workers,
+	std::string* checkpoint = nullptr)
+{
+	for (int i = first; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--view") == 0 && i + 4 < argc)
+		{
+			p.x_start = std::atof(argv[++i]);
+			p.y_start = std::atof(argv[++i]);
+			p.x_range = std::atof(argv[++i]);
+			p.y_range = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+			p.depth = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--huge-pages") == 0)
+			UseHugePages(true);
+		else if (std::strcmp(argv[i], "--checkpoint") == 0 && checkpoint && i + 1 < argc)
+			*checkpoint = argv[++i];
+		else
+		{
+			const std::string address = argv[i];
+			const auto colon = address.rfind(':');
+			if (colon == std::string::npos)
+				return false;
+			workers.push_back({ address.substr(0, colon), static_cast<std::uint16_t>(std::atoi(address.c_str() + colon + 1)) });
+		}
+	}
+	return true;
+}
+
+int Render(int argc, char* argv[])
+{
+	if (argc < 5)
+		return Usage();
+
+	const int width = std::atoi(argv[2]);
+	const int height = std::atoi(argv[3]);
+	const std::string out = argv[4];
+
+	MandelbrotParams p;
+	std::vector<ClusterEndpoint> workers;
+	std::string checkpoint_dir;
+	if (!ParseOptions(argc, argv, 5, p, workers, &checkpoint_dir))
+		return Usage();
+	if (width <= 0 || height <= 0)
+		return Usage();
+
+	RenderCheckpoint checkpoint;
+	if (!checkpoint_dir.empty() && !checkpoint.Open(checkpoint_dir, p, width, height))
+	{
+		std::fprintf(stderr, "cannot write checkpoint to %s\n", checkpoint_dir.c_str());
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	Coordinator coordinator{ workers };
+	const MandelbrotCounts counts = coordinator.Render(p, width, height, checkpoint_dir.empty() ? nullptr : &checkpoint);
+	const auto computed = std::chrono::steady_clock::now();
+	// the tiles would be computed again if the output cannot be written
+	if (!checkpoint_dir.empty() && !checkpoint.Flush())
+		std::fprintf(stderr, "cannot write checkpoint to %s\n", checkpoint_dir.c_str());
+
+	if (!(IsCountFile(out) ? Mandelbrot_SaveCounts(out, p, counts) : WritePng(out, counts)))
+	{
+		std::fprintf(stderr, "cannot write %s\n", out.c_str());
+		return 1;
+	}
+	if (!checkpoint_dir.empty())
+		checkpoint.Remove();
+
+	const auto s = coordinator.Stats();
+	std::printf("%d tiles on %zu workers, %d retried, %d computed locally, %d resumed, %lld ms\n", s.tiles,
+		workers.size(), s.retries, s.local_tiles, s.cached_tiles,
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(computed - start).count()));
+	return 0;
+}
+
+// Render in bands of one tile row and stream them through the pyramid, so
+// memory does not grow with the height of the picture
+int Pyramid(int argc, char* argv[])
+{
+	if (argc < 5)
+		return Usage();
+
+	const int width = std::atoi(argv[2]);
+	const int height = std::atoi(argv[3]);
+	const std::filesystem::path out = argv[4];
+
+	MandelbrotParams p;
+	std::vector<ClusterEndpoint> workers;
+	if (!ParseOptions(argc, argv, 5, p, workers) || width <= 0 || height <= 0)
+		return Usage();
+
+	// a histogram palette would need the counts of the whole picture
+	MandelbrotPalette palette;
+	palette.mode = MandelbrotPalette::Mode::cyclic;
+
+	struct Tile {
+		int level, column, row;
+		FrameBuffer pixels;
+	};
+	std::vector<Tile> finished;
+	MipPyramid pyramid{ width, height, kPyramidTile, [&](int level, int column, int row, const FrameBuffer& tile) {
+		finished.push_back({ level, column, row, tile });
+	} };
+	const int levels = pyramid.Levels();
+
+	const auto start = std::chrono::steady_clock::now();
+	Coordinator coordinator{ workers };
+	int tiles = 0;
+	std::atomic<bool> failed{ false };
+	for (int y = 0; y < height; y += kPyramidTile)
+	{
+		const TileRect band{ 0, y, width, std::min(kPyramidTile, height - y) };
+		const MandelbrotCounts counts = coordinator.Render(Mandelbrot_SubView(p, width, height, band), band.width, band.height);
+		FrameBuffer frame{ band.width, band.height, FrameBuffer::FirstTouch{} };
+		Mandelbrot_Shade(counts, palette, frame);
+		pyramid.AddRows(frame);
+
+		// PNG encoding costs about as much as a shallow render, tiles of a band are independent
+		SharedRenderPool().ParallelFor(static_cast<int>(finished.size()), [&](int i) {
+			const Tile& t = finished[i];
+			const auto dir = out / std::to_string(levels - 1 - t.level) / std::to_string(t.column);
+			std::error_code ignored; // another thread may be creating it
+			std::filesystem::create_directories(dir, ignored);
+			std::ofstream file{ dir / (std::to_string(t.row) + ".png"), std::ios::binary };
+			file << EncodePng(t.pixels);
+			file.close();
+			if (!file)
+				failed = true;
+		});
+		if (failed)
+		{
+			std::fprintf(stderr, "cannot write tiles to %s\n", out.string().c_str());
+			return 1;
+		}
+		tiles += static_cast<int>(finished.size());
+		finished.clear();
+	}
+
+	std::printf("%d levels, %d tiles, %lld ms\n", levels, tiles,
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count()));
+	return 0;
+}
+
+int Shade(int argc, char* argv[])
+{
+	if (argc != 4)
+		return Usage();
+
+	MandelbrotParams p;
+	MandelbrotCounts counts;
+	if (!Mandelbrot_LoadCounts(argv[2], p, counts))
+	{
+		std::fprintf(stderr, "cannot read %s\n", argv[2]);
+		return 1;
+	}
+	if (!WritePng(argv[3], counts))
+	{
+		std::fprintf(stderr, "cannot write %s\n", argv[3]);
+		return 1;
+	}
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	SocketLibrary sockets;
+
+	if (argc >= 3 && std::strcmp(argv[1], "worker") == 0)
+	{
+		const bool loopback_only = !(argc >= 4 && std::strcmp(argv[3], "--public") == 0);
+		if (!RunClusterWorker(static_cast<std::uint16_t>(std::atoi(argv[2])), loopback_only))
+		{
+			std::fprintf(stderr, "cannot listen on port %s\n", argv[2]);
+			return 1;
+		}
+		return 0;
+	}
+
+	if (argc >= 2 && std::strcmp(argv[1], "render") == 0)
+		return Render(argc, argv);
+
+	if (argc >= 2 && std::strcmp(argv[1], "pyramid") == 0)
+		return Pyramid(argc, argv);
+
+	if (argc >= 2 && std::strcmp(argv[1], "shade") == 0)
+		return Shade(argc, argv);
+
+	return Usage();
+}
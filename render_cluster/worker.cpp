@@ -0,0 +1,88 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <cstring>
+#include <thread>
+#include "worker.h"
+#include "cluster_protocol.h"
+#include "count_codec.h"
+#include "debug_output.h"
+
+namespace {
+
+void ServeCoordinator(Socket s)
+{
+	std::vector<std::uint8_t> body;
+	ClusterMessage type;
+	while (ClusterReceive(s, type, body))
+	{
+		if (type != ClusterMessage::job || body.size() != sizeof(ClusterJob))
+			return;
+
+		ClusterJob job;
+		std::memcpy(&job, body.data(), sizeof(job));
+		if (!ValidClusterJob(job))
+		{
+			OutputDebugString("invalid job, dropping the connection\n");
+			return;
+		}
+
+		MandelbrotParams p;
+		TileRect tile;
+		FromClusterJob(job, p, tile);
+		const MandelbrotCounts counts = Mandelbrot_Compute(Mandelbrot_SubView(p, job.width, job.height, tile),
+			tile.width, tile.height);
+
+		const auto encoded = EncodeCounts(counts.counts.data(), tile.width, tile.height, tile.width);
+		const ClusterResult result{ job.id, tile.width, tile.height };
+		if (!ClusterSend(s, ClusterMessage::result, &result, sizeof(result), encoded.data(), encoded.size()))
+			return;
+	}
+}
+
+} // namespace
+
+void ServeClusterConnection(Socket s)
+{
+	// out of memory or any other failure ends this connection, not the worker
+	try
+	{
+		ServeCoordinator(std::move(s));
+	}
+	catch (...)
+	{
+		OutputDebugString("job failed, dropping the connection\n");
+	}
+}
+
+bool RunClusterWorker(std::uint16_t port, bool loopback_only)
+{
+	Socket listener = Socket::Listen(port, loopback_only);
+	if (!listener)
+		return false;
+
+	OutputDebugString("worker listening on port " + std::to_string(listener.LocalPort()) + "\n");
+	for (;;)
+	{
+		Socket s = listener.Accept();
+		if (s)
+			std::thread{ ServeClusterConnection, std::move(s) }.detach();
+	}
+}
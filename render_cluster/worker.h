@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include "socket.h"
+
+// Serve render jobs of coordinators connecting to `port` until the process is
+// stopped. Each connection is served by its own thread, jobs are computed on
+// the shared render pool.
+//
+// @returns false if the port cannot be opened
+bool RunClusterWorker(std::uint16_t port, bool loopback_only);
+
+// Serve the jobs of one coordinator connection until it is closed or sends
+// something invalid, for callers accepting the connections themselves.
+// Failures (out of memory) end the connection only.
+void ServeClusterConnection(Socket s);
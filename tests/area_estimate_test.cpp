@@ -0,0 +1,104 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the area estimate of the Mandelbrot set
+
+#include <cmath>
+#include <cstdint>
+#include "test.h"
+#include "area_estimate.h"
+
+namespace {
+
+// Whole set, at a depth where the estimate is close to the true area
+MandelbrotParams WholeSet()
+{
+	MandelbrotParams p;
+	p.x_start = -2;
+	p.y_start = -1.25;
+	p.x_range = 2.5;
+	p.y_range = 2.5;
+	p.depth = 2000;
+	return p;
+}
+
+// Upper bound of the area at depth 2000, from 2^27 samples (error 0.00005)
+constexpr double kReferenceArea = 1.5084;
+
+}
+
+TEST(AreaEstimateWholeSet)
+{
+	MandelbrotAreaOptions options;
+	options.max_samples = 1 << 22;
+	options.seed = 7;
+	const MandelbrotAreaEstimate e = Mandelbrot_EstimateArea(WholeSet(), options);
+	CHECK(e.samples == options.max_samples);
+	CHECK(e.area_error > 0 && e.area_error < 0.01);
+	CHECK(std::abs(e.area - kReferenceArea) <= e.area_error);
+	CHECK(e.area == e.fraction * 2.5 * 2.5 && e.inside <= e.samples);
+
+	// the seed alone decides the result
+	const MandelbrotAreaEstimate again = Mandelbrot_EstimateArea(WholeSet(), options);
+	CHECK(again.inside == e.inside && again.area == e.area);
+}
+
+TEST(AreaEstimateStopsEarly)
+{
+	MandelbrotAreaOptions options;
+	options.max_samples = 1 << 24;
+	options.target_error = 0.005;
+	const MandelbrotAreaEstimate e = Mandelbrot_EstimateArea(WholeSet(), options);
+	CHECK(e.samples > 0 && e.samples < options.max_samples);
+	CHECK(e.area_error <= options.target_error);
+	CHECK(std::abs(e.area - kReferenceArea) <= e.area_error);
+
+	// progress sees every round, the first one declines the rest
+	options.target_error = 0;
+	int rounds = 0;
+	std::uint64_t reported = 0;
+	const MandelbrotAreaEstimate first = Mandelbrot_EstimateArea(WholeSet(), options,
+		[&](const MandelbrotAreaEstimate& round) {
+			rounds++;
+			reported = round.samples;
+			return false;
+		});
+	CHECK(rounds == 1);
+	CHECK(first.samples == reported && first.samples < options.max_samples);
+
+	int more = 0;
+	std::uint64_t last = 0;
+	bool growing = true;
+	Mandelbrot_EstimateArea(WholeSet(), options, [&](const MandelbrotAreaEstimate& round) {
+		growing = growing && round.samples > last;
+		last = round.samples;
+		return ++more < 3;
+		});
+	CHECK(more == 3 && growing);
+}
+
+TEST(AreaEstimateMandelbrotOnly)
+{
+	MandelbrotParams p = WholeSet();
+	p.fractal = Fractal::tricorn;
+	const MandelbrotAreaEstimate e = Mandelbrot_EstimateArea(p);
+	CHECK(e.samples == 0 && e.area == 0);
+}
@@ -0,0 +1,57 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the orbit density renderer
+
+#include <atomic>
+#include "test.h"
+#include "buddhabrot.h"
+
+namespace {
+
+BuddhabrotParams Small()
+{
+	BuddhabrotParams p;
+	p.view.x_start = -2;
+	p.view.y_start = -1.5;
+	p.view.x_range = 3;
+	p.view.y_range = 3;
+	p.samples = 200'000;
+	return p;
+}
+
+} // namespace
+
+TEST(BuddhabrotIsRepeatable)
+{
+	const BuddhabrotDensity a = Buddhabrot_Compute(Small(), 90, 90);
+	CHECK(a.max[0] > 0 && a.max[1] > 0 && a.max[2] > 0);
+	const BuddhabrotDensity b = Buddhabrot_Compute(Small(), 90, 90);
+	for (int ch = 0; ch < 3; ch++)
+		CHECK(a.channel[ch] == b.channel[ch]);
+}
+
+TEST(BuddhabrotStopsWhenCancelled)
+{
+	const std::atomic<bool> cancel{ true };
+	const BuddhabrotDensity d = Buddhabrot_Compute(Small(), 90, 90, &cancel);
+	CHECK(d.max[0] == 0 && d.max[1] == 0 && d.max[2] == 0);
+}
@@ -0,0 +1,138 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of a render split between worker connections on localhost
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "socket.h"
+#include "coordinator.h"
+#include "worker.h"
+
+namespace {
+
+// Worker on a free localhost port, serving until it goes out of scope
+class LocalWorker {
+public:
+	LocalWorker() : listener{ Socket::Listen(0, true) }
+	{
+		accepting = std::thread{ [this] {
+			for (;;)
+			{
+				Socket s = listener.Accept();
+				if (stopping)
+					return;
+				if (s)
+					serving.emplace_back(ServeClusterConnection, std::move(s));
+			}
+			} };
+	}
+
+	~LocalWorker()
+	{
+		// wake Accept with a connection of our own
+		stopping = true;
+		Socket::Connect("127.0.0.1", Port());
+		accepting.join();
+
+		// connections end when the coordinator closes them
+		for (auto& t : serving)
+			t.join();
+	}
+
+	std::uint16_t Port() const { return listener.LocalPort(); }
+
+private:
+	Socket listener;
+	std::atomic<bool> stopping{ false };
+	std::thread accepting;
+	std::vector<std::thread> serving; // accepting thread only, until joined
+};
+
+// Endpoint nobody listens on: a port which was free a moment ago
+std::uint16_t ClosedPort()
+{
+	return Socket::Listen(0, true).LocalPort();
+}
+
+MandelbrotParams Job()
+{
+	MandelbrotParams p;
+	p.x_start = -0.75;
+	p.y_start = 0.05;
+	p.x_range = 0.06;
+	p.y_range = 0.04;
+	p.depth = 1500;
+	return p;
+}
+
+// The picture as the job tiles compute it: each from its own sub-view, whose
+// coordinates may round differently from those of the whole picture
+std::vector<int, LargeAllocator<int>> TileByTile(const MandelbrotParams& p, int width, int height, int tile_size)
+{
+	std::vector<int, LargeAllocator<int>> counts(width * static_cast<size_t>(height));
+	for (int y = 0; y < height; y += tile_size)
+		for (int x = 0; x < width; x += tile_size)
+		{
+			const TileRect t{ x, y, std::min(tile_size, width - x), std::min(tile_size, height - y) };
+			Mandelbrot_ComputeInto(Mandelbrot_SubView(p, width, height, t), t.width, t.height,
+				&counts[t.y * static_cast<size_t>(width) + t.x], width);
+		}
+	return counts;
+}
+
+} // namespace
+
+TEST(ClusterSplitsRenderBetweenWorkers)
+{
+	constexpr int kWidth = 640, kHeight = 480;
+	LocalWorker a, b, c;
+	Coordinator coordinator{ { { "127.0.0.1", a.Port() }, { "127.0.0.1", b.Port() }, { "127.0.0.1", c.Port() } }, 128, 20000 };
+
+	const MandelbrotCounts counts = coordinator.Render(Job(), kWidth, kHeight);
+	const ClusterStats stats = coordinator.Stats();
+	CHECK(stats.tiles == 5 * 4);
+	CHECK(stats.local_tiles == 0 && stats.retries == 0);
+	CHECK(counts.counts == TileByTile(Job(), kWidth, kHeight, 128));
+}
+
+TEST(ClusterGoesOnWithoutFailedWorker)
+{
+	constexpr int kWidth = 300, kHeight = 200;
+	LocalWorker a;
+	Coordinator coordinator{ { { "127.0.0.1", ClosedPort() }, { "127.0.0.1", a.Port() } }, 64, 20000 };
+
+	const MandelbrotCounts counts = coordinator.Render(Job(), kWidth, kHeight);
+	CHECK(coordinator.Stats().local_tiles == 0);
+	CHECK(counts.counts == TileByTile(Job(), kWidth, kHeight, 64));
+}
+
+TEST(ClusterRendersLocallyWithoutWorkers)
+{
+	constexpr int kWidth = 200, kHeight = 100;
+	Coordinator coordinator{ { { "127.0.0.1", ClosedPort() } }, 64, 20000 };
+
+	const MandelbrotCounts counts = coordinator.Render(Job(), kWidth, kHeight);
+	CHECK(coordinator.Stats().local_tiles == coordinator.Stats().tiles);
+	CHECK(counts.counts == TileByTile(Job(), kWidth, kHeight, 64));
+}
@@ -0,0 +1,92 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the count coding shared by the cluster, archives and checkpoints
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "test.h"
+#include "count_codec.h"
+#include "mandel_algo.h"
+
+TEST(CountCodecRoundTrip)
+{
+	// a real picture: flat inside, bands and noise near the boundary
+	MandelbrotParams p;
+	const MandelbrotCounts counts = Mandelbrot_Compute(p, 97, 61);
+	const auto coded = EncodeCounts(counts.counts.data(), counts.width, counts.height, counts.width);
+	CHECK(coded.size() < counts.counts.size() * sizeof(int));
+
+	std::vector<int> decoded(counts.counts.size());
+	CHECK(DecodeCounts(coded.data(), coded.size(), decoded.data(), counts.width, counts.height, counts.width, p.depth + 1));
+	CHECK(std::equal(decoded.begin(), decoded.end(), counts.counts.begin()));
+}
+
+TEST(CountCodecRoundTripWithStride)
+{
+	std::mt19937 random{ 1 };
+	const int width = 33, height = 17, stride = 40, depth = 5000;
+	std::vector<int> counts(stride * height, -1);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			counts[y * stride + x] = static_cast<int>(random() % (depth + 2));
+
+	const auto coded = EncodeCounts(counts.data(), width, height, stride);
+	std::vector<int> decoded(stride * height, -1);
+	CHECK(DecodeCounts(coded.data(), coded.size(), decoded.data(), width, height, stride, depth + 1));
+	CHECK(decoded == counts); // padding untouched
+}
+
+TEST(CountCodecRejectsCountsOutOfRange)
+{
+	const int width = 16, height = 8;
+	std::vector<int> counts(width * height, 10);
+	counts[37] = 300;
+	const auto coded = EncodeCounts(counts.data(), width, height, width);
+
+	std::vector<int> decoded(counts.size());
+	CHECK(DecodeCounts(coded.data(), coded.size(), decoded.data(), width, height, width, 300));
+	CHECK(!DecodeCounts(coded.data(), coded.size(), decoded.data(), width, height, width, 299));
+}
+
+TEST(CountCodecRejectsDamagedData)
+{
+	MandelbrotParams p;
+	const MandelbrotCounts counts = Mandelbrot_Compute(p, 64, 64);
+	const auto coded = EncodeCounts(counts.counts.data(), counts.width, counts.height, counts.width);
+	std::vector<int> decoded(counts.counts.size());
+
+	// too short, and a size which does not match the data
+	CHECK(!DecodeCounts(coded.data(), coded.size() / 2, decoded.data(), 64, 64, 64, p.depth + 1));
+	CHECK(!DecodeCounts(coded.data(), coded.size(), decoded.data(), 64, 128, 64, p.depth + 1));
+
+	// flipped bits decode to garbage or fail, but never outside the range
+	std::mt19937 random{ 2 };
+	for (int i = 0; i < 200; i++)
+	{
+		auto damaged = coded;
+		damaged[random() % damaged.size()] ^= static_cast<std::uint8_t>(1 << (random() % 8));
+		if (DecodeCounts(damaged.data(), damaged.size(), decoded.data(), 64, 64, 64, p.depth + 1))
+			for (const int c : decoded)
+				CHECK(c >= 0 && c <= p.depth + 1);
+	}
+}
@@ -0,0 +1,87 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the count archive
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "count_file.h"
+
+namespace {
+
+// Picture of two tiles by two, the right and bottom ones partial
+MandelbrotCounts Picture(MandelbrotParams& p)
+{
+	p.x_start = -0.9;
+	p.y_start = -0.3;
+	p.x_range = 0.4;
+	p.y_range = 0.3;
+	return Mandelbrot_Compute(p, kCountFileTile + 61, kCountFileTile + 17);
+}
+
+} // namespace
+
+TEST(CountFileRoundTrip)
+{
+	const std::string path = TestDirectory("count_file") + "/picture.mbc";
+	MandelbrotParams p;
+	const MandelbrotCounts counts = Picture(p);
+	CHECK(Mandelbrot_SaveCounts(path, p, counts));
+	CHECK(!std::filesystem::exists(path + ".tmp"));
+
+	MandelbrotParams loaded_view;
+	MandelbrotCounts loaded;
+	CHECK(Mandelbrot_LoadCounts(path, loaded_view, loaded));
+	CHECK(loaded.width == counts.width && loaded.height == counts.height && loaded.max == counts.max);
+	CHECK(loaded.counts == counts.counts);
+	CHECK(loaded_view.x_start == p.x_start && loaded_view.y_range == p.y_range && loaded_view.depth == p.depth);
+
+	// one tile on its own
+	CountFile file;
+	CHECK(file.Open(path));
+	CHECK(file.Tiles() == 4);
+	const TileRect t = file.Tile(3);
+	CHECK(t.x == kCountFileTile && t.y == kCountFileTile && t.width == 61 && t.height == 17);
+	std::vector<int> tile(t.width * t.height);
+	CHECK(file.Decode(3, tile.data(), t.width));
+	for (int y = 0; y < t.height; y++)
+		for (int x = 0; x < t.width; x++)
+			CHECK(tile[y * t.width + x] == counts.At(t.x + x, t.y + y));
+}
+
+TEST(CountFileRejectsDamagedFiles)
+{
+	const std::string dir = TestDirectory("count_file_damaged");
+	MandelbrotParams p;
+	MandelbrotCounts counts;
+	CHECK(!Mandelbrot_LoadCounts(dir + "/missing.mbc", p, counts));
+	CHECK(!std::filesystem::exists(dir + "/missing.mbc")); // not created by the attempt
+
+	const std::string path = dir + "/picture.mbc";
+	CHECK(Mandelbrot_SaveCounts(path, p, Picture(p)));
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+	CHECK(!Mandelbrot_LoadCounts(path, p, counts));
+
+	std::filesystem::resize_file(path, 0);
+	CHECK(!Mandelbrot_LoadCounts(path, p, counts));
+}
@@ -0,0 +1,86 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the interactive frame latency budget
+
+#include "test.h"
+#include "frame_governor.h"
+
+namespace {
+
+constexpr int kWidth = 400, kHeight = 300;
+constexpr double kPixels = kWidth * kHeight;
+
+}
+
+TEST(FrameGovernorFullFrameUntilMeasured)
+{
+	FrameGovernor governor{ 50 };
+	CHECK(governor.PredictMs(kWidth, kHeight, 1000) == 0);
+	const MandelbrotPreview plan = governor.Plan(kWidth, kHeight, 1000);
+	CHECK(plan.scale == 1 && plan.depth == 1000);
+
+	// a frame computing nothing teaches nothing
+	governor.Record(0, 1000, 500);
+	CHECK(governor.Plan(kWidth, kHeight, 1000).scale == 1);
+}
+
+TEST(FrameGovernorScalesDownAfterExpensiveFrame)
+{
+	FrameGovernor governor{ 50 };
+	governor.Record(kPixels, 1000, 10);
+	CHECK(governor.Plan(kWidth, kHeight, 1000).scale == 1);
+
+	// 120 ms: a quarter of the pixels fits
+	governor.Record(kPixels, 1000, 120);
+	MandelbrotPreview plan = governor.Plan(kWidth, kHeight, 1000);
+	CHECK(plan.scale == 2 && plan.depth == 1000);
+	CHECK(governor.PredictMs(kWidth / 2, kHeight / 2, 1000) <= governor.Budget());
+
+	// twice the depth, twice the cost
+	CHECK(governor.PredictMs(kWidth, kHeight, 2000) == 2 * governor.PredictMs(kWidth, kHeight, 1000));
+	CHECK(governor.Plan(kWidth, kHeight, 2000).scale == 4);
+
+	// even the coarsest picture is too slow, depth goes down too
+	governor.Record(kPixels, 1000, 10000);
+	plan = governor.Plan(kWidth, kHeight, 1000);
+	CHECK(plan.scale == FrameGovernor::kMaxPreviewScale);
+	CHECK(plan.depth == 250);
+
+	// never below the minimum depth
+	governor.Record(kPixels, 1000, 1e6);
+	plan = governor.Plan(kWidth, kHeight, 1000);
+	CHECK(plan.depth >= FrameGovernor::kMinPreviewDepth && plan.depth < 2 * FrameGovernor::kMinPreviewDepth);
+
+	// a cheap frame brings the full quality back
+	governor.Record(kPixels, 1000, 5);
+	CHECK(governor.Plan(kWidth, kHeight, 1000).scale == 1);
+}
+
+TEST(FrameGovernorFollowsBudget)
+{
+	FrameGovernor governor{ 50 };
+	governor.Record(kPixels, 1000, 120);
+	CHECK(governor.Plan(kWidth, kHeight, 1000).scale == 2);
+	governor.SetBudget(200);
+	CHECK(governor.Budget() == 200);
+	CHECK(governor.Plan(kWidth, kHeight, 1000).scale == 1);
+}
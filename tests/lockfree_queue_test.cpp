@@ -0,0 +1,77 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the queue handing tiles from render threads to the UI thread
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "lockfree_queue.h"
+
+TEST(LockFreeQueueFullAndEmpty)
+{
+	LockFreeQueue<int, 4> queue;
+	int popped = -1;
+	CHECK(!queue.TryPop([&](int& v) { popped = v; }));
+
+	for (int i = 0; i < 4; i++)
+		CHECK(queue.TryPush([i](int& v) { v = i; }));
+	CHECK(!queue.TryPush([](int& v) { v = 99; }));
+
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(queue.TryPop([&](int& v) { popped = v; }));
+		CHECK(popped == i);
+	}
+	CHECK(!queue.TryPop([&](int& v) { popped = v; }));
+}
+
+TEST(LockFreeQueueManyProducersAndConsumers)
+{
+	constexpr int kThreads = 4;
+	constexpr int kItems = 20000;
+	LockFreeQueue<int, 64> queue;
+	std::atomic<std::int64_t> sum{ 0 };
+	std::atomic<int> received{ 0 };
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < kThreads; t++)
+	{
+		threads.emplace_back([&queue, t] {
+			for (int i = 1; i <= kItems; i++)
+				while (!queue.TryPush([&](int& v) { v = t * kItems + i; }))
+					std::this_thread::yield();
+			});
+		threads.emplace_back([&] {
+			while (received < kThreads * kItems)
+				if (!queue.TryPop([&](int& v) { sum += v; received++; }))
+					std::this_thread::yield();
+			});
+	}
+	for (auto& t : threads)
+		t.join();
+
+	// every value exactly once
+	const std::int64_t n = kThreads * kItems;
+	CHECK(received == n);
+	CHECK(sum == n * (n + 1) / 2);
+}
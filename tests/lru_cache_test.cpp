@@ -0,0 +1,85 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the tile cache of the tile server
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "lru_cache.h"
+
+TEST(LruCacheCoalescesMisses)
+{
+	LruCache<int, int> cache{ 100, [](const int&) { return std::size_t{ 1 }; } };
+	std::atomic<int> creates{ 0 };
+
+	std::vector<std::thread> threads;
+	std::vector<std::shared_ptr<const int>> values(8);
+	for (size_t i = 0; i < values.size(); i++)
+		threads.emplace_back([&, i] {
+			values[i] = cache.GetOrCreate(1, [&] {
+				creates++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				return std::make_shared<const int>(42);
+				});
+			});
+	for (auto& t : threads)
+		t.join();
+
+	CHECK(creates == 1);
+	for (const auto& v : values)
+		CHECK(v == values[0] && *v == 42);
+	const auto stats = cache.GetStats();
+	CHECK(stats.misses == 1);
+	CHECK(stats.coalesced + stats.hits == values.size() - 1);
+}
+
+TEST(LruCacheFailedCreateIsNotCached)
+{
+	LruCache<int, int> cache{ 100, [](const int&) { return std::size_t{ 1 }; } };
+	bool thrown = false;
+	try
+	{
+		cache.GetOrCreate(1, []() -> std::shared_ptr<const int> { throw std::runtime_error{ "no" }; });
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK(cache.Find(1) == nullptr);
+	CHECK(*cache.GetOrCreate(1, [] { return std::make_shared<const int>(5); }) == 5);
+}
+
+TEST(LruCacheEvictsLeastRecentlyUsed)
+{
+	LruCache<int, int> cache{ 3, [](const int&) { return std::size_t{ 1 }; } };
+	for (int i = 0; i < 3; i++)
+		cache.Insert(i, std::make_shared<const int>(i));
+	CHECK(cache.Find(0) != nullptr); // 1 is now the oldest
+	cache.Insert(3, std::make_shared<const int>(3));
+	CHECK(cache.Find(1) == nullptr);
+	CHECK(cache.Find(0) != nullptr && cache.Find(2) != nullptr && cache.Find(3) != nullptr);
+	CHECK(cache.GetStats().cost == 3);
+}
@@ -0,0 +1,322 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the compute and shade stages
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "test.h"
+#include "mandel_algo.h"
+
+namespace {
+
+// part of the boundary, every count from 1 to inside present
+MandelbrotParams Seahorses()
+{
+	MandelbrotParams p;
+	p.x_start = -0.8;
+	p.y_start = -0.2;
+	p.x_range = 0.15;
+	p.y_range = 0.1;
+	p.depth = 500;
+	return p;
+}
+
+// Count of one point by the textbook loop of each formula
+int ReferenceCount(const MandelbrotParams& p, double px, double py)
+{
+	double zx = 0, zy = 0, cx = px, cy = py;
+	if (p.fractal == Fractal::julia)
+	{
+		zx = px;
+		zy = py;
+		cx = p.c_re;
+		cy = p.c_im;
+	}
+	for (int n = 0; n < p.depth; n++)
+	{
+		if (zx * zx + zy * zy > 4)
+			return n;
+		double x = zx, y = zy;
+		switch (p.fractal)
+		{
+		case Fractal::multibrot:
+			for (int k = 1; k < p.power; k++)
+			{
+				const double t = x * zx - y * zy;
+				y = x * zy + y * zx;
+				x = t;
+			}
+			break;
+		case Fractal::burning_ship:
+			x = std::abs(zx);
+			y = std::abs(zy);
+			[[fallthrough]];
+		default:
+			{
+				const double t = x * x - y * y;
+				y = (p.fractal == Fractal::tricorn ? -2 : 2) * x * y;
+				x = t;
+			}
+		}
+		zx = x + cx;
+		zy = y + cy;
+	}
+	return zx * zx + zy * zy > 4 ? p.depth : p.depth + 1;
+}
+
+// Pixels whose counts differ
+int Differing(const MandelbrotCounts& a, const MandelbrotCounts& b)
+{
+	int differ = 0;
+	for (size_t i = 0; i < a.counts.size(); i++)
+		differ += a.counts[i] != b.counts[i];
+	return differ;
+}
+
+} // namespace
+
+TEST(ShadeVariantsAgree)
+{
+	const MandelbrotCounts counts = Mandelbrot_Compute(Seahorses(), 97, 61);
+	for (const auto mode : { MandelbrotPalette::Mode::histogram, MandelbrotPalette::Mode::cyclic })
+	{
+		MandelbrotPalette palette;
+		palette.mode = mode;
+		FrameBuffer frame{ counts.width, counts.height };
+		Mandelbrot_Shade(counts, palette, frame);
+
+		// into a buffer with padding, and pixel by pixel
+		const int stride = counts.width + 3;
+		std::vector<FrameBuffer::Colour> padded(stride * static_cast<size_t>(counts.height), 0);
+		Mandelbrot_Shade(counts, palette, padded.data(), stride);
+		FrameBuffer called{ counts.width, counts.height };
+		Mandelbrot_Shade(counts, palette, [&called](int x, int y, const Image::Colour& c) { called.Pixel(x, y, c); });
+
+		for (int y = 0; y < counts.height; y++)
+			for (int x = 0; x < counts.width; x++)
+			{
+				CHECK(padded[y * static_cast<size_t>(stride) + x] == frame.Pixel(x, y));
+				CHECK(called.Pixel(x, y) == frame.Pixel(x, y));
+			}
+		for (int y = 0; y < counts.height; y++)
+			for (int x = counts.width; x < stride; x++)
+				CHECK(padded[y * static_cast<size_t>(stride) + x] == 0);
+	}
+}
+
+TEST(ShadeRecoloursWithoutComputing)
+{
+	// the cyclic palette is final tile by tile, a shade of the whole frame
+	// must agree with it
+	const MandelbrotParams p = Seahorses();
+	const MandelbrotCounts counts = Mandelbrot_Compute(p, 80, 60);
+	MandelbrotPalette palette;
+	palette.mode = MandelbrotPalette::Mode::cyclic;
+	palette.cycle = 40;
+	FrameBuffer frame{ counts.width, counts.height };
+	Mandelbrot_Shade(counts, palette, frame);
+	for (int y = 0; y < counts.height; y++)
+		for (int x = 0; x < counts.width; x++)
+			CHECK(frame.Pixel(x, y) == FrameBuffer::Pack(Mandelbrot_PartialColour(counts.At(x, y), p.depth, palette)));
+
+	// both stages in one call shade with the default palette
+	FrameBuffer image{ counts.width, counts.height };
+	Mandelbrot_Image(p, counts.width, counts.height, [&image](int x, int y, const Image::Colour& c) { image.Pixel(x, y, c); });
+	Mandelbrot_Shade(counts, MandelbrotPalette{}, frame);
+	for (int y = 0; y < counts.height; y++)
+		for (int x = 0; x < counts.width; x++)
+			CHECK(image.Pixel(x, y) == frame.Pixel(x, y));
+}
+
+TEST(FormulasMatchReference)
+{
+	const int width = 120, height = 90;
+	MandelbrotParams p;
+	p.x_start = -2.2;
+	p.y_start = -1.6;
+	p.x_range = 3.6;
+	p.y_range = 2.7;
+	p.depth = 300;
+	for (const Fractal fractal : { Fractal::mandelbrot, Fractal::julia, Fractal::multibrot, Fractal::burning_ship,
+		Fractal::tricorn })
+	{
+		p.fractal = fractal;
+		const MandelbrotCounts counts = Mandelbrot_Compute(p, width, height);
+		const double stepx = p.x_range / width, stepy = p.y_range / height;
+
+		// points next to the boundary may go either way with other rounding
+		// of the compiled kernels (fused multiply-add)
+		int differ = 0;
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				differ += counts.At(x, y) != ReferenceCount(p, p.x_start + x * stepx, p.y_start + y * stepy);
+		CHECK(differ <= width * height / 200);
+	}
+
+	// z^2 + c through the Multibrot kernel is the Mandelbrot set bit for bit
+	p.fractal = Fractal::multibrot;
+	p.power = 2;
+	const MandelbrotCounts square = Mandelbrot_Compute(p, width, height);
+	p.fractal = Fractal::mandelbrot;
+	CHECK(square.counts == Mandelbrot_Compute(p, width, height).counts);
+}
+
+TEST(BatchMatchesSingleRenders)
+{
+	// sizes which are not whole tiles, one larger than a tile
+	std::vector<MandelbrotView> views;
+	for (int i = 0; i < 7; i++)
+	{
+		MandelbrotParams p = Seahorses();
+		p.x_start += i * 0.01;
+		p.depth = 300 + 50 * i;
+		views.push_back({ p, 40 + 9 * i, 30 + 11 * i });
+	}
+	views.push_back({ MandelbrotParams{}, kMandelbrotTileSize + 5, kMandelbrotTileSize + 1 });
+
+	const std::vector<MandelbrotCounts> batch = Mandelbrot_ComputeBatch(views);
+	CHECK(batch.size() == views.size());
+	std::vector<FrameBuffer> singles;
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		const MandelbrotCounts single = Mandelbrot_Compute(views[i].params, views[i].width, views[i].height);
+		CHECK(batch[i].width == single.width && batch[i].height == single.height);
+		CHECK(batch[i].max == single.max && batch[i].counts == single.counts);
+		singles.emplace_back(single.width, single.height);
+		Mandelbrot_Shade(single, MandelbrotPalette{}, singles.back());
+	}
+
+	// shaded one by one through the sink
+	std::vector<char> delivered(views.size(), false);
+	Mandelbrot_RenderBatch(views, MandelbrotPalette{}, [&](size_t i, const FrameBuffer& frame) {
+		// concurrent calls write distinct elements, not bits of one
+		delivered[i] = frame.width == singles[i].width && frame.height == singles[i].height &&
+			std::equal(frame.Data(), frame.Data() + frame.width * frame.height, singles[i].Data());
+		});
+	for (size_t i = 0; i < views.size(); i++)
+		CHECK(delivered[i]);
+
+	// and into an atlas
+	int width = 0, height = 0;
+	const std::vector<TileRect> placement = Mandelbrot_AtlasGrid(views, 3, width, height);
+	FrameBuffer atlas{ width, height };
+	Mandelbrot_RenderAtlas(views, MandelbrotPalette{}, placement, atlas);
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		const TileRect& r = placement[i];
+		CHECK(r.width == views[i].width && r.height == views[i].height);
+		CHECK(r.x + r.width <= width && r.y + r.height <= height);
+		for (int y = 0; y < r.height; y++)
+			for (int x = 0; x < r.width; x++)
+				CHECK(atlas.Pixel(r.x + x, r.y + y) == singles[i].Pixel(x, y));
+	}
+}
+
+TEST(PanMatchesFreshRender)
+{
+	const int width = 101, height = 67;
+	const MandelbrotParams from = Seahorses();
+	const int moves[][2] = { { 7, 0 }, { 0, -5 }, { -13, 9 }, { 40, -30 }, { width, 0 }, { -3, -height } };
+	for (const auto& m : moves)
+	{
+		MandelbrotCounts counts = Mandelbrot_Compute(from, width, height);
+		const MandelbrotParams to = Mandelbrot_PanView(from, width, height, m[0], m[1]);
+		int dx = 0, dy = 0;
+		CHECK(Mandelbrot_PixelShift(from, to, width, height, dx, dy));
+		CHECK(dx == m[0] && dy == m[1]);
+
+		Mandelbrot_Pan(from, dx, dy, counts);
+		// the same points up to the rounding of a pixel step, which can
+		// change the count of a point right at the boundary
+		CHECK(Differing(counts, Mandelbrot_Compute(to, width, height)) <= width * height / 1000);
+		CHECK(counts.max == *std::max_element(counts.counts.begin(), counts.counts.end()));
+	}
+
+	// on the lattice every coordinate is exact, the pictures are the same
+	const MandelbrotParams lattice = Mandelbrot_LatticeView(from, width, height);
+	MandelbrotCounts counts = Mandelbrot_Compute(lattice, width, height);
+	Mandelbrot_Pan(lattice, -11, 6, counts);
+	CHECK(counts.counts == Mandelbrot_Compute(Mandelbrot_PanView(lattice, width, height, -11, 6), width, height).counts);
+
+	// not a whole pixel, or another depth
+	MandelbrotParams half = from;
+	half.x_start += 0.5 * from.x_range / width;
+	int dx, dy;
+	CHECK(!Mandelbrot_PixelShift(from, half, width, height, dx, dy));
+	MandelbrotParams deeper = Mandelbrot_PanView(from, width, height, 1, 1);
+	deeper.depth++;
+	CHECK(!Mandelbrot_PixelShift(from, deeper, width, height, dx, dy));
+}
+
+TEST(ZoomReusingMatchesFullRender)
+{
+	for (const auto& size : { std::pair{ 99, 71 }, std::pair{ 128, 64 }, std::pair{ 37, 53 } })
+	{
+		const int width = size.first, height = size.second;
+		MandelbrotParams view = Mandelbrot_LatticeView(Seahorses(), width, height);
+		CHECK(Mandelbrot_OnLattice(view, width, height));
+		MandelbrotCounts counts = Mandelbrot_Compute(view, width, height);
+
+		// in twice at different pixels, out three times, in again
+		const struct { int x, y; bool in; } steps[] = {
+			{ width / 3, height / 2, true }, { width - 1, 0, true }, { 5, height - 2, false },
+			{ width / 2, height / 2, false }, { 0, 0, false }, { width / 4, height / 3, true } };
+		for (const auto& s : steps)
+		{
+			const MandelbrotParams to = Mandelbrot_LatticeZoom(view, width, height, s.x, s.y, s.in);
+			CHECK(Mandelbrot_OnLattice(to, width, height));
+			counts = Mandelbrot_ComputeReusing(view, counts, to);
+			const MandelbrotCounts full = Mandelbrot_Compute(to, width, height);
+			CHECK(counts.counts == full.counts && counts.max == full.max && counts.depth == full.depth);
+			view = to;
+		}
+	}
+}
+
+TEST(KernelsAgree)
+{
+	MandelbrotParams julia;
+	julia.fractal = Fractal::julia;
+	julia.x_start = -1.6;
+	julia.y_start = -1;
+	julia.x_range = 3.2;
+	julia.y_range = 2;
+	const MandelbrotParams views[] = { MandelbrotParams{}, Seahorses(), julia };
+
+	// a picture of one largest tile plus a few pixels, so edge tiles are thin
+	const int width = kMandelbrotMaxTileSize + 3, height = kMandelbrotMaxTileSize / 2 + 1;
+	for (const MandelbrotParams& p : views)
+	{
+		const MandelbrotCounts reference = Mandelbrot_Compute(p, width, height);
+		for (const int tile_size : { 16, 37, kMandelbrotMaxTileSize })
+			for (const auto kernel : { MandelbrotKernel::lanes, MandelbrotKernel::scalar, MandelbrotKernel::stream })
+			{
+				MandelbrotTuning tuning;
+				tuning.tile_size = tile_size;
+				tuning.kernel = kernel;
+				const MandelbrotCounts counts = Mandelbrot_ComputeTuned(p, width, height, tuning);
+				CHECK(counts.counts == reference.counts && counts.max == reference.max);
+			}
+	}
+}
@@ -0,0 +1,153 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the C interface of the renderer
+
+#include <cstdint>
+#include <vector>
+#include "test.h"
+#include "framebuffer.h"
+#include "mandel_algo.h"
+#include "mandelbrot_api.h"
+
+namespace {
+
+constexpr int kWidth = 100, kHeight = 75;
+constexpr int kStride = 4 * kWidth + 16; // padded rows
+
+mb_view Seahorses()
+{
+	mb_view view;
+	mb_default_view(&view);
+	view.x_start = -0.9;
+	view.y_start = -0.3;
+	view.x_range = 0.4;
+	view.y_range = 0.3;
+	view.depth = 500;
+	return view;
+}
+
+MandelbrotParams Params(const mb_view& view)
+{
+	MandelbrotParams p;
+	p.x_start = view.x_start;
+	p.y_start = view.y_start;
+	p.x_range = view.x_range;
+	p.y_range = view.y_range;
+	p.depth = view.depth;
+	return p;
+}
+
+// Deleted at the end of the test
+struct Context {
+	mb_context* context = mb_create(nullptr);
+	~Context() { mb_destroy(context); }
+};
+
+}
+
+TEST(MandelbrotApiRejectsBadArguments)
+{
+	Context c;
+	CHECK(c.context != nullptr);
+	const mb_view view = Seahorses();
+	std::vector<int32_t> counts(kStride / 4 * kHeight);
+
+	CHECK(mb_render_counts(c.context, &view, kWidth, kHeight, counts.data(), 399) == MB_ERROR_ARGUMENT);
+	CHECK(mb_render_counts(c.context, &view, kWidth, kHeight, counts.data(), 4 * kWidth - 4) == MB_ERROR_ARGUMENT);
+	CHECK(mb_render_counts(c.context, &view, kWidth, kHeight, nullptr, kStride) == MB_ERROR_ARGUMENT);
+	CHECK(mb_render_counts(c.context, &view, 0, kHeight, counts.data(), kStride) == MB_ERROR_ARGUMENT);
+	CHECK(mb_render_counts(nullptr, &view, kWidth, kHeight, counts.data(), kStride) == MB_ERROR_ARGUMENT);
+	CHECK(mb_render_counts(c.context, nullptr, kWidth, kHeight, counts.data(), kStride) == MB_ERROR_ARGUMENT);
+
+	mb_view bad = view;
+	bad.x_range = 0;
+	CHECK(mb_render_counts(c.context, &bad, kWidth, kHeight, counts.data(), kStride) == MB_ERROR_ARGUMENT);
+	bad = view;
+	bad.fractal = MB_FRACTAL_TRICORN + 1;
+	CHECK(mb_render_counts(c.context, &bad, kWidth, kHeight, counts.data(), kStride) == MB_ERROR_ARGUMENT);
+
+	std::vector<uint8_t> pixels(kStride * kHeight);
+	CHECK(mb_render_pixels(c.context, &view, kWidth, kHeight, nullptr, 2, pixels.data(), kStride) ==
+		MB_ERROR_ARGUMENT);
+
+	// nothing was rendered
+	mb_stats stats;
+	CHECK(mb_get_stats(c.context, &stats) == MB_OK);
+	CHECK(stats.frames == 0 && stats.pixels == 0);
+	CHECK(mb_get_stats(c.context, nullptr) == MB_ERROR_ARGUMENT);
+}
+
+TEST(MandelbrotApiCountsMatchCompute)
+{
+	Context c;
+	const mb_view view = Seahorses();
+	std::vector<int32_t> counts(kStride / 4 * kHeight, -7);
+	CHECK(mb_render_counts(c.context, &view, kWidth, kHeight, counts.data(), kStride) == MB_OK);
+
+	const MandelbrotCounts expected = Mandelbrot_Compute(Params(view), kWidth, kHeight);
+	bool same = true, padding = true;
+	for (int y = 0; y < kHeight; y++)
+	{
+		for (int x = 0; x < kWidth; x++)
+			same = same && counts[y * (kStride / 4) + x] == expected.At(x, y);
+		for (int x = kWidth; x < kStride / 4; x++)
+			padding = padding && counts[y * (kStride / 4) + x] == -7;
+	}
+	CHECK(same);
+	CHECK(padding);
+
+	mb_stats stats;
+	CHECK(mb_get_stats(c.context, &stats) == MB_OK);
+	CHECK(stats.frames == 1 && stats.pixels == kWidth * kHeight);
+	CHECK(stats.last_max == expected.max);
+	CHECK(stats.threads >= 1 && stats.tile_size > 0);
+}
+
+TEST(MandelbrotApiPixelByteOrder)
+{
+	Context c;
+	const mb_view view = Seahorses();
+	std::vector<uint8_t> bgra(kStride * kHeight), rgba(kStride * kHeight);
+	CHECK(mb_render_pixels(c.context, &view, kWidth, kHeight, nullptr, MB_PIXELS_BGRA, bgra.data(), kStride) == MB_OK);
+	CHECK(mb_render_pixels(c.context, &view, kWidth, kHeight, nullptr, MB_PIXELS_RGBA, rgba.data(), kStride) == MB_OK);
+
+	// the colours of the shade stage, 0xAARRGGBB words
+	FrameBuffer frame{ kWidth, kHeight };
+	Mandelbrot_Shade(Mandelbrot_Compute(Params(view), kWidth, kHeight), MandelbrotPalette{}, frame);
+
+	bool bgra_order = true, rgba_order = true;
+	for (int y = 0; y < kHeight; y++)
+		for (int x = 0; x < kWidth; x++)
+		{
+			const FrameBuffer::Colour colour = frame.Pixel(x, y);
+			const uint8_t a = colour >> 24 & 0xFF, r = colour >> 16 & 0xFF, g = colour >> 8 & 0xFF, b = colour & 0xFF;
+			const uint8_t* p = &bgra[y * kStride + 4 * x];
+			const uint8_t* q = &rgba[y * kStride + 4 * x];
+			bgra_order = bgra_order && p[0] == b && p[1] == g && p[2] == r && p[3] == a && a == 0xFF;
+			rgba_order = rgba_order && q[0] == r && q[1] == g && q[2] == b && q[3] == a;
+		}
+	CHECK(bgra_order);
+	CHECK(rgba_order);
+
+	mb_stats stats;
+	CHECK(mb_get_stats(c.context, &stats) == MB_OK && stats.frames == 2);
+}
@@ -0,0 +1,49 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the headless presenter
+
+#include "test.h"
+#include "framebuffer.h"
+#include "memory_presenter.h"
+
+TEST(MemoryPresenterKeepsFramesAndRegions)
+{
+	FrameBuffer frame{ 8, 4 };
+	for (int y = 0; y < frame.height; y++)
+		for (int x = 0; x < frame.width; x++)
+			frame.Pixel(x, y, static_cast<FrameBuffer::Colour>(y * frame.width + x));
+
+	MemoryPresenter presenter;
+	presenter.Present(frame);
+	CHECK(presenter.Width() == 8 && presenter.Height() == 4);
+	CHECK(presenter.Frames() == 1);
+	CHECK(presenter.Pixel(5, 3) == 29);
+
+	// only the region is copied
+	FrameBuffer next{ 8, 4 };
+	for (int y = 0; y < next.height; y++)
+		for (int x = 0; x < next.width; x++)
+			next.Pixel(x, y, FrameBuffer::Colour{ 7 });
+	presenter.Present(next, TileRect{ 2, 1, 3, 2 });
+	CHECK(presenter.Regions() == 1);
+	CHECK(presenter.Pixel(2, 1) == 7 && presenter.Pixel(4, 2) == 7);
+	CHECK(presenter.Pixel(1, 1) == 9 && presenter.Pixel(5, 2) == 21 && presenter.Pixel(2, 3) == 26);
+}
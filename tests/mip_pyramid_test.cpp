@@ -0,0 +1,70 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the streaming mip-map pyramid
+
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "framebuffer.h"
+#include "mip_pyramid.h"
+
+TEST(MipPyramidTilesEveryLevel)
+{
+	constexpr int kWidth = 300, kHeight = 200, kTile = 64;
+
+	struct Tile {
+		int level, column, row, width, height;
+		FrameBuffer::Colour corner;
+	};
+	std::vector<Tile> tiles;
+	MipPyramid pyramid{ kWidth, kHeight, kTile, [&](int level, int column, int row, const FrameBuffer& t) {
+		tiles.push_back({ level, column, row, t.width, t.height, t.Pixel(0, 0) });
+		} };
+
+	// columns alternate between two grey levels, level 1 is their average
+	FrameBuffer picture{ kWidth, kHeight };
+	for (int y = 0; y < kHeight; y++)
+		for (int x = 0; x < kWidth; x++)
+			picture.Pixel(x, y, x % 2 ? 0xFF404040u : 0xFF202020u);
+	pyramid.AddRows(picture);
+	CHECK(pyramid.Done());
+
+	// 300x200, 150x100, 75x50, 38x25 which fits one tile
+	CHECK(pyramid.Levels() == 4);
+	CHECK(pyramid.LevelWidth(3) == 38 && pyramid.LevelHeight(3) == 25);
+
+	const int expected[] = { 5 * 4, 3 * 2, 2 * 1, 1 };
+	for (int level = 0; level < pyramid.Levels(); level++)
+	{
+		int count = 0;
+		for (const Tile& t : tiles)
+		{
+			if (t.level != level)
+				continue;
+			count++;
+			const int w = std::min(kTile, pyramid.LevelWidth(level) - t.column * kTile);
+			const int h = std::min(kTile, pyramid.LevelHeight(level) - t.row * kTile);
+			CHECK(t.width == w && t.height == h);
+			CHECK(t.corner == (level == 0 ? 0xFF202020u : 0xFF303030u));
+		}
+		CHECK(count == expected[level]);
+	}
+}
@@ -0,0 +1,82 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of locating mini-brots
+
+#include <cmath>
+#include "test.h"
+#include "nucleus.h"
+
+namespace {
+
+// nuclei of period 3: the real one (the "airship") and the upper of the pair
+// on the main cardioid
+constexpr double kAirshipRe = -1.7548776662466927;
+constexpr double kRabbitRe = -0.12256116687665361, kRabbitIm = 0.74486176661974423;
+
+bool Near(double a, double b)
+{
+	return std::abs(a - b) < 1e-12;
+}
+
+} // namespace
+
+TEST(NucleusConvergesToPeriodThree)
+{
+	MandelbrotNucleus nucleus;
+	CHECK(Mandelbrot_Nucleus(-1.76, 0.001, 3, nucleus));
+	CHECK(nucleus.period == 3 && Near(nucleus.re, kAirshipRe) && Near(nucleus.im, 0));
+	CHECK(nucleus.size > 0 && nucleus.size < 0.1);
+
+	CHECK(Mandelbrot_Nucleus(-0.1, 0.75, 3, nucleus));
+	CHECK(Near(nucleus.re, kRabbitRe) && Near(nucleus.im, kRabbitIm));
+
+	CHECK(!Mandelbrot_Nucleus(-1.76, 0, 0, nucleus));
+}
+
+TEST(NucleusBoxPeriod)
+{
+	CHECK(Mandelbrot_BoxPeriod(kAirshipRe, 0, 1e-3, 100) == 3);
+	CHECK(Mandelbrot_BoxPeriod(kRabbitRe, kRabbitIm, 1e-3, 100) == 3);
+	CHECK(Mandelbrot_BoxPeriod(0, 0, 1e-3, 100) == 1);
+	// far outside the set the corners escape
+	CHECK(Mandelbrot_BoxPeriod(3, 3, 1e-3, 100) == 0);
+}
+
+TEST(NucleusLocateMinibrot)
+{
+	// the airship from a view of the tip of the set, pixel under it; the
+	// period 2 bulb is outside of the view
+	MandelbrotParams p;
+	p.x_start = -2;
+	p.y_start = -0.25;
+	p.x_range = 0.5;
+	p.y_range = 0.5;
+	const int size = 300;
+	const int x = static_cast<int>((kAirshipRe - p.x_start) / p.x_range * size);
+	MandelbrotNucleus nucleus;
+	CHECK(Mandelbrot_LocateMinibrot(p, size, size, x, size / 2, nucleus));
+	CHECK(nucleus.period == 3 && Near(nucleus.re, kAirshipRe));
+
+	const MandelbrotParams framed = Mandelbrot_FrameNucleus(p, nucleus);
+	CHECK(framed.x_start < kAirshipRe && framed.x_start + framed.x_range > kAirshipRe);
+	CHECK(framed.x_range < p.x_range && framed.depth >= p.depth);
+}
@@ -0,0 +1,152 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of resuming a killed render from its checkpoint
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include "test.h"
+#include "render_checkpoint.h"
+
+namespace {
+
+constexpr int kWidth = 300, kHeight = 200;
+
+MandelbrotParams Job()
+{
+	MandelbrotParams p;
+	p.x_start = -0.8;
+	p.y_start = -0.2;
+	p.x_range = 0.3;
+	p.y_range = 0.2;
+	return p;
+}
+
+// tiles answered by the wrapped cache
+class CountingCache : public MandelbrotTileCache {
+public:
+	explicit CountingCache(MandelbrotTileCache& cache) : cache{ cache } {}
+
+	bool Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride) override
+	{
+		const bool found = cache.Load(p, width, height, tile, counts, stride);
+		hits += found;
+		return found;
+	}
+
+	void Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride) override
+	{
+		cache.Save(p, width, height, tile, counts, stride);
+	}
+
+	std::atomic<int> hits{ 0 };
+
+private:
+	MandelbrotTileCache& cache;
+};
+
+} // namespace
+
+TEST(RenderCheckpointResumesStoppedRender)
+{
+	const std::string dir = TestDirectory("checkpoint");
+	const int tiles = Mandelbrot_TileCount(kWidth, kHeight);
+
+	// the render is stopped after a few tiles, as if the process was killed
+	{
+		RenderCheckpoint checkpoint;
+		CHECK(checkpoint.Open(dir, Job(), kWidth, kHeight));
+		CHECK(checkpoint.Resumed() == 0);
+		std::atomic<bool> stop{ false };
+		std::atomic<int> done{ 0 };
+		Mandelbrot_Compute(Job(), kWidth, kHeight, false,
+			[&](const TileRect&, const int*, int) {
+				if (++done >= 4)
+					stop = true;
+			},
+			&checkpoint, &stop);
+		CHECK(checkpoint.Flush());
+	}
+
+	RenderCheckpoint checkpoint;
+	CHECK(checkpoint.Open(dir, Job(), kWidth, kHeight));
+	const int resumed = checkpoint.Resumed();
+	CHECK(resumed >= 4 && resumed < tiles);
+
+	CountingCache counting{ checkpoint };
+	const MandelbrotCounts counts = Mandelbrot_Compute(Job(), kWidth, kHeight, false, {}, &counting);
+	CHECK(counting.hits == resumed);
+	CHECK(counts.counts == Mandelbrot_Compute(Job(), kWidth, kHeight).counts);
+
+	checkpoint.Remove();
+	CHECK(!std::filesystem::exists(dir));
+}
+
+TEST(RenderCheckpointSkipsTornSegment)
+{
+	const std::string dir = TestDirectory("checkpoint_torn");
+	const int tiles = Mandelbrot_TileCount(kWidth, kHeight);
+	{
+		// one segment with every tile
+		RenderCheckpoint checkpoint{ std::chrono::hours(1) };
+		CHECK(checkpoint.Open(dir, Job(), kWidth, kHeight));
+		Mandelbrot_Compute(Job(), kWidth, kHeight, false, {}, &checkpoint);
+		CHECK(checkpoint.Flush());
+	}
+
+	// a power cut tore the end of the last tile off
+	const auto segment = std::filesystem::path{ dir } / "tiles_000000.mbs";
+	CHECK(std::filesystem::exists(segment));
+	std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 10);
+
+	RenderCheckpoint checkpoint;
+	CHECK(checkpoint.Open(dir, Job(), kWidth, kHeight));
+	CHECK(checkpoint.Resumed() == tiles - 1);
+	CountingCache counting{ checkpoint };
+	const MandelbrotCounts counts = Mandelbrot_Compute(Job(), kWidth, kHeight, false, {}, &counting);
+	CHECK(counting.hits == tiles - 1);
+	CHECK(counts.counts == Mandelbrot_Compute(Job(), kWidth, kHeight).counts);
+	checkpoint.Remove();
+}
+
+TEST(RenderCheckpointOfAnotherJobStartsOver)
+{
+	const std::string dir = TestDirectory("checkpoint_other");
+	{
+		RenderCheckpoint checkpoint;
+		CHECK(checkpoint.Open(dir, Job(), kWidth, kHeight));
+		Mandelbrot_Compute(Job(), kWidth, kHeight, false, {}, &checkpoint);
+		CHECK(checkpoint.Flush());
+	}
+
+	MandelbrotParams other = Job();
+	other.depth = 700;
+	RenderCheckpoint checkpoint;
+	CHECK(checkpoint.Open(dir, other, kWidth, kHeight));
+	CHECK(checkpoint.Resumed() == 0);
+
+	// nor does a picture of another size take the tiles
+	RenderCheckpoint resized;
+	CHECK(resized.Open(dir, other, kWidth * 2, kHeight));
+	CHECK(resized.Resumed() == 0);
+	resized.Remove();
+}
@@ -0,0 +1,137 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+
+// Tests of the frame ring shared with other processes
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "test.h"
+#include "framebuffer.h"
+#include "shared_frames.h"
+
+namespace {
+
+constexpr int kWidth = 150, kHeight = 100; // 3 x 2 tiles, the edge ones cut
+
+void Fill(FrameBuffer& frame, FrameBuffer::Colour base)
+{
+	for (int y = 0; y < frame.height; y++)
+		for (int x = 0; x < frame.width; x++)
+			frame.Pixel(x, y, static_cast<FrameBuffer::Colour>(base + y * frame.width + x));
+}
+
+bool Matches(const SharedFrameReader::Frame& shared, const FrameBuffer& frame)
+{
+	for (int y = 0; y < frame.height; y++)
+		for (int x = 0; x < frame.width; x++)
+			if (shared.pixels[y * shared.stride + x] != frame.Row(y)[x])
+				return false;
+	return true;
+}
+
+}
+
+TEST(SharedFramesRoundTrip)
+{
+	SharedMemoryPresenter presenter{ "/mandelbrot_test_round_trip", kWidth, kHeight };
+	CHECK(presenter.Valid());
+	SharedFrameReader reader;
+	CHECK(reader.Open("/mandelbrot_test_round_trip"));
+	CHECK(reader.TilesX() == 3 && reader.TilesY() == 2);
+
+	SharedFrameReader::Frame shared;
+	CHECK(!reader.Latest(shared));
+
+	FrameBuffer frame{ kWidth, kHeight };
+	Fill(frame, 0);
+	presenter.Present(frame);
+	CHECK(reader.Latest(shared));
+	CHECK(shared.number == 1 && shared.width == kWidth && shared.height == kHeight);
+	CHECK(Matches(shared, frame));
+	CHECK(reader.StillValid(shared));
+
+	// only the tile at (1, 1) changes
+	for (int y = 64; y < kHeight; y++)
+		for (int x = 64; x < 128; x++)
+			frame.Pixel(x, y, FrameBuffer::Colour{ 7 });
+	presenter.Present(frame, TileRect{ 64, 64, 64, 36 });
+	SharedFrameReader::Frame next;
+	CHECK(reader.Latest(next));
+	CHECK(next.number == 2 && presenter.Frames() == 2);
+	CHECK(Matches(next, frame));
+
+	const auto dirty = reader.DirtySince(1, next);
+	CHECK(dirty == std::vector<std::uint8_t>({ 0, 0, 0, 0, 1, 0 }));
+	const auto none = reader.DirtySince(2, next);
+	CHECK(std::count(none.begin(), none.end(), 1) == 0);
+	const auto all = reader.DirtySince(0, next);
+	CHECK(std::count(all.begin(), all.end(), 1) == 6);
+}
+
+TEST(SharedFramesDirtySinceAddsUp)
+{
+	SharedMemoryPresenter presenter{ "/mandelbrot_test_dirty", kWidth, kHeight, 4 };
+	SharedFrameReader reader;
+	CHECK(presenter.Valid() && reader.Open("/mandelbrot_test_dirty"));
+
+	FrameBuffer frame{ kWidth, kHeight };
+	Fill(frame, 0);
+	presenter.Present(frame);
+	presenter.Present(frame, TileRect{ 0, 0, 10, 10 });
+	presenter.Present(frame, TileRect{ 130, 70, 20, 30 });
+
+	SharedFrameReader::Frame shared;
+	CHECK(reader.Latest(shared) && shared.number == 3);
+	CHECK(reader.DirtySince(1, shared) == std::vector<std::uint8_t>({ 1, 0, 0, 0, 0, 1 }));
+	CHECK(reader.DirtySince(2, shared) == std::vector<std::uint8_t>({ 0, 0, 0, 0, 0, 1 }));
+}
+
+TEST(SharedFramesLappedReader)
+{
+	SharedMemoryPresenter presenter{ "/mandelbrot_test_lapped", kWidth, kHeight, 3 };
+	SharedFrameReader reader;
+	CHECK(presenter.Valid() && reader.Open("/mandelbrot_test_lapped"));
+
+	FrameBuffer frame{ kWidth, kHeight };
+	Fill(frame, 0);
+	presenter.Present(frame);
+	SharedFrameReader::Frame old;
+	CHECK(reader.Latest(old) && old.number == 1);
+
+	// three more frames reuse the slot of the first one
+	for (int i = 1; i <= 3; i++)
+	{
+		Fill(frame, static_cast<FrameBuffer::Colour>(i));
+		presenter.Present(frame, TileRect{ 0, 0, 1, 1 });
+	}
+	CHECK(!reader.StillValid(old));
+
+	SharedFrameReader::Frame latest;
+	CHECK(reader.Latest(latest) && latest.number == 4);
+	CHECK(reader.StillValid(latest));
+
+	// the frames in between are gone, so everything is dirty
+	const auto dirty = reader.DirtySince(old.number, latest);
+	CHECK(std::count(dirty.begin(), dirty.end(), 1) == 6);
+	// while the last two are still in the ring
+	CHECK(reader.DirtySince(2, latest) == std::vector<std::uint8_t>({ 1, 0, 0, 0, 0, 0 }));
+}
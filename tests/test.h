@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Minimal test registry, no framework needed: TEST(name) { ... } in any file
+// of the test project registers a test, main (test_main.cpp) runs them all.
+// A failed CHECK ends its test and the run goes on with the next one.
+
+struct TestCase {
+	const char* name;
+	void (*run)();
+};
+
+std::vector<TestCase>& Tests();
+
+struct TestRegistration {
+	TestRegistration(const char* name, void (*run)()) { Tests().push_back({ name, run }); }
+};
+
+// throws, caught by the runner
+[[noreturn]] void TestFailed(const char* file, int line, const char* expression);
+
+// Empty scratch directory of a test, under the temporary directory
+std::string TestDirectory(const char* name);
+
+#define TEST(name) \
+	static void name(); \
+	static const TestRegistration name##_registration{ #name, name }; \
+	static void name()
+
+#define CHECK(expression) \
+	do { \
+		if (!(expression)) \
+			TestFailed(__FILE__, __LINE__, #expression); \
+	} while (false)
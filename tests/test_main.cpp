@@ -0,0 +1,89 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// test_main.cpp : runs the tests of the parts which do not need a window.
+//
+// usage: tests [name filter]
+//
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include "test.h"
+#include "socket.h"
+
+namespace {
+
+struct Failure {
+	std::string where;
+};
+
+} // namespace
+
+std::vector<TestCase>& Tests()
+{
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+void TestFailed(const char* file, int line, const char* expression)
+{
+	throw Failure{ std::string{ file } + ":" + std::to_string(line) + ": CHECK(" + expression + ")" };
+}
+
+std::string TestDirectory(const char* name)
+{
+	const auto dir = std::filesystem::temp_directory_path() / (std::string{ "mandelbrot_" } + name);
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	return dir.string();
+}
+
+int main(int argc, char* argv[])
+{
+	SocketLibrary sockets;
+
+	int run = 0, failed = 0;
+	for (const TestCase& test : Tests())
+	{
+		if (argc > 1 && std::string{ test.name }.find(argv[1]) == std::string::npos)
+			continue;
+
+		run++;
+		try
+		{
+			test.run();
+			std::printf("ok      %s\n", test.name);
+		}
+		catch (const Failure& f)
+		{
+			failed++;
+			std::printf("FAILED  %s\n        %s\n", test.name, f.where.c_str());
+		}
+		catch (const std::exception& e)
+		{
+			failed++;
+			std::printf("FAILED  %s\n        exception: %s\n", test.name, e.what());
+		}
+	}
+
+	std::printf("%d of %d tests passed\n", run - failed, run);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the tile server on localhost
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "socket.h"
+#include "tile_server.h"
+
+namespace {
+
+// Whole response to one request on a connection of its own
+std::string Get(std::uint16_t port, const std::string& path)
+{
+	Socket s = Socket::Connect("127.0.0.1", port);
+	if (!s)
+		return {};
+	const std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+	if (!s.SendAll(request.data(), request.size()))
+		return {};
+
+	std::string response;
+	char chunk[4096];
+	long n;
+	while ((n = s.Receive(chunk, sizeof(chunk))) > 0)
+		response.append(chunk, n);
+	return response;
+}
+
+std::string Body(const std::string& response)
+{
+	const size_t end = response.find("\r\n\r\n");
+	return end == std::string::npos ? std::string{} : response.substr(end + 4);
+}
+
+bool StartsWith(const std::string& s, const std::string& prefix)
+{
+	return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+TEST(TileServerServesTiles)
+{
+	TileServer server{ 0, 16 << 20 };
+	CHECK(server.Listening());
+	std::thread run{ [&server] { server.Run(); } };
+
+	const std::string tile = Get(server.Port(), "/1/0/1.png");
+	CHECK(StartsWith(tile, "HTTP/1.1 200"));
+	CHECK(tile.find("image/png") != std::string::npos);
+	CHECK(StartsWith(Body(tile), "\x89PNG\r\n\x1a\n"));
+
+	// the second time from the cache, the same bytes
+	CHECK(Get(server.Port(), "/1/0/1.png") == tile);
+	CHECK(server.Stats().misses == 1 && server.Stats().hits == 1);
+
+	CHECK(tile.find("Cache-Control: public") != std::string::npos);
+
+	CHECK(StartsWith(Get(server.Port(), "/"), "HTTP/1.1 200"));
+	CHECK(StartsWith(Get(server.Port(), "/stats"), "HTTP/1.1 200"));
+	const std::string missing = Get(server.Port(), "/1/5/0.png");
+	CHECK(StartsWith(missing, "HTTP/1.1 404"));
+	CHECK(missing.find("Cache-Control: no-store") != std::string::npos);
+	CHECK(StartsWith(Get(server.Port(), "/nothing"), "HTTP/1.1 404"));
+
+	server.Stop();
+	run.join();
+}
+
+TEST(TileServerRendersConcurrentRequestsOnce)
+{
+	TileServer server{ 0, 16 << 20 };
+	std::thread run{ [&server] { server.Run(); } };
+
+	std::vector<std::string> responses(8);
+	std::vector<std::thread> clients;
+	for (auto& r : responses)
+		clients.emplace_back([&server, &r] { r = Get(server.Port(), "/3/2/5.png"); });
+	for (auto& c : clients)
+		c.join();
+
+	for (const auto& r : responses)
+		CHECK(StartsWith(r, "HTTP/1.1 200") && Body(r) == Body(responses[0]));
+	CHECK(server.Stats().misses == 1);
+
+	server.Stop();
+	run.join();
+}
+
+TEST(TileServerStopsWithIdleConnections)
+{
+	TileServer server{ 0, 16 << 20 };
+	std::thread run{ [&server] { server.Run(); } };
+
+	// a keep-alive client which never sends anything holds a connection thread
+	Socket idle = Socket::Connect("127.0.0.1", server.Port());
+	CHECK(idle.Valid());
+	CHECK(StartsWith(Get(server.Port(), "/0/0/0.png"), "HTTP/1.1 200"));
+
+	// Run returns without waiting for the client
+	server.Stop();
+	run.join();
+}
+
+TEST(TileServerStopBeforeRun)
+{
+	TileServer server{ 0, 16 << 20 };
+	server.Stop();
+	server.Run(); // returns at once
+	CHECK(!server.Listening());
+}
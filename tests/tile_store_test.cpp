@@ -0,0 +1,186 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the memory-mapped tile store
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "test.h"
+#include "tile_store.h"
+
+namespace {
+
+constexpr int kWidth = 200, kHeight = 150;
+
+// counts the tiles the wrapped cache knew
+class CountingCache : public MandelbrotTileCache {
+public:
+	explicit CountingCache(MandelbrotTileCache& cache) : cache{ cache } {}
+
+	bool Load(const MandelbrotParams& p, int width, int height, const TileRect& tile, int* counts, int stride) override
+	{
+		const bool found = cache.Load(p, width, height, tile, counts, stride);
+		hits += found;
+		return found;
+	}
+
+	void Save(const MandelbrotParams& p, int width, int height, const TileRect& tile, const int* counts, int stride) override
+	{
+		cache.Save(p, width, height, tile, counts, stride);
+	}
+
+	std::atomic<int> hits{ 0 };
+
+private:
+	MandelbrotTileCache& cache;
+};
+
+// overwrite a field of the store header, the store must be closed
+template <class T>
+void Patch(const std::string& path, std::streamoff offset, T value)
+{
+	std::fstream f{ path, std::ios::in | std::ios::out | std::ios::binary };
+	f.seekp(offset);
+	f.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::string FilledStore(const char* test)
+{
+	const std::string path = TestDirectory(test) + "/tiles.dat";
+	TileStore store;
+	if (store.Open(path, 256))
+		Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight, false, {}, &store);
+	return path;
+}
+
+} // namespace
+
+TEST(TileStoreKeepsTilesAcrossSessions)
+{
+	const std::string path = FilledStore("tile_store");
+	const int tiles = Mandelbrot_TileCount(kWidth, kHeight);
+
+	TileStore store;
+	CHECK(store.Open(path, 256));
+	CHECK(store.Tiles() == static_cast<std::uint32_t>(tiles));
+
+	CountingCache counting{ store };
+	const MandelbrotCounts cached = Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight, false, {}, &counting);
+	CHECK(counting.hits == tiles);
+	CHECK(cached.counts == Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight).counts);
+
+	// another view shares nothing
+	MandelbrotParams other;
+	other.depth = 500;
+	CountingCache misses{ store };
+	Mandelbrot_Compute(other, kWidth, kHeight, false, {}, &misses);
+	CHECK(misses.hits == 0);
+}
+
+TEST(TileStoreLastView)
+{
+	const std::string path = TestDirectory("tile_store_view") + "/tiles.dat";
+	MandelbrotParams view;
+	view.x_start = -0.75;
+	view.depth = 3000;
+	{
+		TileStore store;
+		CHECK(store.Open(path, 64));
+		store.SetLastView(view, 640, 480);
+		store.Flush();
+	}
+
+	TileStore store;
+	CHECK(store.Open(path, 64));
+	MandelbrotParams last;
+	int width = 0, height = 0;
+	CHECK(store.LastView(last, width, height));
+	CHECK(last == view && width == 640 && height == 480);
+}
+
+TEST(TileStoreRecreatesDamagedIndex)
+{
+	// the index capacity must be a power of two
+	const std::string path = FilledStore("tile_store_capacity");
+	Patch<std::uint32_t>(path, 12, 3);
+
+	TileStore store;
+	CHECK(store.Open(path, 256));
+	CHECK(store.Valid() && store.Tiles() == 0);
+
+	// and the store works again
+	Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight, false, {}, &store);
+	CHECK(store.Tiles() == static_cast<std::uint32_t>(Mandelbrot_TileCount(kWidth, kHeight)));
+}
+
+TEST(TileStoreRecreatesDamagedDataArea)
+{
+	// end of the data beyond the end of the file
+	const std::string path = FilledStore("tile_store_data");
+	Patch<std::uint64_t>(path, 16, std::uint64_t{ 1 } << 40);
+
+	TileStore store;
+	CHECK(store.Open(path, 256));
+	CHECK(store.Valid() && store.Tiles() == 0);
+}
+
+TEST(TileStoreRecreatesForeignFile)
+{
+	const std::string path = TestDirectory("tile_store_foreign") + "/tiles.dat";
+	std::ofstream{ path, std::ios::binary } << "not a tile store";
+
+	TileStore store;
+	CHECK(store.Open(path, 64));
+	CHECK(store.Valid() && store.Tiles() == 0);
+}
+
+TEST(TileStoreStartsOverWhenFull)
+{
+	// 12 tiles fit an index of 16 slots, the picture has 20
+	const std::string path = TestDirectory("tile_store_full") + "/tiles.dat";
+	const int width = 5 * kMandelbrotTileSize, height = 4 * kMandelbrotTileSize;
+	TileStore store;
+	CHECK(store.Open(path, 16));
+	Mandelbrot_Compute(MandelbrotParams{}, width, height, false, {}, &store);
+	CHECK(store.Tiles() > 0 && store.Tiles() <= 12);
+
+	// and goes on saving tiles
+	MandelbrotParams other;
+	other.depth = 500;
+	const int small = 2 * kMandelbrotTileSize;
+	Mandelbrot_Compute(other, small, small, false, {}, &store);
+	CountingCache counting{ store };
+	const MandelbrotCounts cached = Mandelbrot_Compute(other, small, small, false, {}, &counting);
+	CHECK(counting.hits == 4);
+	CHECK(cached.counts == Mandelbrot_Compute(other, small, small).counts);
+}
+
+TEST(TileStoreOpenOnlyOnce)
+{
+	const std::string path = TestDirectory("tile_store_once") + "/tiles.dat";
+	TileStore first;
+	CHECK(first.Open(path, 64));
+
+	TileStore second;
+	CHECK(!second.Open(path, 64));
+	CHECK(!second.Valid());
+}
@@ -0,0 +1,222 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// Tests of the asynchronous render with tiles streamed as they finish
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include "test.h"
+#include "tile_stream.h"
+#include "render_pool.h"
+
+namespace {
+
+constexpr int kWidth = 300, kHeight = 200;
+
+// Coroutine which starts at once and is never awaited
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+// What a coroutine consumer got, signalled once it has finished
+struct Consumed {
+	std::mutex lock;
+	std::condition_variable finished_cv;
+	bool finished = false;
+	int tiles = 0;
+	int pixels = 0;
+	bool failed = false;
+	MandelbrotCounts counts;
+
+	void Finish()
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		finished = true;
+		finished_cv.notify_all();
+	}
+
+	void Wait()
+	{
+		std::unique_lock<std::mutex> guard{ lock };
+		finished_cv.wait(guard, [this] { return finished; });
+	}
+};
+
+Detached Consume(MandelbrotRender render, Consumed& out)
+{
+	while (auto tile = co_await render.NextTile())
+	{
+		out.tiles++;
+		out.pixels += tile->rect.width * tile->rect.height;
+	}
+	try
+	{
+		out.counts = co_await render;
+	}
+	catch (const std::exception&)
+	{
+		out.failed = true;
+	}
+	out.Finish();
+}
+
+// fails every tile, as a cache which runs out of memory would
+class FailingCache : public MandelbrotTileCache {
+public:
+	bool Load(const MandelbrotParams&, int, int, const TileRect&, int*, int) override
+	{
+		throw std::runtime_error{ "cache failed" };
+	}
+	void Save(const MandelbrotParams&, int, int, const TileRect&, const int*, int) override {}
+};
+
+// holds every tile back until Open(), so that a consumer subscribes before
+// the first one finishes
+class GatedCache : public MandelbrotTileCache {
+public:
+	bool Load(const MandelbrotParams&, int, int, const TileRect&, int*, int) override
+	{
+		std::unique_lock<std::mutex> guard{ lock };
+		opened_cv.wait(guard, [this] { return opened; });
+		return false;
+	}
+	void Save(const MandelbrotParams&, int, int, const TileRect&, const int*, int) override {}
+
+	void Open()
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		opened = true;
+		opened_cv.notify_all();
+	}
+
+private:
+	std::mutex lock;
+	std::condition_variable opened_cv;
+	bool opened = false;
+};
+
+// ParallelFor without pool helpers, so the cache throws on the render's own
+// thread; a job must not throw on the helpers
+struct NoHelpers {
+	NoHelpers() { SharedRenderPool().SetActiveThreads(0); }
+	~NoHelpers() { SharedRenderPool().SetActiveThreads(SharedRenderPool().Threads()); }
+};
+
+} // namespace
+
+TEST(TileStreamDeliversEveryTile)
+{
+	GatedCache gate;
+	MandelbrotRender render = Mandelbrot_RenderAsync(MandelbrotParams{}, kWidth, kHeight, &gate);
+	auto stream = render.Tiles();
+	gate.Open();
+	int tiles = 0, pixels = 0;
+	for (const MandelbrotTile& tile : stream)
+	{
+		tiles++;
+		pixels += tile.rect.width * tile.rect.height;
+		CHECK(tile.counts.size() == static_cast<size_t>(tile.rect.width * tile.rect.height));
+	}
+	CHECK(tiles == render.TilesTotal() && pixels == kWidth * kHeight);
+	CHECK(render.Wait().counts == Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight).counts);
+	CHECK(render.Done() && render.Progress() == 1.);
+}
+
+TEST(TileStreamResumesCoroutine)
+{
+	GatedCache gate;
+	Consumed consumed;
+	Consume(Mandelbrot_RenderAsync(MandelbrotParams{}, kWidth, kHeight, &gate), consumed);
+	gate.Open();
+	consumed.Wait();
+
+	CHECK(!consumed.failed);
+	CHECK(consumed.tiles == Mandelbrot_TileCount(kWidth, kHeight) && consumed.pixels == kWidth * kHeight);
+	CHECK(consumed.counts.counts == Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight).counts);
+}
+
+TEST(TileStreamKeepsNoTilesWithoutConsumer)
+{
+	MandelbrotRender render = Mandelbrot_RenderAsync(MandelbrotParams{}, kWidth, kHeight);
+	CHECK(render.Wait().counts == Mandelbrot_Compute(MandelbrotParams{}, kWidth, kHeight).counts);
+	CHECK(render.TilesDone() == render.TilesTotal());
+
+	// finished before anyone asked for them
+	int tiles = 0;
+	for ([[maybe_unused]] const MandelbrotTile& tile : render.Tiles())
+		tiles++;
+	CHECK(tiles == 0);
+}
+
+TEST(TileStreamCancel)
+{
+	MandelbrotParams deep;
+	deep.depth = 100000;
+	MandelbrotRender render = Mandelbrot_RenderAsync(deep, 1024, 1024);
+	render.Cancel();
+	const MandelbrotCounts counts = render.Wait();
+	CHECK(render.Cancelled() && render.Done());
+	CHECK(counts.width == 1024 && counts.height == 1024);
+	CHECK(render.TilesDone() < render.TilesTotal());
+}
+
+TEST(TileStreamPassesFailureToWait)
+{
+	NoHelpers no_helpers;
+	FailingCache cache;
+	MandelbrotRender render = Mandelbrot_RenderAsync(MandelbrotParams{}, kWidth, kHeight, &cache);
+
+	// the stream ends, the frame throws
+	int pixels = 0;
+	for (const MandelbrotTile& tile : render.Tiles())
+		pixels += tile.rect.width * tile.rect.height;
+	CHECK(pixels == 0);
+
+	bool thrown = false;
+	try
+	{
+		render.Wait();
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	CHECK(thrown && render.Done());
+}
+
+TEST(TileStreamPassesFailureToCoroutine)
+{
+	NoHelpers no_helpers;
+	FailingCache cache;
+	Consumed consumed;
+	Consume(Mandelbrot_RenderAsync(MandelbrotParams{}, kWidth, kHeight, &cache), consumed);
+	consumed.Wait();
+	CHECK(consumed.failed && consumed.tiles == 0);
+}
@@ -0,0 +1,62 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+// main_tile_server.cpp : serves Mandelbrot tiles over HTTP.
+//
+// usage: tile_server [port] [cache size in MB] [--public]
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "socket.h"
+#include "tile_server.h"
+#include "auto_tune.h"
+
+int main(int argc, char* argv[])
+{
+	int port = 8080;
+	long cache_mb = 256;
+	bool loopback_only = true;
+
+	int positional = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--public") == 0)
+			loopback_only = false;
+		else if (std::strcmp(argv[i], "--tuning") == 0 && i + 1 < argc)
+			Mandelbrot_SetTuning(Mandelbrot_LoadOrTune(argv[++i]));
+		else if (positional++ == 0)
+			port = std::atoi(argv[i]);
+		else
+			cache_mb = std::atol(argv[i]);
+	}
+
+	SocketLibrary sockets;
+	TileServer server{ static_cast<std::uint16_t>(port), static_cast<size_t>(cache_mb) << 20, loopback_only };
+	if (!server.Listening())
+	{
+		std::fprintf(stderr, "cannot listen on port %d\n", port);
+		return 1;
+	}
+
+	std::printf("serving tiles on http://%s:%d/\n", loopback_only ? "localhost" : "0.0.0.0", server.Port());
+	server.Run();
+	return 0;
+}
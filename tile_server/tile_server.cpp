@@ -0,0 +1,313 @@
+/// Copyright 2022 Piotr Grygorczuk <grygorek@gmail.com>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "tile_server.h"
+#include "framebuffer.h"
+#include "png_writer.h"
+
+namespace {
+
+// Page with the tiles on a pannable, zoomable map. Self-contained, so the
+// server works without internet access. The view is the top-left corner of
+// the window in pixels of the whole picture at the current zoom level.
+const char kIndexPage[] = R"(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>Mandelbrot</title>
+<style>html,body{height:100%;margin:0;overflow:hidden;background:#000}
+#map{position:absolute;left:0;top:0;right:0;bottom:0;cursor:grab}
+#map img{position:absolute;user-select:none;-webkit-user-drag:none;pointer-events:none}</style></head>
+<body><div id="map"></div><script>
+var map = document.getElementById('map'), tiles = {}, maxZoom = 40;
+var view = { z: 1, x: 256 - map.clientWidth / 2, y: 256 - map.clientHeight / 2 };
+function draw() {
+  var n = Math.pow(2, view.z), shown = {};
+  var x0 = Math.max(0, Math.floor(view.x / 256)), x1 = Math.min(n - 1, Math.floor((view.x + map.clientWidth) / 256));
+  var y0 = Math.max(0, Math.floor(view.y / 256)), y1 = Math.min(n - 1, Math.floor((view.y + map.clientHeight) / 256));
+  for (var ty = y0; ty <= y1; ty++)
+    for (var tx = x0; tx <= x1; tx++) {
+      var key = view.z + '/' + tx + '/' + ty, img = tiles[key];
+      if (!img) {
+        img = tiles[key] = document.createElement('img');
+        img.src = '/' + key + '.png';
+        map.appendChild(img);
+      }
+      img.style.left = (tx * 256 - view.x) + 'px';
+      img.style.top = (ty * 256 - view.y) + 'px';
+      shown[key] = true;
+    }
+  for (var k in tiles)
+    if (!shown[k]) { map.removeChild(tiles[k]); delete tiles[k]; }
+}
+function zoom(px, py, dz) {
+  var z = Math.min(maxZoom, Math.max(0, view.z + dz)), f = Math.pow(2, z - view.z);
+  view.x = (view.x + px) * f - px;
+  view.y = (view.y + py) * f - py;
+  view.z = z;
+  draw();
+}
+var drag = null;
+map.onmousedown = function (e) { drag = { x: e.clientX, y: e.clientY }; map.style.cursor = 'grabbing'; };
+window.onmouseup = function () { drag = null; map.style.cursor = 'grab'; };
+window.onmousemove = function (e) {
+  if (!drag) return;
+  view.x -= e.clientX - drag.x;
+  view.y -= e.clientY - drag.y;
+  drag = { x: e.clientX, y: e.clientY };
+  draw();
+};
+map.onwheel = function (e) { e.preventDefault(); zoom(e.clientX, e.clientY, e.deltaY < 0 ? 1 : -1); };
+map.ondblclick = function (e) { zoom(e.clientX, e.clientY, 1); };
+window.onresize = draw;
+draw();
+</script></body></html>
+)";
+
+// a tile or the page never changes, errors and stats must not be kept
+const char kCacheable[] = "public, max-age=86400";
+
+bool Send(const Socket& s, const std::string& status, const char* type, const char* body, size_t size, bool keep_alive,
+	const char* cache_control = "no-store")
+{
+	const std::string header = "HTTP/1.1 " + status + "\r\n"
+		"Content-Type: " + type + "\r\n"
+		"Content-Length: " + std::to_string(size) + "\r\n"
+		"Cache-Control: " + cache_control + "\r\n"
+		"Connection: " + (keep_alive ? "keep-alive" : "close") + "\r\n\r\n";
+	return s.SendAll(header.data(), header.size()) && s.SendAll(body, size);
+}
+
+bool Send(const Socket& s, const std::string& status, const std::string& text, bool keep_alive)
+{
+	return Send(s, status, "text/plain", text.data(), text.size(), keep_alive);
+}
+
+bool ParseTilePath(const std::string& path, TileKey& key)
+{
+	int consumed = 0;
+	if (std::sscanf(path.c_str(), "/%d/%d/%d.png%n", &key.z, &key.x, &key.y, &consumed) != 3 ||
+		consumed != static_cast<int>(path.size()))
+		return false;
+	if (key.z < 0 || key.z > kTileMaxZoom)
+		return false;
+	const std::int64_t tiles = std::int64_t(1) << key.z;
+	return key.x >= 0 && key.x < tiles && key.y >= 0 && key.y < tiles;
+}
+
+std::string Lower(std::string s)
+{
+	for (auto& c : s)
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	return s;
+}
+
+} // namespace
+
+MandelbrotParams TileParams(const TileKey& key)
+{
+	// zoom 0 tile, a square around the whole set
+	constexpr double kLeft = -2.25;
+	constexpr double kTop = -1.5;
+	constexpr double kSize = 3.0;
+
+	const double size = kSize / static_cast<double>(std::int64_t(1) << key.z);
+
+	MandelbrotParams p;
+	p.x_start = kLeft + key.x * size;
+	p.y_start = kTop + key.y * size;
+	p.x_range = size;
+	p.y_range = size;
+	p.depth += 250 * key.z; // deeper tiles need more iterations to show detail
+	return p;
+}
+
+TileServer::TileServer(std::uint16_t port, size_t cache_bytes, bool loopback_only, int connections_)
+	: listener{ Socket::Listen(port, loopback_only) }
+	, cache{ cache_bytes, [](const std::string& png) { return png.size(); } }
+	, connections{ std::max(connections_, 1) }
+{
+}
+
+std::shared_ptr<const std::string> TileServer::Tile(const TileKey& key)
+{
+	return cache.GetOrCreate(key, [&key] {
+		FrameBuffer frame{ kTilePixels, kTilePixels };
+		const MandelbrotParams p = TileParams(key);
+
+		// tiles are coloured by iteration count alone, the histogram colouring
+		// of Mandelbrot_Image would differ between neighbouring tiles
+		Mandelbrot_Image(p, frame.width, frame.height, {},
+			[&frame, depth = p.depth](const TileRect& t, const int* counts, int stride) {
+				for (int y = 0; y < t.height; y++)
+					for (int x = 0; x < t.width; x++)
+						frame.Pixel(t.x + x, t.y + y, Mandelbrot_PreviewColour(counts[y * stride + x], depth));
+			});
+
+		return std::make_shared<const std::string>(EncodePng(frame));
+		});
+}
+
+void TileServer::Run()
+{
+	std::vector<std::thread> threads;
+	for (int i = 0; i < connections; i++)
+		threads.emplace_back([this] { ServeQueue(); });
+
+	while (!stopped)
+	{
+		Socket client = listener.Accept();
+		if (!client)
+			continue;
+
+		std::unique_lock<std::mutex> guard{ lock };
+		if (queue.size() >= static_cast<size_t>(connections))
+		{
+			guard.unlock();
+			Send(client, "503 Service Unavailable", "server busy\n", false);
+			continue;
+		}
+		queue.push_back(std::move(client));
+		accepted.notify_one();
+	}
+
+	// unblock connections waiting for their next request, then wait for all
+	{
+		std::lock_guard<std::mutex> guard{ lock };
+		for (const Socket* s : active)
+			s->Shutdown();
+		queue.clear();
+	}
+	accepted.notify_all();
+	for (auto& t : threads)
+		t.join();
+}
+
+void TileServer::Stop()
+{
+	stopped = true;
+	listener.Shutdown();
+	listener.Close();
+}
+
+void TileServer::ServeQueue()
+{
+	for (;;)
+	{
+		Socket client;
+		{
+			std::unique_lock<std::mutex> guard{ lock };
+			accepted.wait(guard, [this] { return !queue.empty() || stopped; });
+			if (stopped)
+				return;
+			client = std::move(queue.front());
+			queue.pop_front();
+			active.push_back(&client);
+		}
+
+		client.SetReceiveTimeout(kTileIdleMs);
+		try
+		{
+			Serve(client);
+		}
+		catch (...)
+		{
+			// Serve answered 500 where it could, anything else only ends the connection
+		}
+
+		std::lock_guard<std::mutex> guard{ lock };
+		active.erase(std::find(active.begin(), active.end(), &client));
+	}
+}
+
+void TileServer::Serve(const Socket& client)
+{
+	std::string buffer;
+	char chunk[4096];
+
+	while (!stopped)
+	{
+		// read one request header
+		size_t end;
+		while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+		{
+			if (buffer.size() > 16 * 1024)
+			{
+				Send(client, "431 Request Header Fields Too Large", "header too large\n", false);
+				return;
+			}
+			const long n = client.Receive(chunk, sizeof(chunk));
+			if (n <= 0)
+				return;
+			buffer.append(chunk, n);
+		}
+
+		const std::string header = buffer.substr(0, end);
+		buffer.erase(0, end + 4);
+
+		char method[16] = {}, path[1024] = {}, version[16] = {};
+		if (std::sscanf(header.c_str(), "%15s %1023s %15s", method, path, version) != 3)
+		{
+			Send(client, "400 Bad Request", "bad request\n", false);
+			return;
+		}
+
+		const std::string lower = Lower(header);
+		const bool keep_alive = std::string{ version } == "HTTP/1.1"
+			? lower.find("connection: close") == std::string::npos
+			: lower.find("connection: keep-alive") != std::string::npos;
+
+		bool sent;
+		TileKey key;
+		if (std::string{ method } != "GET")
+			sent = Send(client, "405 Method Not Allowed", "only GET is supported\n", keep_alive);
+		else if (ParseTilePath(path, key))
+		{
+			std::shared_ptr<const std::string> png;
+			try
+			{
+				png = Tile(key);
+			}
+			catch (...)
+			{
+				Send(client, "500 Internal Server Error", "cannot render tile\n", false);
+				return;
+			}
+			sent = Send(client, "200 OK", "image/png", png->data(), png->size(), keep_alive, kCacheable);
+		}
+		else if (std::string{ path } == "/stats")
+		{
+			const auto s = cache.GetStats();
+			const std::string json = "{\"hits\":" + std::to_string(s.hits) + ",\"misses\":" + std::to_string(s.misses) +
+				",\"coalesced\":" + std::to_string(s.coalesced) + ",\"bytes\":" + std::to_string(s.cost) +
+				",\"tiles\":" + std::to_string(s.entries) + "}\n";
+			sent = Send(client, "200 OK", "application/json", json.data(), json.size(), keep_alive);
+		}
+		else if (std::string{ path } == "/")
+			sent = Send(client, "200 OK", "text/html", kIndexPage, sizeof(kIndexPage) - 1, keep_alive, kCacheable);
+		else
+			sent = Send(client, "404 Not Found", "no such tile\n", keep_alive);
+
+		if (!sent || !keep_alive)
+			return;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "socket.h"
+#include "lru_cache.h"
+#include "mandel_algo.h"
+
+// Slippy map tile address, /z/x/y.png
+struct TileKey {
+	int z;
+	int x;
+	int y;
+
+	bool operator==(const TileKey& o) const { return z == o.z && x == o.x && y == o.y; }
+};
+
+struct TileKeyHash {
+	size_t operator()(const TileKey& k) const {
+		return std::hash<std::uint64_t>{}((std::uint64_t(k.z) << 58) ^ (std::uint64_t(k.x) << 29) ^ std::uint64_t(k.y));
+	}
+};
+
+constexpr int kTilePixels = 256;  // width and height of a served tile
+constexpr int kTileMaxZoom = 40;  // beyond this doubles run out of precision
+constexpr int kTileIdleMs = 30000; // keep-alive connections idle longer are closed
+
+// Area of the complex plane covered by a tile. Zoom 0 is one tile showing the
+// whole set, every level splits each tile into four.
+MandelbrotParams TileParams(const TileKey& key);
+
+// Minimal HTTP/1.1 server of Mandelbrot PNG tiles.
+//
+// GET /z/x/y.png - tile
+// GET /stats     - cache counters
+// GET /          - page showing the tiles on a map
+//
+// Connections are served by a fixed number of threads from a bounded accept
+// queue; a connection arriving when the queue is full gets 503, one idle for
+// kTileIdleMs is closed. Tiles missing in the cache are rendered on the
+// shared render pool, concurrent requests for one tile wait for a single
+// render. A request which fails (out of memory) gets 500 and the connection
+// is closed, the server goes on.
+class TileServer {
+public:
+	TileServer(std::uint16_t port, size_t cache_bytes, bool loopback_only = true, int connections = 32);
+
+	bool Listening() const { return listener.Valid(); }
+	std::uint16_t Port() const { return listener.LocalPort(); }
+
+	// Accept connections until Stop() is called, also when that was before
+	// Run. Returns once every connection thread has finished.
+	void Run();
+	void Stop();
+
+	// Encoded PNG of a tile, from cache or freshly rendered
+	std::shared_ptr<const std::string> Tile(const TileKey& key);
+
+	LruCache<TileKey, std::string, TileKeyHash>::Stats Stats() const { return cache.GetStats(); }
+
+private:
+	void ServeQueue();
+	void Serve(const Socket& client);
+
+	Socket listener;
+	std::atomic<bool> stopped{ false }; // also before Run, which then returns at once
+	LruCache<TileKey, std::string, TileKeyHash> cache;
+
+	const int connections;
+	std::mutex lock;                 // accepted and active connections
+	std::condition_variable accepted;
+	std::deque<Socket> queue;
+	std::vector<const Socket*> active;
+};